@@ -35,4 +35,37 @@ int main(int argc, char **argv) {
         auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
         outfile << elapsed.count() << std::endl;
     }
+
+    // Next we compare the queues holding the times of the next reactions on much larger domains, where
+    // every voxel initially contains 10 molecules and the simulation is run for about 2 * 10^6 reactions
+    std::ofstream large_outfile;
+    large_outfile.open(argc > 2 ? std::string(argv[2]) : "benchmarks_diffusion_large.dat");
+    large_outfile << "# num_voxels time_taken_in_miliseconds (binary_heap calendar)" << std::endl;
+
+    std::vector<ss::QueueType> queue_types = {ss::QueueType::binary_heap, ss::QueueType::calendar};
+    for (unsigned num_voxels : {10000, 100000, 1000000}) {
+        std::vector<ss::Voxel> large_vs(num_voxels, ss::Voxel({10}, 0.01));
+        for (unsigned i=0; i<large_vs.size()-1; i++) {
+            large_vs[i].add_reaction(ss::Reaction(1.0, diffusion, {-1}, i+1));
+            large_vs[i+1].add_reaction(ss::Reaction(1.0, diffusion, {-1}, i));
+        }
+
+        // We run the simulation 3 times with each queue and save the time taken each time
+        for (unsigned i=0; i<3; i++)
+        {
+            large_outfile << num_voxels;
+            for (auto& queue_type : queue_types) {
+                auto start = std::chrono::system_clock::now();
+
+                ss::Simulator sim(large_vs, 0, queue_type);
+                sim.advance(1e5 / num_voxels);
+
+                auto end = std::chrono::system_clock::now();
+
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+                large_outfile << " " << elapsed.count();
+            }
+            large_outfile << std::endl;
+        }
+    }
 }
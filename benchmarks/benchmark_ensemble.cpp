@@ -0,0 +1,35 @@
+#include <chrono>
+#include <thread>
+#include "ensemble.hpp"
+
+namespace ss = StoSpa2;
+
+int main(int argc, char **argv) {
+    // We define the std::functions for reactions
+    auto decay = [](const std::vector<unsigned>& mols, const double& area) { return (double)mols[0]; };
+    auto prod = [](const std::vector<unsigned>& mols, const double& area) { return area; };
+
+    ss::Voxel vox({100}, 1.0);
+    vox.add_reaction(ss::Reaction(0.01, decay, {-1}));  // decay reaction
+    vox.add_reaction(ss::Reaction(1.0, prod, {1}));  // production reaction
+
+    // We create the file for outputting time taken to finish the ensemble with each number of threads
+    std::ofstream outfile;
+    outfile.open(argc > 1 ? std::string(argv[1]) : "benchmarks_ensemble.dat");
+    outfile << "# num_threads time_taken_in_miliseconds" << std::endl;
+
+    // We run 1000 replicas with one thread and then double the threads up to the number of hardware threads
+    unsigned max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned num_threads=1; num_threads<=max_threads; num_threads*=2)
+    {
+        auto start = std::chrono::system_clock::now();
+
+        ss::Ensemble ensemble({vox}, 1000, 153, num_threads);
+        ensemble.run(10000);
+
+        auto end = std::chrono::system_clock::now();
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+        outfile << num_threads << " " << elapsed.count() << std::endl;
+    }
+}
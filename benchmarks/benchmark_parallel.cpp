@@ -0,0 +1,60 @@
+#include <chrono>
+#include <thread>
+#include "parallel_simulator.hpp"
+
+namespace ss = StoSpa2;
+
+int main(int argc, char **argv) {
+    // We create a cube of 40x40x40 voxels where molecules are produced, decay and diffuse to the six neighbours,
+    // the voxels are numbered plane by plane, so that the subdomains are slabs of planes
+    const unsigned n = 40;
+    std::vector<ss::Voxel> vs(n * n * n, ss::Voxel({10}, 1.0));
+    for (unsigned i=0; i<vs.size(); i++) {
+        vs[i].add_reaction(ss::Reaction::mass_action(1.0, {}, {1}));
+        vs[i].add_reaction(ss::Reaction::mass_action(0.1, {0}, {-1}));
+        unsigned x = i % n, y = (i / n) % n, z = i / (n * n);
+        if (x > 0) { vs[i].add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1}, i - 1)); }
+        if (x + 1 < n) { vs[i].add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1}, i + 1)); }
+        if (y > 0) { vs[i].add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1}, i - n)); }
+        if (y + 1 < n) { vs[i].add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1}, i + n)); }
+        if (z > 0) { vs[i].add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1}, i - n * n)); }
+        if (z + 1 < n) { vs[i].add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1}, i + n * n)); }
+    }
+
+    // We create the file for outputting time taken to finish the simulation with each number of threads, where
+    // zero threads stands for the serial simulator with the same random numbers
+    std::ofstream outfile;
+    outfile.open(argc > 1 ? std::string(argv[1]) : "benchmarks_parallel.dat");
+    outfile << "# num_threads time_taken_in_miliseconds rounds_per_window" << std::endl;
+
+    {
+        auto start = std::chrono::system_clock::now();
+
+        ss::Simulator sim(vs);
+        sim.set_rng_type(ss::RngType::philox);
+        sim.set_seed(153);
+        sim.advance(1.0);
+
+        auto end = std::chrono::system_clock::now();
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+        outfile << 0 << " " << elapsed.count() << " " << 0 << std::endl;
+    }
+
+    // We run the simulation with one thread and then double the threads up to the number of hardware threads
+    unsigned max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned num_threads=1; num_threads<=max_threads; num_threads*=2)
+    {
+        auto start = std::chrono::system_clock::now();
+
+        ss::ParallelSimulator sim(vs, 0, num_threads);
+        sim.set_seed(153);
+        sim.advance(1.0);
+
+        auto end = std::chrono::system_clock::now();
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+        outfile << num_threads << " " << elapsed.count() << " "
+                << (double) sim.get_num_rounds() / sim.get_num_windows() << std::endl;
+    }
+}
@@ -5,12 +5,6 @@
 namespace ss = StoSpa2;
 
 int main(int argc, char** argv) {
-    auto decay = [](const std::vector<unsigned>& mols, const double& area) { return (double)mols[0]; };
-    auto prod = [](const std::vector<unsigned>& mols, const double& area) { return area; };
-    auto diffusion1 = [](const std::vector<unsigned>& mols, const double& area) { return (double)mols[0]; };
-    auto diffusion2 = [](const std::vector<unsigned>& mols, const double& area) { return (double)mols[1]; };
-    auto schnakenberg = [](const std::vector<unsigned>& mols, const double& area) { return mols[0] * (mols[0] - 1) * mols[1] / (area*area); };
-
     double du = 1e-5;
     double dv = 0.001;
     double k1 = 0.02;  // decay of species 1
@@ -22,18 +16,25 @@ int main(int argc, char** argv) {
 
     std::vector<ss::Voxel> vs(40, ss::Voxel({200, 75}, h));
 
+    // All the reactions follow mass action, so their propensities are evaluated without calling a propensity
+    // function and only the propensities that depend on the changed species are re-evaluated after each event
+    auto r_decay = ss::Reaction::mass_action(k1, {0}, {-1, 0});
+    auto r_prod1 = ss::Reaction::mass_action(k2, {}, {1, 0});
+    auto r_schnakenberg = ss::Reaction::mass_action(k3, {0, 0, 1}, {1, -1});
+    auto r_prod2 = ss::Reaction::mass_action(k4, {}, {0, 1});
+
     for (unsigned i=0; i<vs.size()-1; i++) {
-        vs[i].add_reaction(ss::Reaction(du/(h*h), diffusion1, {-1, 0}, i+1));
-        vs[i+1].add_reaction(ss::Reaction(du/(h*h), diffusion1, {-1, 0}, i));
-        vs[i].add_reaction(ss::Reaction(dv/(h*h), diffusion2, {0, -1}, i+1));
-        vs[i+1].add_reaction(ss::Reaction(dv/(h*h), diffusion2, {0, -1}, i));
+        vs[i].add_reaction(ss::Reaction::mass_action(du/(h*h), {0}, {-1, 0}, i+1));
+        vs[i+1].add_reaction(ss::Reaction::mass_action(du/(h*h), {0}, {-1, 0}, i));
+        vs[i].add_reaction(ss::Reaction::mass_action(dv/(h*h), {1}, {0, -1}, i+1));
+        vs[i+1].add_reaction(ss::Reaction::mass_action(dv/(h*h), {1}, {0, -1}, i));
     }
 
     for (auto& v : vs) {
-        v.add_reaction(ss::Reaction(k1, decay, {-1, 0}));
-        v.add_reaction(ss::Reaction(k2, prod, {1, 0}));
-        v.add_reaction(ss::Reaction(k3, schnakenberg, {1, -1}));
-        v.add_reaction(ss::Reaction(k4, prod, {0, 1}));
+        v.add_reaction(r_decay);
+        v.add_reaction(r_prod1);
+        v.add_reaction(r_schnakenberg);
+        v.add_reaction(r_prod2);
     }
 
     // We create the file for outputting time taken to finish one simulation
@@ -0,0 +1,46 @@
+#include <chrono>
+#include <fstream>
+#include "static_simulator.hpp"
+
+namespace ss = StoSpa2;
+
+// The same model as in benchmark_schnakenberg.cpp, with the reaction network known at compile time
+typedef ss::Network<2,
+    ss::MassAction<ss::Reactants<0>, ss::Stoichiometry<-1, 0>>,       // decay of species 1
+    ss::MassAction<ss::Reactants<>, ss::Stoichiometry<1, 0>>,         // production of species 1
+    ss::MassAction<ss::Reactants<0, 0, 1>, ss::Stoichiometry<1, -1>>, // schnakenberg reaction
+    ss::MassAction<ss::Reactants<>, ss::Stoichiometry<0, 1>>          // production of species 2
+> Schnakenberg;
+
+int main(int argc, char** argv) {
+    double du = 1e-5;
+    double dv = 0.001;
+    double k1 = 0.02;  // decay of species 1
+    double k2 = 40.0;  // production of species 1
+    double k3 = 6.25e-10;  // schnakenberg reaction
+    double k4 = 120.0;  // production of species 2
+    unsigned n = 40;  // number of voxels
+    double h = 1.0 / n;
+
+    std::vector<Schnakenberg::Molecules> mols(n, {{200, 75}});
+
+    // We create the file for outputting time taken to finish one simulation
+    std::ofstream outfile;
+    outfile.open(argc > 1 ? std::string(argv[1]) : "benchmarks_schnakenberg_static.dat");
+    outfile << "# time_taken_in_miliseconds" << std::endl;
+
+    // We run the simulation 10 times and save the time taken each time
+    for (unsigned i=0; i<10; i++)
+    {
+        auto start = std::chrono::system_clock::now();
+
+        ss::StaticSimulator<Schnakenberg> sim(mols, h, {{k1, k2, k3, k4}}, {{du/(h*h), dv/(h*h)}});
+        sim.advance(2000);
+
+        auto end = std::chrono::system_clock::now();
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+        outfile << elapsed.count() << std::endl;
+    }
+
+}
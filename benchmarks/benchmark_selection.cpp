@@ -0,0 +1,57 @@
+
+#include <chrono>
+#include <cmath>
+#include "simulator.hpp"
+
+namespace ss = StoSpa2;
+
+int main(int argc, char **argv) {
+    // A single voxel with many species, each of which is produced and decays, where the production rates
+    // span six orders of magnitude (fast reactions next to slow ones)
+    unsigned num_species = 50;
+    ss::Voxel vox(std::vector<unsigned>(num_species, 0), 1.0);
+
+    auto prod = [](const std::vector<unsigned>& mols, const double& area) { return area; };
+    for (unsigned i=0; i<num_species; i++) {
+        auto decay = [i](const std::vector<unsigned>& mols, const double& area) { return (double)mols[i]; };
+        double k = std::pow(10.0, -3.0 + 6.0 * i / (num_species - 1));
+
+        std::vector<int> stoichiometry(num_species, 0);
+        stoichiometry[i] = 1;
+        ss::Reaction r_prod(k, prod, stoichiometry);
+        r_prod.set_dependencies({});
+        stoichiometry[i] = -1;
+        ss::Reaction r_decay(1.0, decay, stoichiometry);
+        r_decay.set_dependencies({i});
+
+        vox.add_reaction(r_prod);
+        vox.add_reaction(r_decay);
+    }
+
+    std::vector<ss::SelectionMethod> methods = {
+        ss::SelectionMethod::direct, ss::SelectionMethod::sum_tree, ss::SelectionMethod::composition_rejection
+    };
+
+    // We create the file for outputting time taken to finish one simulation
+    std::ofstream outfile;
+    outfile.open(argc > 1 ? std::string(argv[1]) : "benchmarks_selection.dat");
+    outfile << "# time_taken_in_miliseconds (direct sum_tree composition_rejection)" << std::endl;
+
+    // We run the simulation 10 times with each selection method and save the time taken each time
+    for (unsigned i=0; i<10; i++)
+    {
+        for (unsigned j=0; j<methods.size(); j++) {
+            auto start = std::chrono::system_clock::now();
+
+            ss::Simulator sim({vox});
+            sim.set_selection_method(methods[j]);
+            sim.advance(100);
+
+            auto end = std::chrono::system_clock::now();
+
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+            outfile << (j > 0 ? " " : "") << elapsed.count();
+        }
+        outfile << std::endl;
+    }
+}
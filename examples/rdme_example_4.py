@@ -11,7 +11,7 @@ assert path.isfile("rdme_example.dat"), "Note: 'rdme_example.py' script needs to
 # Create a vector of voxel objects. Voxel arguments: vector of number of molecules, size of the voxel
 initial_num = [10000]
 voxel_size = 1.0
-growth = lambda t : np.exp(0.2 * t)
+growth = ss.GrowthLaw.exponential(0.2)  # built-in law, evaluated without calling back into Python
 domain = [ss.Voxel(initial_num, voxel_size, growth)]
 # We add nine voxels with no molecules
 for i in range(9):
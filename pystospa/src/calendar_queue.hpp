@@ -0,0 +1,322 @@
+
+// The calendar queue follows Brown R (1988) Calendar queues: a fast O(1) priority queue implementation for the
+// simulation event set problem. Commun ACM 31(10): 1220-1227. https://doi.org/10.1145/63039.63045
+
+#ifndef CALENDAR_QUEUE_HPP
+#define CALENDAR_QUEUE_HPP
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace StoSpa2 {
+
+/**
+ * CalendarQueue class - times of the next events, one for each voxel, kept in buckets (days of a calendar) of
+ * a fixed width in time. The buckets are unsorted doubly linked lists threaded through arrays indexed by voxel,
+ * so updating the time of a voxel takes O(1) without any allocation. The earliest event is found by scanning
+ * the buckets from the day of the previous earliest event, which takes amortised O(1) as long as the bucket
+ * width is close to the typical spacing of events. The width is re-estimated whenever scans become too costly.
+ * It has the same interface as IndexedPriorityQueue: ties are broken by the voxel index and infinite times are
+ * valid entries (kept outside the buckets).
+ */
+class CalendarQueue {
+protected:
+    /** Time of the next event for each voxel ordered according to voxel indices */
+    std::vector<double> m_times;
+
+    /** Next voxel in the same bucket (-1 if it is the last one) */
+    std::vector<int> m_next;
+
+    /** Previous voxel in the same bucket (-1 if it is the first one) */
+    std::vector<int> m_prev;
+
+    /** Bucket of each voxel (-1 if the time is infinite) */
+    std::vector<int> m_bucket_of;
+
+    /** First voxel in each bucket (-1 if the bucket is empty) */
+    std::vector<int> m_heads;
+
+    /** Width of each bucket in time */
+    double m_width = 1.0;
+
+    /** Number of voxels with finite times */
+    unsigned m_num_finite = 0;
+
+    /** Lower bound on all the times, from which the search for the earliest event starts */
+    double m_last_time = 0.0;
+
+    /** Index of the voxel with the earliest event (-1 if it needs to be searched for) */
+    int m_min_index = -1;
+
+    /** Number of searches since the last resize */
+    unsigned m_num_searches = 0;
+
+    /** Number of buckets and voxels visited by the searches since the last resize */
+    unsigned long m_search_cost = 0;
+
+    /**
+     * Returns whether the event of voxel a comes before the event of voxel b
+     * @param a index of the first voxel
+     * @param b index of the second voxel
+     */
+    bool before(const int& a, const int& b) const {
+        if (m_times[a] != m_times[b]) {
+            return m_times[a] < m_times[b];
+        }
+        return a < b;
+    }
+
+    /**
+     * Returns the number of the day (bucket width intervals since time zero) of the given time
+     * @param time a finite time
+     */
+    double day(const double& time) const {
+        return std::floor(time / m_width);
+    }
+
+    /**
+     * Returns the bucket to which the given time belongs
+     * @param time a finite time
+     */
+    int bucket(const double& time) const {
+        double d = day(time);
+        if (std::abs(d) < 4e18) {
+            // The number of buckets is a power of two, so the remainder is a bit mask
+            return (int) ((long long) d & (long long) (m_heads.size() - 1));
+        }
+        d = std::fmod(d, (double) m_heads.size());
+        if (d < 0) { d += m_heads.size(); }
+        return (int) d;
+    }
+
+    /**
+     * Adds the voxel with the given index to the bucket corresponding to its time
+     * @param index index of the voxel
+     */
+    void insert(const int& index) {
+        if (std::isinf(m_times[index])) {
+            m_bucket_of[index] = -1;
+            return;
+        }
+        int b = bucket(m_times[index]);
+        m_bucket_of[index] = b;
+        m_prev[index] = -1;
+        m_next[index] = m_heads[b];
+        if (m_heads[b] >= 0) { m_prev[m_heads[b]] = index; }
+        m_heads[b] = index;
+        m_num_finite += 1;
+    }
+
+    /**
+     * Removes the voxel with the given index from its bucket
+     * @param index index of the voxel
+     */
+    void remove(const int& index) {
+        int b = m_bucket_of[index];
+        if (b < 0) { return; }
+        if (m_prev[index] >= 0) { m_next[m_prev[index]] = m_next[index]; }
+        else { m_heads[b] = m_next[index]; }
+        if (m_next[index] >= 0) { m_prev[m_next[index]] = m_prev[index]; }
+        m_bucket_of[index] = -1;
+        m_num_finite -= 1;
+    }
+
+    /**
+     * Estimates the bucket width from the spacing of the earliest events and redistributes all the voxels
+     * into a number of buckets close to the number of voxels with finite times
+     */
+    void resize() {
+        std::vector<double> finite;
+        for (const auto& time : m_times) {
+            if (!std::isinf(time)) { finite.push_back(time); }
+        }
+
+        // Three times the average spacing between the earliest (at most 25) events
+        unsigned num_samples = std::min<unsigned>(25, finite.size());
+        if (num_samples > 1) {
+            std::nth_element(finite.begin(), finite.begin() + num_samples - 1, finite.end());
+            double t_max = finite[num_samples - 1];
+            double t_min = *std::min_element(finite.begin(), finite.begin() + num_samples);
+            double spacing = (t_max - t_min) / (num_samples - 1);
+            if (spacing > 0) { m_width = 3.0 * spacing; }
+        }
+
+        unsigned num_buckets = 1;
+        while (num_buckets < finite.size()) {
+            num_buckets *= 2;
+        }
+
+        m_heads.assign(num_buckets, -1);
+        m_num_finite = 0;
+        for (unsigned i=0; i<m_times.size(); i++) {
+            insert(i);
+        }
+        m_num_searches = 0;
+        m_search_cost = 0;
+    }
+
+    /**
+     * Finds the voxel with the earliest event, starting from the day of m_last_time
+     */
+    void search() {
+        if (m_num_finite == 0) {
+            m_min_index = m_times.empty() ? -1 : 0;
+            return;
+        }
+
+        // Scan the buckets for a single year, only events within the current day of each bucket count
+        int best = -1;
+        unsigned long cost = 0;
+        double first_day = day(m_last_time);
+        int b = bucket(m_last_time);
+        for (unsigned i=0; i<m_heads.size() and best < 0; i++) {
+            double day_end = (first_day + i + 1) * m_width;
+            for (int index=m_heads[b]; index>=0; index=m_next[index]) {
+                cost += 1;
+                if (m_times[index] < day_end and (best < 0 or before(index, best))) {
+                    best = index;
+                }
+            }
+            cost += 1;
+            b = (b + 1) % m_heads.size();
+        }
+
+        // If there are no events within a year, then search all the buckets directly
+        if (best < 0) {
+            for (unsigned i=0; i<m_times.size(); i++) {
+                if (m_bucket_of[i] >= 0 and (best < 0 or before(i, best))) {
+                    best = i;
+                }
+            }
+            cost += m_times.size();
+        }
+
+        m_min_index = best;
+        m_last_time = m_times[best];
+
+        // Re-estimate the bucket width if searches have become too costly on average
+        m_num_searches += 1;
+        m_search_cost += cost;
+        if (m_num_searches >= std::max<unsigned>(64, m_heads.size())) {
+            bool costly = m_search_cost > 8 * (unsigned long) m_num_searches;
+            bool unbalanced = (m_num_finite > 2 * m_heads.size()) or (2 * m_num_finite < m_heads.size());
+            if (costly or unbalanced) {
+                resize();
+            }
+            m_num_searches = 0;
+            m_search_cost = 0;
+        }
+    }
+
+public:
+
+    /**
+     * Default constructor for the CalendarQueue class, creates an empty queue
+     */
+    CalendarQueue() = default;
+
+    /**
+     * Constructor for the CalendarQueue class
+     * @param times times of the next events ordered according to voxel indices
+     */
+    explicit CalendarQueue(std::vector<double> times) {
+        reset(std::move(times));
+    }
+
+    /**
+     * Replaces the contents of the queue and redistributes all the voxels into buckets in O(N)
+     * @param times times of the next events ordered according to voxel indices
+     */
+    void reset(std::vector<double> times) {
+        m_times = std::move(times);
+        m_next.assign(m_times.size(), -1);
+        m_prev.assign(m_times.size(), -1);
+        m_bucket_of.assign(m_times.size(), -1);
+        resize();
+
+        m_last_time = std::numeric_limits<double>::infinity();
+        for (const auto& time : m_times) {
+            m_last_time = std::min(m_last_time, time);
+        }
+        if (std::isinf(m_last_time)) { m_last_time = 0.0; }
+        m_min_index = -1;
+    }
+
+    /**
+     * Changes the time of the next event for the voxel with the given index
+     * @param index index of the voxel
+     * @param time new time of the next event
+     */
+    void update(const unsigned& index, const double& time) {
+        double old_time = m_times[index];
+        remove(index);
+        m_times[index] = time;
+        insert(index);
+
+        if (!std::isinf(time) and time < m_last_time) {
+            m_last_time = time;
+        }
+
+        // Keep track of the earliest event if possible, otherwise search for it when it is needed
+        if (m_min_index == (int) index) {
+            if (time > old_time) { m_min_index = -1; }
+        }
+        else if (m_min_index >= 0 and !std::isinf(time) and before(index, m_min_index)) {
+            m_min_index = index;
+        }
+    }
+
+    /**
+     * Returns the index of the voxel with the earliest next event
+     */
+    unsigned top_index() {
+        if (m_times.empty()) {
+            throw std::runtime_error("CalendarQueue::top_index: the queue is empty");
+        }
+        if (m_min_index < 0) { search(); }
+        return m_min_index;
+    }
+
+    /**
+     * Returns the time of the earliest next event (infinity if the queue is empty)
+     */
+    double top_time() {
+        if (m_times.empty()) {
+            return std::numeric_limits<double>::infinity();
+        }
+        if (m_min_index < 0) { search(); }
+        return m_times[m_min_index];
+    }
+
+    /**
+     * Returns the time of the next event for the voxel with the given index
+     * @param index index of the voxel
+     */
+    double get_time(const unsigned& index) const {
+        return m_times[index];
+    }
+
+    /**
+     * Returns the number of voxels in the queue
+     */
+    unsigned size() const {
+        return m_times.size();
+    }
+
+    /**
+     * Returns whether the queue is empty
+     */
+    bool empty() const {
+        return m_times.empty();
+    }
+};
+
+}
+
+#endif // CALENDAR_QUEUE_HPP
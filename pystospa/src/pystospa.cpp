@@ -5,16 +5,57 @@
 #include <pybind11/stl.h>
 
 // StoSpa2 includes
+#include "ensemble.hpp"
+#include "growth.hpp"
 #include "reaction.hpp"
+#include "hybrid_simulator.hpp"
+#include "kernel_compiler.hpp"
+#include "parallel_simulator.hpp"
 #include "simulator.hpp"
+#include "tau_leap_simulator.hpp"
 #include "voxel.hpp"
 #include "version.hpp"
 
 namespace py = pybind11;
 namespace ss = StoSpa2;
 
+/**
+ * Returns the growth law of a Python function, the laws made from the same function are equal, so that all the
+ * voxels built from it share a single law in a simulation
+ * @param growth_func Python function that takes value of time and returns ratio by which voxel size has grown
+ */
+ss::GrowthLaw python_growth_law(const py::function& growth_func) {
+    return ss::GrowthLaw(growth_func.cast<g_f>(), growth_func.ptr());
+}
+
+/**
+ * Returns the growth laws of Python functions (see python_growth_law)
+ * @param growth_funcs Python functions, one for each spatial dimension
+ */
+std::vector<ss::GrowthLaw> python_growth_laws(const std::vector<py::function>& growth_funcs) {
+    std::vector<ss::GrowthLaw> laws;
+    for (const auto& growth_func : growth_funcs) {
+        laws.push_back(python_growth_law(growth_func));
+    }
+    return laws;
+}
+
 PYBIND11_MODULE(pystospa, m) {
     m.attr("__version__") = PROJECT_VERSION;
+    py::enum_<ss::ReactionKind>(m, "ReactionKind", R"pbdoc(
+        Kinds of reactions
+
+        - custom = the propensity is given by a propensity function
+        - zeroth_order, first_order, second_order, third_order = mass-action reactions
+        - expression = the propensity is given by a compiled expression
+    )pbdoc")
+        .value("custom", ss::ReactionKind::custom)
+        .value("zeroth_order", ss::ReactionKind::zeroth_order)
+        .value("first_order", ss::ReactionKind::first_order)
+        .value("second_order", ss::ReactionKind::second_order)
+        .value("third_order", ss::ReactionKind::third_order)
+        .value("expression", ss::ReactionKind::expression);
+
     py::class_<ss::Reaction>(m, "Reaction", R"pbdoc(
         pystospa.Reaction(rate, propensity_func, stoichimetry, diff_idx=-1)
 
@@ -29,6 +70,64 @@ PYBIND11_MODULE(pystospa, m) {
     )pbdoc")
         .def(py::init<double, p_f, std::vector<int>>())
         .def(py::init<double, p_f, std::vector<int>, int>())
+        .def_static("mass_action", &ss::Reaction::mass_action, py::arg("rate"), py::arg("reactants"),
+                    py::arg("stoichiometry"), py::arg("diff_idx") = -1,
+        R"pbdoc(
+            Creates a mass-action reaction, whose propensity is evaluated without calling a Python function,
+            e.g. reactants [] give the propensity voxel_size, [i] give x[i], [i, j] give x[i]*x[j]/voxel_size
+            and [i, i] give x[i]*(x[i]-1)/voxel_size
+
+            Parameters:
+
+            - rate = rate of the reaction
+            - reactants = list of indices of species of at most three reactants
+            - stoichiometry = vector on how number of molecules are going to change if this reaction happens
+            - diff_idx = index of a voxel in an list of voxels to which the molecule should jump to
+
+            Returns:
+
+            - an instance of Reaction
+        )pbdoc")
+        .def_static("from_expression", &ss::Reaction::from_expression, py::arg("rate"), py::arg("expression"),
+                    py::arg("species"), py::arg("stoichiometry"), py::arg("diff_idx") = -1,
+        R"pbdoc(
+            Creates a reaction whose propensity is given as an expression, e.g. "A*(A-1)*B/V^2", which is
+            compiled once and evaluated natively, without calling into Python. Supported are numbers,
+            + - * / ^, parentheses and the functions exp, log, sqrt, min and max.
+
+            Parameters:
+
+            - rate = rate of the reaction
+            - expression = the propensity expression, in which V stands for the voxel size
+            - species = list of names of species in the order of their indices
+            - stoichiometry = vector on how number of molecules are going to change if this reaction happens
+            - diff_idx = index of a voxel in an list of voxels to which the molecule should jump to
+
+            Returns:
+
+            - an instance of Reaction
+        )pbdoc")
+        .def("get_expression", &ss::Reaction::get_expression, R"pbdoc(
+            Returns the propensity expression (an empty string if the propensity is not given as an expression)
+
+            Returns:
+
+            - the expression
+        )pbdoc")
+        .def("get_kind", &ss::Reaction::get_kind, R"pbdoc(
+            Returns the kind of the reaction
+
+            Returns:
+
+            - an instance of ReactionKind
+        )pbdoc")
+        .def("get_reactants", &ss::Reaction::get_reactants, R"pbdoc(
+            Returns the indices of the reactants of a mass-action reaction in increasing order
+
+            Returns:
+
+            - list of indices of species
+        )pbdoc")
         .def("set_rate", &ss::Reaction::set_rate, py::arg("rate"), R"pbdoc(
             Sets the rate of the reaction
 
@@ -43,6 +142,29 @@ PYBIND11_MODULE(pystospa, m) {
 
             - value of the reaction rate
         )pbdoc")
+        .def("set_dependencies", &ss::Reaction::set_dependencies, py::arg("dependencies"), R"pbdoc(
+            Sets the species on which the propensity depends, so that the propensity is only re-evaluated
+            when the number of molecules of one of these species changes
+
+            Parameters:
+
+            - dependencies = list of indices of species
+        )pbdoc")
+        .def("get_dependencies", &ss::Reaction::get_dependencies, R"pbdoc(
+            Returns the species on which the propensity depends
+
+            Returns:
+
+            - list of indices of species
+        )pbdoc")
+        .def("shares_definition", &ss::Reaction::shares_definition, py::arg("reaction"), R"pbdoc(
+            Returns whether this reaction and the given reaction share the same definition
+            (copies of a reaction share its propensity and stoichiometry)
+
+            Returns:
+
+            - boolean
+        )pbdoc")
         .def("get_propensity", &ss::Reaction::get_propensity, py::arg("num_molecules"), py::arg("voxel_size"),
         R"pbdoc(
             Returns propensity of the reaction given number of molecules and voxel size
@@ -57,6 +179,133 @@ PYBIND11_MODULE(pystospa, m) {
             - propensity
         )pbdoc");
 
+    py::enum_<ss::SelectionMethod>(m, "SelectionMethod", R"pbdoc(
+        Methods of picking the next reaction within a voxel
+
+        - direct = linear scan over the propensities, fastest for a handful of reactions
+        - sum_tree = binary tree of sums of propensities, faster for voxels with many reactions
+        - composition_rejection = bins of propensities, faster for voxels with many reactions whose propensities
+          span many orders of magnitude
+    )pbdoc")
+        .value("direct", ss::SelectionMethod::direct)
+        .value("sum_tree", ss::SelectionMethod::sum_tree)
+        .value("composition_rejection", ss::SelectionMethod::composition_rejection);
+
+    py::enum_<ss::QueueType>(m, "QueueType", R"pbdoc(
+        Data structures that hold the times of the next reactions in a simulation
+
+        - binary_heap = binary heap, a good default
+        - calendar = calendar queue, faster for domains with a very large number of voxels
+    )pbdoc")
+        .value("binary_heap", ss::QueueType::binary_heap)
+        .value("calendar", ss::QueueType::calendar);
+
+    py::enum_<ss::RngType>(m, "RngType", R"pbdoc(
+        Generators of random numbers
+
+        - mt19937 = a single Mersenne twister shared by all the voxels, the default
+        - philox = a counter-based Philox stream for each voxel keyed by (seed, replica, voxel)
+    )pbdoc")
+        .value("mt19937", ss::RngType::mt19937)
+        .value("philox", ss::RngType::philox);
+
+    py::enum_<ss::StoreLayout>(m, "StoreLayout", R"pbdoc(
+        Layouts of the buffer that holds the number of molecules of all the species in all the voxels
+
+        - voxel_major = all the species of a voxel are next to each other
+        - species_major = a single species of all the voxels is next to each other
+    )pbdoc")
+        .value("voxel_major", ss::StoreLayout::voxel_major)
+        .value("species_major", ss::StoreLayout::species_major);
+
+    py::enum_<ss::GrowthKind>(m, "GrowthKind", R"pbdoc(
+        Kinds of growth laws
+
+        - custom = the growth factor is given by a growth function
+        - constant, exponential, linear, logistic = closed-form growth laws
+        - piecewise = linear between the given points
+        - tabulated = a growth function sampled once and interpolated
+    )pbdoc")
+        .value("custom", ss::GrowthKind::custom)
+        .value("constant", ss::GrowthKind::constant)
+        .value("exponential", ss::GrowthKind::exponential)
+        .value("linear", ss::GrowthKind::linear)
+        .value("logistic", ss::GrowthKind::logistic)
+        .value("piecewise", ss::GrowthKind::piecewise)
+        .value("tabulated", ss::GrowthKind::tabulated);
+
+    py::class_<ss::GrowthLaw>(m, "GrowthLaw", R"pbdoc(
+        pystospa.GrowthLaw(growth_func)
+
+        GrowthLaw class constructor, the factor by which a voxel has grown in a single spatial dimension as a
+        function of time. Built-in laws are evaluated without calling back into Python.
+
+        Parameters:
+
+        - growth_func = lambda function that takes value of time and returns ratio by which voxel size has grown
+    )pbdoc")
+        .def(py::init(&python_growth_law))
+        .def_static("constant", &ss::GrowthLaw::constant, R"pbdoc(
+            Returns a law of a voxel that does not grow
+        )pbdoc")
+        .def_static("exponential", &ss::GrowthLaw::exponential, py::arg("rate"), R"pbdoc(
+            Returns the law exp(rate * t)
+
+            Parameters:
+
+            - rate = growth rate
+        )pbdoc")
+        .def_static("linear", &ss::GrowthLaw::linear, py::arg("rate"), R"pbdoc(
+            Returns the law 1 + rate * t
+
+            Parameters:
+
+            - rate = growth rate
+        )pbdoc")
+        .def_static("logistic", &ss::GrowthLaw::logistic, py::arg("rate"), py::arg("capacity"), R"pbdoc(
+            Returns the law capacity / (1 + (capacity - 1) * exp(-rate * t))
+
+            Parameters:
+
+            - rate = growth rate
+            - capacity = carrying capacity relative to the initial size
+        )pbdoc")
+        .def_static("piecewise", &ss::GrowthLaw::piecewise, py::arg("times"), py::arg("factors"), R"pbdoc(
+            Returns the law that is linear between the given points and constant before the first and after the last
+
+            Parameters:
+
+            - times = increasing times of the points
+            - factors = growth factors at the points
+        )pbdoc")
+        .def_static("tabulated", &ss::GrowthLaw::tabulated, py::arg("growth_func"), py::arg("start_time"),
+                    py::arg("end_time"), py::arg("num_points")=1001, R"pbdoc(
+            Returns the law that samples the given function once at evenly spaced times and interpolates linearly
+            between them, the factor is constant outside of the sampled interval
+
+            Parameters:
+
+            - growth_func = lambda function that takes value of time and returns ratio by which voxel size has grown
+            - start_time = first sampled time
+            - end_time = last sampled time
+            - num_points = number of sampled times
+        )pbdoc")
+        .def("__call__", &ss::GrowthLaw::operator(), py::arg("time"))
+        .def("range", &ss::GrowthLaw::range, py::arg("start_time"), py::arg("end_time"), R"pbdoc(
+            Returns the smallest and the largest growth factor over the given interval of time
+
+            Parameters:
+
+            - start_time = start of the interval
+            - end_time = end of the interval
+        )pbdoc")
+        .def("get_rate", &ss::GrowthLaw::get_rate, R"pbdoc(
+            Returns the growth rate of an exponential, linear or logistic law
+        )pbdoc")
+        .def("get_kind", &ss::GrowthLaw::get_kind, R"pbdoc(
+            Returns the kind of the growth law
+        )pbdoc");
+
     py::class_<ss::Voxel>(m, "Voxel", R"pbdoc(
         pystospa.Voxel(num_molecules, voxel_size, growth_func=None, extrande_ratio=2.0)
 
@@ -66,14 +315,30 @@ PYBIND11_MODULE(pystospa, m) {
 
         - num_molecules = array of number of molecules of each species
         - voxel_size = size (len/area/volume) of a voxel
-        - growth_func = lambda function that takes value of time and returns ratio by which voxel size has grown
+        - growth_func = lambda function that takes value of time and returns ratio by which voxel size has grown,
+          an instance of GrowthLaw or a list of either (one for each spatial dimension)
         - extrande_ratio = by how much the total propensity needs to be multiplied to get an upper bound
     )pbdoc")
         .def(py::init<std::vector<unsigned>, double>())
-        .def(py::init<std::vector<unsigned>, double, g_f>())
-        .def(py::init<std::vector<unsigned>, double, g_f, double>())
-        .def(py::init<std::vector<unsigned>, double, std::vector<g_f>>())
-        .def(py::init<std::vector<unsigned>, double, std::vector<g_f>, double>())
+        .def(py::init<std::vector<unsigned>, double, ss::GrowthLaw>())
+        .def(py::init<std::vector<unsigned>, double, ss::GrowthLaw, double>())
+        .def(py::init<std::vector<unsigned>, double, std::vector<ss::GrowthLaw>>())
+        .def(py::init<std::vector<unsigned>, double, std::vector<ss::GrowthLaw>, double>())
+        .def(py::init([](std::vector<unsigned> initial_num, double voxel_size, const py::function& growth) {
+            return ss::Voxel(std::move(initial_num), voxel_size, python_growth_law(growth));
+        }))
+        .def(py::init([](std::vector<unsigned> initial_num, double voxel_size, const py::function& growth,
+                         double extrande_ratio) {
+            return ss::Voxel(std::move(initial_num), voxel_size, python_growth_law(growth), extrande_ratio);
+        }))
+        .def(py::init([](std::vector<unsigned> initial_num, double voxel_size,
+                         const std::vector<py::function>& growth) {
+            return ss::Voxel(std::move(initial_num), voxel_size, python_growth_laws(growth));
+        }))
+        .def(py::init([](std::vector<unsigned> initial_num, double voxel_size,
+                         const std::vector<py::function>& growth, double extrande_ratio) {
+            return ss::Voxel(std::move(initial_num), voxel_size, python_growth_laws(growth), extrande_ratio);
+        }))
         .def("get_molecules", &ss::Voxel::get_molecules, R"pbdoc(
             Returns the number of molecules present in the voxel
 
@@ -95,6 +360,87 @@ PYBIND11_MODULE(pystospa, m) {
 
             - extrande ratio
         )pbdoc")
+        .def("get_diffusion_factor", &ss::Voxel::get_diffusion_factor, R"pbdoc(
+            Returns the factor by which growth of the voxel currently scales the rates of diffusion
+
+            Returns:
+
+            - diffusion factor
+        )pbdoc")
+        .def("set_look_ahead", &ss::Voxel::set_look_ahead, py::arg("look_ahead"),
+        R"pbdoc(
+            Sets the length of the look-ahead window over which the upper bound for the total propensity of a growing
+            voxel is computed from its growth, zero uses the extrande ratio instead
+
+            Parameters:
+
+            - look_ahead = length of the look-ahead window
+        )pbdoc")
+        .def("get_look_ahead", &ss::Voxel::get_look_ahead, R"pbdoc(
+            Returns the length of the look-ahead window used for the extrande bound
+
+            Returns:
+
+            - length of the look-ahead window
+        )pbdoc")
+        .def("set_integrated_hazard", &ss::Voxel::set_integrated_hazard, py::arg("integrated"),
+        R"pbdoc(
+            Sets whether the time of the next event is sampled by inverting the integrated total propensity of the
+            voxel, which is exact and rejects no events, instead of by extrande. Growth laws need to be constant,
+            exponential or linear with the same rate, and reactions of a growing voxel need to be mass-action.
+
+            Parameters:
+
+            - integrated = boolean
+        )pbdoc")
+        .def("get_integrated_hazard", &ss::Voxel::get_integrated_hazard, R"pbdoc(
+            Returns whether the time of the next event is sampled by inverting the integrated total propensity
+
+            Returns:
+
+            - boolean
+        )pbdoc")
+        .def("set_rate_schedule", &ss::Voxel::set_rate_schedule, py::arg("reaction_idx"), py::arg("times"),
+             py::arg("rates"),
+        R"pbdoc(
+            Sets a piecewise-constant rate of a reaction, which is rates[k] from times[k] until the next time and
+            is left unchanged before the first time
+
+            Parameters:
+
+            - reaction_idx = index of the reaction
+            - times = increasing times at which the rate changes
+            - rates = non-negative rate from each time on
+        )pbdoc")
+        .def("set_ratio_tuning", &ss::Voxel::set_ratio_tuning, py::arg("tune"), py::arg("target_rejection")=0.1,
+             py::arg("max_ratio")=10.0,
+        R"pbdoc(
+            Sets whether the extrande ratio of a growing voxel is tuned online to keep the fraction of rejected
+            (extrande) events near the target, tuning only applies without a look-ahead window
+
+            Parameters:
+
+            - tune = boolean
+            - target_rejection = fraction of rejected events to aim for
+            - max_ratio = largest extrande ratio that the tuning may set
+        )pbdoc")
+        .def("get_num_accepted", &ss::Voxel::get_num_accepted, R"pbdoc(
+            Returns the number of picked reactions that are not the extrande reaction
+
+            Returns:
+
+            - integer
+        )pbdoc")
+        .def("get_num_rejected", &ss::Voxel::get_num_rejected, R"pbdoc(
+            Returns the number of picked extrande reactions, i.e. events rejected by thinning
+
+            Returns:
+
+            - integer
+        )pbdoc")
+        .def("reset_extrande_statistics", &ss::Voxel::reset_extrande_statistics, R"pbdoc(
+            Resets the numbers of accepted and rejected events
+        )pbdoc")
         .def("add_reaction", &ss::Voxel::add_reaction, py::arg("reaction"),
         R"pbdoc(
             Adds the given reaction to the list of reactions contained within the voxel
@@ -110,6 +456,37 @@ PYBIND11_MODULE(pystospa, m) {
 
             - list of reactions
         )pbdoc")
+        .def("set_selection_method", &ss::Voxel::set_selection_method, py::arg("method"),
+        R"pbdoc(
+            Sets the method used to pick the next reaction within the voxel
+
+            Parameters:
+
+            - method = an instance of SelectionMethod
+        )pbdoc")
+        .def("set_check_counts", &ss::Voxel::set_check_counts, py::arg("check"),
+        R"pbdoc(
+            Sets whether changes in the number of molecules are checked, a checked change that would
+            make a number of molecules negative or larger than the largest unsigned integer raises an exception
+
+            Parameters:
+
+            - check = boolean
+        )pbdoc")
+        .def("get_check_counts", &ss::Voxel::get_check_counts, R"pbdoc(
+            Returns whether changes in the number of molecules are checked
+
+            Returns:
+
+            - boolean
+        )pbdoc")
+        .def("get_selection_method", &ss::Voxel::get_selection_method, R"pbdoc(
+            Returns the method used to pick the next reaction within the voxel
+
+            Returns:
+
+            - an instance of SelectionMethod
+        )pbdoc")
         .def("get_total_propensity", &ss::Voxel::get_total_propensity, py::arg("update")=true,
         R"pbdoc(
             Returns the total propensity given all the reactions within the voxel
@@ -128,7 +505,7 @@ PYBIND11_MODULE(pystospa, m) {
         )pbdoc");
 
    py::class_<ss::Simulator>(m, "Simulator", R"pbdoc(
-       pystospa.Simulator(voxels)
+       pystospa.Simulator(voxels, time=0, queue_type=QueueType.binary_heap, layout=StoreLayout.voxel_major)
 
        Simulator class constructor
 
@@ -136,16 +513,160 @@ PYBIND11_MODULE(pystospa, m) {
 
        - voxels = list of voxel objects already populated with molecules
        - time = initial value of time
+       - queue_type = an instance of QueueType
+       - layout = an instance of StoreLayout
    )pbdoc")
        .def(py::init<std::vector<ss::Voxel>>())
        .def(py::init<std::vector<ss::Voxel>, double>())
-       .def("set_seed", &ss::Simulator::set_seed, py::arg("seed"),
+       .def(py::init<std::vector<ss::Voxel>, double, ss::QueueType>())
+       .def(py::init<std::vector<ss::Voxel>, double, ss::QueueType, ss::StoreLayout>())
+       .def("set_seed", &ss::Simulator::set_seed, py::arg("seed"), py::arg("replica")=0,
        R"pbdoc(
            Sets the number used as the seed for random number generation
 
            Parameters:
 
            - seed = a number
+           - replica = index of the replica, which gives a different sequence of random numbers for the same seed
+       )pbdoc")
+       .def("set_rng_type", &ss::Simulator::set_rng_type, py::arg("type"),
+       R"pbdoc(
+           Sets the type of the random number generator, which is then seeded with the current seed and replica
+
+           Parameters:
+
+           - type = an instance of RngType
+       )pbdoc")
+       .def("set_rng_counters", &ss::Simulator::set_rng_counters, py::arg("counters"),
+       R"pbdoc(
+           Restores the state of the Philox streams saved by get_rng_counters
+
+           Parameters:
+
+           - counters = number of random values drawn from each stream
+       )pbdoc")
+       .def("set_selection_method", &ss::Simulator::set_selection_method, py::arg("method"),
+       R"pbdoc(
+           Sets the method used to pick the next reaction in all the voxels
+
+           Parameters:
+
+           - method = an instance of SelectionMethod
+       )pbdoc")
+       .def("set_look_ahead", &ss::Simulator::set_look_ahead, py::arg("look_ahead"),
+       R"pbdoc(
+           Sets the length of the look-ahead window over which the upper bound for the total propensity of the
+           growing voxels is computed from their growth, zero uses the extrande ratio of each voxel
+
+           Parameters:
+
+           - look_ahead = length of the look-ahead window
+       )pbdoc")
+       .def("set_integrated_hazard", &ss::Simulator::set_integrated_hazard, py::arg("integrated"),
+       R"pbdoc(
+           Sets whether the time of the next event in every voxel is sampled by inverting its integrated total
+           propensity instead of by extrande
+
+           Parameters:
+
+           - integrated = boolean
+       )pbdoc")
+       .def("set_ratio_tuning", &ss::Simulator::set_ratio_tuning, py::arg("tune"),
+            py::arg("target_rejection")=0.1, py::arg("max_ratio")=10.0,
+       R"pbdoc(
+           Sets whether the extrande ratio of each growing voxel is tuned online to keep the fraction of rejected
+           (extrande) events near the target
+
+           Parameters:
+
+           - tune = boolean
+           - target_rejection = fraction of rejected events to aim for
+           - max_ratio = largest extrande ratio that the tuning may set
+       )pbdoc")
+       .def("get_num_accepted", &ss::Simulator::get_num_accepted,
+       R"pbdoc(
+           Returns the number of accepted events, i.e. reactions other than the extrande reaction, in each voxel
+
+           Returns:
+
+           - list of integers
+       )pbdoc")
+       .def("get_num_rejected", &ss::Simulator::get_num_rejected,
+       R"pbdoc(
+           Returns the number of events rejected by thinning, i.e. extrande reactions, in each voxel
+
+           Returns:
+
+           - list of integers
+       )pbdoc")
+       .def("get_extrande_ratios", &ss::Simulator::get_extrande_ratios,
+       R"pbdoc(
+           Returns the extrande ratio of each voxel, which changes over time if it is tuned
+
+           Returns:
+
+           - list of floats
+       )pbdoc")
+       .def("reset_extrande_statistics", &ss::Simulator::reset_extrande_statistics,
+       R"pbdoc(
+           Resets the numbers of accepted and rejected events in all the voxels
+       )pbdoc")
+       .def("set_check_counts", &ss::Simulator::set_check_counts, py::arg("check"),
+       R"pbdoc(
+           Sets whether changes in the number of molecules are checked in all the voxels, a reaction that
+           would make a number of molecules negative or larger than the largest unsigned integer then raises
+           an exception
+
+           Parameters:
+
+           - check = boolean
+       )pbdoc")
+       .def("refresh_propensities", &ss::Simulator::refresh_propensities,
+       R"pbdoc(
+           Re-evaluates the propensities of all the reactions in all the voxels, evaluating mass-action reactions
+           for many voxels at once (which is fastest with a species-major molecule store)
+       )pbdoc")
+       .def("get_queue_type", &ss::Simulator::get_queue_type,
+       R"pbdoc(
+           Returns the data structure that holds the times of the next reactions
+
+           Returns:
+
+           - an instance of QueueType
+       )pbdoc")
+       .def("get_num_reaction_definitions", &ss::Simulator::get_num_reaction_definitions,
+       R"pbdoc(
+           Returns the number of distinct reaction definitions shared by the voxels
+
+           Returns:
+
+           - integer
+       )pbdoc")
+       .def("get_num_growth_laws", &ss::Simulator::get_num_growth_laws,
+       R"pbdoc(
+           Returns the number of distinct growth laws shared by the voxels, each of which is evaluated once for
+           each distinct time
+       )pbdoc")
+       .def("get_replica", &ss::Simulator::get_replica,
+       R"pbdoc(
+           Returns the index of the replica used to generate the random numbers
+       )pbdoc")
+       .def("get_rng_type", &ss::Simulator::get_rng_type,
+       R"pbdoc(
+           Returns the type of the random number generator
+
+           Returns:
+
+           - an instance of RngType
+       )pbdoc")
+       .def("get_rng_counters", &ss::Simulator::get_rng_counters,
+       R"pbdoc(
+           Returns the number of random values drawn from the Philox stream of each voxel (and of the whole
+           domain), which together with the seed and the replica is the whole state of the generator
+
+           Returns:
+
+           - list of integers
        )pbdoc")
        .def("get_seed", &ss::Simulator::get_seed,
        R"pbdoc(
@@ -179,6 +700,22 @@ PYBIND11_MODULE(pystospa, m) {
 
            - number of molecules present in the whole simulation
        )pbdoc")
+       .def("get_molecule_store", &ss::Simulator::get_molecule_store,
+       R"pbdoc(
+           Returns the number of molecules of all the species in all the voxels in the layout of the store
+
+           Returns:
+
+           - number of molecules present in the whole simulation
+       )pbdoc")
+       .def("get_store_layout", &ss::Simulator::get_store_layout,
+       R"pbdoc(
+           Returns the layout of the buffer that holds the number of molecules
+
+           Returns:
+
+           - an instance of StoreLayout
+       )pbdoc")
        .def("step", &ss::Simulator::step,
        R"pbdoc(
            Makes a single step in the stochastic simulation algorithm
@@ -202,4 +739,279 @@ PYBIND11_MODULE(pystospa, m) {
             - num_steps = number of steps in time to take
             - header = the string which to write at the top of the file
         )pbdoc");
+
+   py::class_<ss::TauLeapSimulator, ss::Simulator>(m, "TauLeapSimulator", R"pbdoc(
+       pystospa.TauLeapSimulator(voxels, time=0, epsilon=0.03, num_critical=10)
+
+       TauLeapSimulator class constructor - approximate simulation with the adaptive tau-leaping method,
+       suitable for large numbers of molecules. Falls back to exact steps when tau-leaping is not worthwhile.
+
+       Parameters:
+
+       - voxels = list of voxel objects already populated with molecules
+       - time = initial value of time
+       - epsilon = bound on the relative change of propensities in a single step
+       - num_critical = reactions that can fire fewer than this number of times fire at most once per step
+   )pbdoc")
+       .def(py::init<std::vector<ss::Voxel>>())
+       .def(py::init<std::vector<ss::Voxel>, double>())
+       .def(py::init<std::vector<ss::Voxel>, double, double>())
+       .def(py::init<std::vector<ss::Voxel>, double, double, unsigned>())
+       .def("get_epsilon", &ss::TauLeapSimulator::get_epsilon,
+       R"pbdoc(
+           Returns the bound on the relative change of propensities in a single step
+
+           Returns:
+
+           - epsilon
+       )pbdoc");
+
+   py::class_<ss::HybridSimulator, ss::Simulator>(m, "HybridSimulator", R"pbdoc(
+       pystospa.HybridSimulator(voxels, time=0, time_step=0.01, threshold=1000, langevin=True)
+
+       HybridSimulator class constructor - reactions that only change species with many molecules are integrated
+       as the chemical Langevin equation (or reaction rate equations), the remaining ones are simulated exactly
+
+       Parameters:
+
+       - voxels = list of voxel objects already populated with molecules
+       - time = initial value of time
+       - time_step = size of the steps in time
+       - threshold = reactions that only change species with at least this number of molecules are fast
+       - langevin = whether fast reactions include noise or not
+   )pbdoc")
+       .def(py::init<std::vector<ss::Voxel>>())
+       .def(py::init<std::vector<ss::Voxel>, double>())
+       .def(py::init<std::vector<ss::Voxel>, double, double>())
+       .def(py::init<std::vector<ss::Voxel>, double, double, unsigned>())
+       .def(py::init<std::vector<ss::Voxel>, double, double, unsigned, bool>())
+       .def("get_time_step", &ss::HybridSimulator::get_time_step,
+       R"pbdoc(
+           Returns the size of the steps in time
+
+           Returns:
+
+           - time step
+       )pbdoc")
+       .def("get_num_fast_reactions", &ss::HybridSimulator::get_num_fast_reactions,
+       R"pbdoc(
+           Returns the number of reactions that were integrated as continuous in the last step
+
+           Returns:
+
+           - number of fast reactions
+       )pbdoc");
+
+   py::class_<ss::ParallelSimulator, ss::Simulator>(m, "ParallelSimulator", R"pbdoc(
+       pystospa.ParallelSimulator(voxels, time=0, num_threads=0)
+
+       ParallelSimulator class constructor - runs a single simulation on many threads, each of which simulates a
+       subdomain of contiguous voxels. The events are exactly those of a Simulator with the same seed and the
+       Philox random streams, whatever the number of threads.
+
+       Parameters:
+
+       - voxels = list of voxel objects already populated with molecules
+       - time = initial value of time
+       - num_threads = number of threads, zero uses the number of hardware threads
+   )pbdoc")
+       .def(py::init<std::vector<ss::Voxel>>())
+       .def(py::init<std::vector<ss::Voxel>, double>())
+       .def(py::init<std::vector<ss::Voxel>, double, unsigned>())
+       .def("set_num_threads", &ss::ParallelSimulator::set_num_threads, py::arg("num_threads"),
+       R"pbdoc(
+           Sets the number of threads and partitions the voxels into a subdomain for each of them
+
+           Parameters:
+
+           - num_threads = integer, zero uses the number of hardware threads
+       )pbdoc")
+       .def("get_num_threads", &ss::ParallelSimulator::get_num_threads,
+       R"pbdoc(
+           Returns the number of threads
+       )pbdoc")
+       .def("get_num_subdomains", &ss::ParallelSimulator::get_num_subdomains,
+       R"pbdoc(
+           Returns the number of subdomains, i.e. the number of threads unless there are fewer voxels
+       )pbdoc")
+       .def("set_window", &ss::ParallelSimulator::set_window, py::arg("window"), py::arg("events_per_window")=100.0,
+       R"pbdoc(
+           Sets the length of the next window of time, which does not change the results
+
+           Parameters:
+
+           - window = length of the next window, zero chooses it from the total propensity
+           - events_per_window = average number of events in a subdomain used to choose the length
+       )pbdoc")
+       .def("get_window", &ss::ParallelSimulator::get_window,
+       R"pbdoc(
+           Returns the length of the next window of time
+       )pbdoc")
+       .def("get_num_windows", &ss::ParallelSimulator::get_num_windows,
+       R"pbdoc(
+           Returns the number of windows of time simulated
+       )pbdoc")
+       .def("get_num_rounds", &ss::ParallelSimulator::get_num_rounds,
+       R"pbdoc(
+           Returns the number of rounds simulated, i.e. simulations of a window with the messages known so far
+       )pbdoc")
+       .def("get_num_rollbacks", &ss::ParallelSimulator::get_num_rollbacks,
+       R"pbdoc(
+           Returns the number of times that each subdomain has been rolled back to the start of a window
+       )pbdoc")
+       .def("advance", &ss::ParallelSimulator::advance, py::arg("time_point"),
+            py::call_guard<py::gil_scoped_release>(),
+       R"pbdoc(
+           Executes all the events before the specified time point on the threads of the subdomains
+       )pbdoc")
+       .def("run", &ss::ParallelSimulator::run,
+            py::arg("name"),
+            py::arg("time_step"),
+            py::arg("num_steps"),
+            py::arg("header")="# time voxels...\n",
+            py::call_guard<py::gil_scoped_release>(),
+        R"pbdoc(
+            Runs the simulation on the threads of the subdomains and saves the output in a file, the
+            propensities given as Python functions are called by one thread at a time
+
+            Parameters:
+
+            - name = name of the file where to save the output of the simulation
+            - time_step = how far to advance in time before saving the state of the simulation
+            - num_steps = number of steps in time to take
+            - header = the string which to write at the top of the file
+        )pbdoc");
+
+   py::class_<ss::Ensemble>(m, "Ensemble", R"pbdoc(
+       pystospa.Ensemble(voxels, num_replicas, seed, num_threads=0)
+
+       Ensemble class constructor - runs many independent replicas of the same model concurrently on a pool of
+       worker threads, the seed of each replica is derived from the master seed and the index of the replica
+
+       Parameters:
+
+       - voxels = list of voxel objects already populated with molecules, or a simulator that every replica
+         is a copy of, the replicas are simulated by the class of the simulator (e.g. TauLeapSimulator)
+       - num_replicas = number of replicas
+       - seed = master seed
+       - num_threads = number of worker threads, zero uses the number of hardware threads
+   )pbdoc")
+       .def(py::init<std::vector<ss::Voxel>, unsigned, unsigned>())
+       .def(py::init<std::vector<ss::Voxel>, unsigned, unsigned, unsigned>())
+       .def(py::init<const ss::Simulator&, unsigned, unsigned>())
+       .def(py::init<const ss::Simulator&, unsigned, unsigned, unsigned>())
+       .def_static("replica_seed", &ss::Ensemble::replica_seed, py::arg("seed"), py::arg("replica"),
+       R"pbdoc(
+           Returns the seed of a replica
+
+           Parameters:
+
+           - seed = master seed
+           - replica = index of the replica
+       )pbdoc")
+       .def("set_num_threads", &ss::Ensemble::set_num_threads, py::arg("num_threads"),
+       R"pbdoc(
+           Sets the number of worker threads, zero uses the number of hardware threads
+
+           Parameters:
+
+           - num_threads = integer
+       )pbdoc")
+       .def("get_num_threads", &ss::Ensemble::get_num_threads,
+       R"pbdoc(
+           Returns the number of worker threads
+       )pbdoc")
+       .def("get_num_replicas", &ss::Ensemble::get_num_replicas,
+       R"pbdoc(
+           Returns the number of replicas
+       )pbdoc")
+       .def("get_seed", &ss::Ensemble::get_seed,
+       R"pbdoc(
+           Returns the master seed
+       )pbdoc")
+       .def("run", static_cast<std::vector<std::vector<unsigned>> (ss::Ensemble::*)(double)>(&ss::Ensemble::run),
+            py::arg("time_point"), py::call_guard<py::gil_scoped_release>(),
+       R"pbdoc(
+           Runs every replica until the given time
+
+           Parameters:
+
+           - time_point = the point in time that every replica reaches
+
+           Returns:
+
+           - list with the number of molecules in each voxel of each replica
+       )pbdoc")
+       .def("run", static_cast<void (ss::Ensemble::*)(const std::vector<double>&,
+            const std::function<void (const unsigned&, const double&, const std::vector<unsigned>&)>&)>(
+            &ss::Ensemble::run), py::arg("time_points"), py::arg("output"),
+            py::call_guard<py::gil_scoped_release>(),
+       R"pbdoc(
+           Runs every replica through the given times and passes the number of molecules at each of them to the
+           given function as soon as it is reached, one call at a time
+
+           Parameters:
+
+           - time_points = increasing points in time that every replica reaches
+           - output = function that takes the index of a replica, the time and the number of molecules
+       )pbdoc");
+
+   py::class_<ss::KernelCompiler>(m, "KernelCompiler", R"pbdoc(
+       pystospa.KernelCompiler(cache_dir="", compiler="", flags="-O3 -std=c++14 -shared -fPIC")
+
+       KernelCompiler class constructor. It compiles the propensities of mass-action and expression reactions
+       into native functions with the system compiler. Compiled libraries are cached under a hash of the model,
+       so that repeated runs skip the compilation.
+
+       Parameters:
+
+       - cache_dir = directory for the compiled libraries, owned by the user and not writable by others
+         (STOSPA_KERNEL_CACHE, or stospa/kernels in XDG_CACHE_HOME or ~/.cache if empty)
+       - compiler = command that runs the C++ compiler (CXX or c++ if empty)
+       - flags = flags passed to the compiler
+   )pbdoc")
+       .def(py::init<>())
+       .def(py::init<std::string>())
+       .def(py::init<std::string, std::string>())
+       .def(py::init<std::string, std::string, std::string>())
+       .def("generate", &ss::KernelCompiler::generate, py::arg("voxels"),
+       R"pbdoc(
+           Returns the C++ code with the propensity functions of a model
+
+           Parameters:
+
+           - voxels = list of voxel objects
+
+           Returns:
+
+           - the C++ code
+       )pbdoc")
+       .def("compile", &ss::KernelCompiler::compile, py::arg("voxels"),
+       R"pbdoc(
+           Compiles (or loads from the cache) the propensity functions of a model
+
+           Parameters:
+
+           - voxels = list of voxel objects
+
+           Returns:
+
+           - list of voxel objects whose reactions call the compiled functions
+       )pbdoc")
+       .def("get_library_path", &ss::KernelCompiler::get_library_path,
+       R"pbdoc(
+           Returns the path to the library used by the last compilation
+
+           Returns:
+
+           - path to the library
+       )pbdoc")
+       .def("was_cached", &ss::KernelCompiler::was_cached,
+       R"pbdoc(
+           Returns whether the last compilation found the library in the cache
+
+           Returns:
+
+           - whether the library was cached
+       )pbdoc");
 }
@@ -3,12 +3,22 @@
 #define REACTION_HPP
 
 // stl
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
 
+// other header files
+#include "expression.hpp"
+#include "molecule_store.hpp"
+
 /**
  * Overloaded == operator for std::vector class. This operator is used in
  * the reaction class to compare certain member variables
@@ -45,12 +55,81 @@ bool operator != (const std::vector<T>& v1, const std::vector<T>& v2) {
  */
 typedef std::function<double (const std::vector<unsigned>&, const double&)> p_f;
 
+/**
+ * Type alias \c propensity_kernel for a compiled propensity function (see KernelCompiler), which takes the
+ * number of molecules as an array and the voxel size
+ */
+typedef double (*propensity_kernel)(const unsigned*, double);
+
 namespace StoSpa2 {
 
+/**
+ * Kinds of reactions: custom reactions evaluate a propensity function, mass-action reactions of order
+ * zero to three evaluate their propensity directly from the indices of their reactants and expression
+ * reactions evaluate a compiled propensity expression
+ */
+enum class ReactionKind { custom, zeroth_order, first_order, second_order, third_order, expression };
+
+/**
+ * SpeciesChange struct - change in the number of molecules of a single species. A stoichiometry vector is
+ * also held sparsely as the changes of the species for which it is non-zero.
+ */
+struct SpeciesChange {
+    /** Index of the species */
+    unsigned species;
+
+    /** Change in the number of molecules */
+    int delta;
+};
+
+/**
+ * ReactionDefinition struct - the parts of a reaction that do not change during a simulation, i.e. how the
+ * propensity is evaluated and the stoichiometry. A definition is shared by all the copies of a reaction (and by
+ * all the reactions interned in a ReactionTable), so that identical chemistry in many voxels is held only once.
+ */
+struct ReactionDefinition {
+    /** Lambda function that returns propensity given the numebr of molecules and the area of a voxell */
+    p_f propensity;
+
+    /** The stoichiometry vector, which is never replaced once the definition is created */
+    std::shared_ptr<const std::vector<int>> stoichiometry;
+
+    /** The non-zero entries of the stoichiometry vector, which are never replaced either */
+    std::shared_ptr<const std::vector<SpeciesChange>> changes;
+
+    /** Indices of the species on which the propensity depends */
+    std::vector<unsigned> dependencies;
+
+    /** Whether the species on which the propensity depends have been given (otherwise it depends on all species) */
+    bool has_dependencies = false;
+
+    /** Kind of the reaction, which determines how the propensity is evaluated */
+    ReactionKind kind = ReactionKind::custom;
+
+    /** Indices of the reactants of a mass-action reaction in increasing order */
+    std::vector<unsigned> reactants;
+
+    /** Indices of the reactants of a mass-action reaction (unused entries are zero) */
+    std::array<unsigned, 3> species = {{0, 0, 0}};
+
+    /** Number of preceding reactants of the same species, subtracted to count distinct combinations of molecules */
+    std::array<double, 3> repeats = {{0.0, 0.0, 0.0}};
+
+    /** Compiled propensity expression */
+    std::shared_ptr<const StoSpa2::Expression> expression;
+
+    /** Natively compiled propensity function (nullptr if the propensity is not compiled) */
+    propensity_kernel kernel = nullptr;
+
+    /** Handle of the shared library that contains kernel, which stays loaded while the definition exists */
+    std::shared_ptr<void> library;
+};
+
 /**
  * Reaction class - represents a reaction within stochastic modelling. Reaction class contains
  * rate of a reaction, propensity and stoichiometry vector, all of which need to be given to the
- * constructor.
+ * constructor. Only the rate and the diffusion index belong to each instance, the rest is held in
+ * a ReactionDefinition shared by all the copies of the reaction.
  */
 class Reaction {
 protected:
@@ -60,12 +139,87 @@ protected:
     /** Rate of reaction that can be updated, hence can be different from m_inital rate */
     double m_rate;
 
-    /** Lambda function that returns propensity given the numebr of molecules and the area of a voxell */
-    p_f m_propensity;
+    /** Shared definition of the reaction (propensity, stoichiometry and dependencies) */
+    std::shared_ptr<const ReactionDefinition> m_definition;
+
+    /**
+     * Returns a new definition of a custom reaction
+     * @param propensity lambda function that returns propensity given number of molecules and voxel area
+     * @param stoichiometry_vec stoichiometry vector
+     */
+    static std::shared_ptr<ReactionDefinition> definition(p_f propensity, std::vector<int> stoichiometry_vec) {
+        auto d = std::make_shared<ReactionDefinition>();
+        d->propensity = std::move(propensity);
+        std::vector<SpeciesChange> changes;
+        for (unsigned i=0; i<stoichiometry_vec.size(); i++) {
+            if (stoichiometry_vec[i] != 0) {
+                changes.push_back({i, stoichiometry_vec[i]});
+            }
+        }
+        d->stoichiometry = std::make_shared<const std::vector<int>>(std::move(stoichiometry_vec));
+        d->changes = std::make_shared<const std::vector<SpeciesChange>>(std::move(changes));
+        return d;
+    }
+
+    /**
+     * Returns a copy of the definition that only this instance uses, so that it can be modified without
+     * affecting the other reactions that share the definition
+     */
+    ReactionDefinition& own_definition() {
+        auto definition = std::make_shared<ReactionDefinition>(*m_definition);
+        m_definition = definition;
+        return *definition;
+    }
+
+    /**
+     * Returns the mass-action propensity (without the rate), i.e. the number of distinct combinations of reactant
+     * molecules divided by the voxel size raised to the order minus one
+     * @param num_molecules pointer to the number of molecules of the first species
+     * @param stride distance between the numbers of molecules of consecutive species
+     * @param voxel_size length / area / volume of a voxel
+     */
+    double mass_action(const unsigned* num_molecules, const std::size_t& stride, const double& voxel_size) const {
+        const auto& s = m_definition->species;
+        const auto& repeats = m_definition->repeats;
+        switch (m_definition->kind) {
+            case ReactionKind::zeroth_order:
+                return voxel_size;
+            case ReactionKind::first_order:
+                return num_molecules[s[0] * stride];
+            case ReactionKind::second_order:
+                return num_molecules[s[0] * stride] * (num_molecules[s[1] * stride] - repeats[1]) / voxel_size;
+            case ReactionKind::third_order:
+                return num_molecules[s[0] * stride] * (num_molecules[s[1] * stride] - repeats[1])
+                       * (num_molecules[s[2] * stride] - repeats[2]) / (voxel_size * voxel_size);
+            default:
+                return 0.0;
+        }
+    }
+
+    /**
+     * Constructor for a reaction with an existing definition, used by ReactionTable
+     * @param definition the shared definition of the reaction
+     * @param initial_rate initial rate of the reaction
+     * @param rate current rate of the reaction
+     * @param diffusion_index index of the voxel in a vector of voxels where a molecule would jump
+     */
+    Reaction(std::shared_ptr<const ReactionDefinition> definition, double initial_rate, double rate,
+             int diffusion_index) :
+        m_initial_rate(initial_rate),
+        m_rate(rate),
+        m_definition(std::move(definition)),
+        stoichiometry(*m_definition->stoichiometry),
+        changes(*m_definition->changes),
+        diffusion_idx(diffusion_index) {}
+
+    friend class ReactionTable;
 
 public:
     /** The stoichiometry vector i.e. how the number of molecules changes if this reaction happens */
-    const std::vector<int> stoichiometry;
+    const std::vector<int>& stoichiometry;
+
+    /** The non-zero entries of the stoichiometry vector, so that only the species that change are updated */
+    const std::vector<SpeciesChange>& changes;
 
     /** Variable used to indicate if this reaction is a diffusion reaction */
     const int diffusion_idx;
@@ -78,12 +232,66 @@ public:
      * @param diffusion_index index of the voxel in a vector of voxels where a molecule would jump
      */
     Reaction(double rate, p_f propensity, std::vector<int> stoichiometry_vec, int diffusion_index=-1) :
-        stoichiometry(std::move(stoichiometry_vec)),
-        diffusion_idx(diffusion_index) {
+        Reaction(definition(std::move(propensity), std::move(stoichiometry_vec)), rate, rate, diffusion_index) {}
 
-        m_initial_rate = rate;
-        m_rate = rate;
-        m_propensity = std::move(propensity);
+    /**
+     * Copy constructor for Reaction class, the copy shares the definition of the reaction
+     * @param r the reaction to be copied
+     */
+    Reaction(const Reaction& r) : Reaction(r.m_definition, r.m_initial_rate, r.m_rate, r.diffusion_idx) {}
+
+    /**
+     * Creates a mass-action reaction, whose propensity is evaluated without calling a propensity function.
+     * For example, reactants {} give the propensity voxel_size, {i} give mols[i], {i, j} give
+     * mols[i]*mols[j]/voxel_size and {i, i} give mols[i]*(mols[i]-1)/voxel_size.
+     * @param rate the rate of the reaction
+     * @param reactants indices of the species of the reactants (at most three, repeated for multiple molecules)
+     * @param stoichiometry_vec stoichiometry vector
+     * @param diffusion_index index of the voxel in a vector of voxels where a molecule would jump
+     * @return the reaction, which depends on its reactants only
+     */
+    static Reaction mass_action(double rate, std::vector<unsigned> reactants, std::vector<int> stoichiometry_vec,
+                                int diffusion_index=-1) {
+        if (reactants.size() > 3) {
+            throw std::runtime_error("Reaction::mass_action: at most three reactants are supported");
+        }
+
+        auto d = definition(nullptr, std::move(stoichiometry_vec));
+        const ReactionKind kinds[] = {ReactionKind::zeroth_order, ReactionKind::first_order,
+                                      ReactionKind::second_order, ReactionKind::third_order};
+        d->kind = kinds[reactants.size()];
+
+        std::sort(reactants.begin(), reactants.end());
+        for (unsigned i=0; i<reactants.size(); i++) {
+            d->species[i] = reactants[i];
+            d->repeats[i] = (i > 0 and reactants[i] == reactants[i-1]) ? d->repeats[i-1] + 1.0 : 0.0;
+        }
+        d->reactants = reactants;
+
+        reactants.erase(std::unique(reactants.begin(), reactants.end()), reactants.end());
+        d->dependencies = std::move(reactants);
+        d->has_dependencies = true;
+        return Reaction(std::move(d), rate, rate, diffusion_index);
+    }
+
+    /**
+     * Creates a reaction whose propensity is given as an expression, e.g. "A*(A-1)*B/V^2", which is compiled
+     * once and then evaluated natively (see Expression)
+     * @param rate the rate of the reaction
+     * @param expression the propensity expression, in which V stands for the voxel size
+     * @param species names of the species in the order of their indices
+     * @param stoichiometry_vec stoichiometry vector
+     * @param diffusion_index index of the voxel in a vector of voxels where a molecule would jump
+     * @return the reaction, which depends on the species that appear in the expression only
+     */
+    static Reaction from_expression(double rate, std::string expression, std::vector<std::string> species,
+                                    std::vector<int> stoichiometry_vec, int diffusion_index=-1) {
+        auto d = definition(nullptr, std::move(stoichiometry_vec));
+        d->kind = ReactionKind::expression;
+        d->expression = std::make_shared<const StoSpa2::Expression>(std::move(expression), std::move(species));
+        d->dependencies = d->expression->get_species();
+        d->has_dependencies = true;
+        return Reaction(std::move(d), rate, rate, diffusion_index);
     }
 
     /**
@@ -102,6 +310,115 @@ public:
         return m_rate;
     }
 
+    /**
+     * Sets the species on which the propensity depends. The propensity is then only re-evaluated
+     * when the number of molecules of one of these species changes.
+     * @param dependencies indices of the species on which the propensity depends
+     */
+    void set_dependencies(std::vector<unsigned> dependencies) {
+        auto& d = own_definition();
+        d.dependencies = std::move(dependencies);
+        d.has_dependencies = true;
+    }
+
+    /**
+     * Returns the species on which the propensity depends
+     * @return copy of the dependencies of the definition
+     */
+    std::vector<unsigned> get_dependencies() const {
+        return m_definition->dependencies;
+    }
+
+    /**
+     * Returns whether the species on which the propensity depends have been given
+     * @return copy of the has_dependencies flag of the definition
+     */
+    bool has_dependencies() const {
+        return m_definition->has_dependencies;
+    }
+
+    /**
+     * Returns the kind of the reaction
+     * @return copy of the kind of the definition
+     */
+    ReactionKind get_kind() const {
+        return m_definition->kind;
+    }
+
+    /**
+     * Returns the indices of the reactants of a mass-action reaction in increasing order
+     * @return copy of the reactants of the definition
+     */
+    std::vector<unsigned> get_reactants() const {
+        return m_definition->reactants;
+    }
+
+    /**
+     * Returns the propensity expression of an expression reaction (an empty string otherwise)
+     */
+    std::string get_expression() const {
+        return m_definition->expression ? m_definition->expression->get_text() : "";
+    }
+
+    /**
+     * Returns the body of a C++ function that evaluates the propensity (without the rate), in which the number
+     * of molecules are given by the array x and the voxel size by V, or an empty string for custom reactions
+     */
+    std::string propensity_code() const {
+        const auto& d = *m_definition;
+        auto species = [&d](const unsigned& p) {
+            std::string x = "(double) x[" + std::to_string(d.species[p]) + "]";
+            return d.repeats[p] > 0 ? "(" + x + " - " + std::to_string((int) d.repeats[p]) + ".0)" : x;
+        };
+        switch (d.kind) {
+            case ReactionKind::zeroth_order:
+                return "    return V;\n";
+            case ReactionKind::first_order:
+                return "    return " + species(0) + ";\n";
+            case ReactionKind::second_order:
+                return "    return " + species(0) + " * " + species(1) + " / V;\n";
+            case ReactionKind::third_order:
+                return "    return " + species(0) + " * " + species(1) + " * " + species(2) + " / (V * V);\n";
+            case ReactionKind::expression:
+                return d.expression->to_cpp();
+            default:
+                return "";
+        }
+    }
+
+    /**
+     * Sets a natively compiled propensity function that is used instead of evaluating the propensity otherwise
+     * @param kernel compiled function equivalent to propensity_code()
+     * @param library handle of the shared library that contains the function
+     */
+    void set_kernel(propensity_kernel kernel, std::shared_ptr<void> library) {
+        auto& d = own_definition();
+        d.kernel = kernel;
+        d.library = std::move(library);
+    }
+
+    /**
+     * Returns whether the propensity is evaluated by a natively compiled function
+     */
+    bool is_compiled() const {
+        return m_definition->kernel != nullptr;
+    }
+
+    /**
+     * Returns the shared definition of the reaction, which stays valid while the reaction exists
+     */
+    const ReactionDefinition& get_definition() const {
+        return *m_definition;
+    }
+
+    /**
+     * Returns whether this reaction and the given reaction share the same definition
+     * @param r the other reaction
+     */
+    bool shares_definition(const Reaction& r) const {
+        return m_definition == r.m_definition;
+    }
+
     /**
      * Updates any properties of the reaction instance, such as the rate
      * @param factor value by which to mulpiply the initial reaction rate (m_initial_rate)
@@ -118,7 +435,42 @@ public:
      * @param voxel_size length / area / volume of a voxel
      */
     double get_propensity(const std::vector<unsigned>& num_molecules, const double& voxel_size) {
-        return m_rate * m_propensity(num_molecules, voxel_size);
+        const auto& d = *m_definition;
+        if (d.kernel) {
+            return m_rate * d.kernel(num_molecules.data(), voxel_size);
+        }
+        if (d.kind == ReactionKind::expression) {
+            return m_rate * d.expression->evaluate(num_molecules, voxel_size);
+        }
+        if (d.kind != ReactionKind::custom) {
+            return m_rate * mass_action(num_molecules.data(), 1, voxel_size);
+        }
+        return m_rate * d.propensity(num_molecules, voxel_size);
+    }
+
+    /**
+     * Returns the value of propensity given the number of molecules of a voxel (which may be a view into a
+     * MoleculeStore) and voxel length/area
+     * @param num_molecules number of molecules of each species
+     * @param voxel_size length / area / volume of a voxel
+     */
+    double get_propensity(const StoSpa2::MoleculeCounts& num_molecules, const double& voxel_size) {
+        const auto& d = *m_definition;
+        std::size_t stride = num_molecules.stride();
+        if (d.kernel and stride == 1) {
+            return m_rate * d.kernel(num_molecules.data(), voxel_size);
+        }
+        if (d.kind == ReactionKind::expression) {
+            return m_rate * d.expression->evaluate(num_molecules.data(), stride, voxel_size);
+        }
+        if (d.kind != ReactionKind::custom) {
+            return m_rate * mass_action(num_molecules.data(), stride, voxel_size);
+        }
+
+        // Propensity functions take a vector, so the molecules are gathered into a buffer reused by each thread
+        static thread_local std::vector<unsigned> buffer;
+        num_molecules.gather(buffer);
+        return m_rate * d.propensity(buffer, voxel_size);
     }
 
     /**
@@ -149,6 +501,9 @@ public:
         if (r1.m_rate != r2.m_rate) { return false; }
         if (r1.diffusion_idx != r2.diffusion_idx) { return false; }
         if (r1.stoichiometry != r2.stoichiometry) { return false; }
+        if (r1.get_kind() != r2.get_kind()) { return false; }
+        if (r1.m_definition->reactants != r2.m_definition->reactants) { return false; }
+        if (r1.get_expression() != r2.get_expression()) { return false; }
         return true;
     }
 
@@ -163,6 +518,83 @@ public:
     }
 };
 
+/**
+ * ReactionTable class - interns the definitions of reactions, so that all the equal reactions of a model
+ * (e.g. the same chemistry in every voxel) share a single definition. Mass-action and expression reactions are
+ * equal if they evaluate the same propensity and have the same stoichiometry and dependencies. Custom reactions
+ * cannot be compared, so only the copies of the same custom reaction share a definition.
+ */
+class ReactionTable {
+protected:
+    /** Interned definitions, in the order in which they were added */
+    std::vector<std::shared_ptr<const ReactionDefinition>> m_definitions;
+
+    /** Index of the definition for each key */
+    std::map<std::string, unsigned> m_indices;
+
+    /**
+     * Returns the key under which the definition of the given reaction is interned
+     * @param r reference to an instance of Reaction class
+     */
+    static std::string key(const Reaction& r) {
+        const auto& d = *r.m_definition;
+        if (d.kind == ReactionKind::custom) {
+            return "custom " + std::to_string((std::uintptr_t) &d);
+        }
+        std::string text = std::to_string((int) d.kind) + " " + r.get_expression() + "\n" + r.propensity_code();
+        text += "stoichiometry";
+        for (const auto& s : r.stoichiometry) {
+            text += " " + std::to_string(s);
+        }
+        text += d.has_dependencies ? "\ndependencies" : "\nall";
+        for (const auto& species : d.dependencies) {
+            text += " " + std::to_string(species);
+        }
+        text += "\nkernel " + std::to_string((std::uintptr_t) d.kernel);
+        return text;
+    }
+
+public:
+
+    /**
+     * Adds the definition of a reaction to the table, unless an equal definition is already there
+     * @param r reference to an instance of Reaction class
+     * @return index of the definition in the table
+     */
+    unsigned add(const Reaction& r) {
+        std::string k = key(r);
+        auto it = m_indices.find(k);
+        if (it == m_indices.end()) {
+            it = m_indices.emplace(std::move(k), m_definitions.size()).first;
+            m_definitions.push_back(r.m_definition);
+        }
+        return it->second;
+    }
+
+    /**
+     * Returns a copy of the given reaction that uses the definition interned in the table
+     * @param r reference to an instance of Reaction class
+     */
+    Reaction share(const Reaction& r) {
+        return Reaction(m_definitions[add(r)], r.m_initial_rate, r.m_rate, r.diffusion_idx);
+    }
+
+    /**
+     * Returns the number of distinct definitions in the table
+     */
+    unsigned size() {
+        return m_definitions.size();
+    }
+
+    /**
+     * Removes all the definitions from the table (the reactions that use them keep them alive)
+     */
+    void clear() {
+        m_definitions.clear();
+        m_indices.clear();
+    }
+};
+
 }
 
 
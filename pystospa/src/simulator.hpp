@@ -3,15 +3,20 @@
 #define SIMULATOR_HPP
 
 // stl
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <limits>
-#include <map>
+#include <memory>
 #include <random>
 #include <string>
 #include <vector>
 
 // other header files
+#include "batch_propensity.hpp"
+#include "event_queue.hpp"
+#include "molecule_store.hpp"
+#include "random.hpp"
 #include "reaction.hpp"
 #include "voxel.hpp"
 
@@ -30,49 +35,112 @@ protected:
     /** Current time in a simulation */
     double m_time;
 
-    /** Map of times until next reaction for each voxel to the corresponding indices of voxels */
-    std::map<double, unsigned> next_reaction_times;
-
-    /** Vector of times until the next reaction for each voxel ordered according to voxel indices */
-    std::vector<double> lookup_times;
+    /** Priority queue of times of the next reaction for each voxel */
+    StoSpa2::EventQueue next_reaction_times;
 
     /** Vector of Voxel class instances */
     std::vector<StoSpa2::Voxel> m_voxels;
 
+    /** Definitions of the reactions shared by all the voxels */
+    StoSpa2::ReactionTable m_reaction_table;
+
+    /** Number of molecules of all the species in all the voxels, which the voxels hold views into */
+    StoSpa2::MoleculeStore m_store;
+
+    /** Distinct growth laws of the growing voxels, which the voxels refer to by handle */
+    std::shared_ptr<StoSpa2::GrowthClock> m_growth_clock;
+
+    /** Groups of reactions whose propensities are re-evaluated for many voxels at once */
+    StoSpa2::BatchPropensities m_batch;
+
     /** Seed used for generating a random number. */
     unsigned m_seed;
 
-    /** For generating random numbers */
-    std::mt19937 m_gen;
+    /** Index of the replica, which the random numbers depend on together with the seed */
+    unsigned m_replica = 0;
+
+    /** For generating random numbers, a stream for each voxel and a last one for draws of the whole domain */
+    StoSpa2::RandomStreams m_rng;
 
     /** Uniform distribution. */
     std::uniform_real_distribution<double> m_uniform;
 
+    /**
+     * Moves the number of molecules of all the voxels into a new molecule store with the given layout and
+     * registers the growth laws of all the voxels with a new growth clock
+     * @param layout layout of the molecule store
+     */
+    void bind_voxels(StoreLayout layout) {
+        std::vector<std::size_t> num_species;
+        for (auto& vox : m_voxels) {
+            num_species.push_back(vox.get_num_species());
+        }
+        m_store = StoSpa2::MoleculeStore(num_species, layout);
+        m_growth_clock = std::make_shared<StoSpa2::GrowthClock>();
+        for (unsigned k=0; k<m_voxels.size(); k++) {
+            m_voxels[k].bind_molecules(m_store, k);
+            m_voxels[k].bind_growth(m_growth_clock);
+        }
+    }
+
+    /**
+     * Function that returns a random number from the uniform distribution on [0, 1).
+     * @param index index of the voxel whose stream is drawn from (the number of voxels for the whole domain)
+     * @return a random number from uniform distribution
+     */
+    double uniform(const unsigned& index) {
+        auto stream = m_rng.stream(index);
+        return m_uniform(stream);
+    }
+
     /**
      * Function that returns a random number from the exponential distribution.
      * @param propensity the total propensity
+     * @param index index of the voxel whose stream is drawn from (the number of voxels for the whole domain)
      * @return a random number from exponential distribution
      */
-    double exponential(const double& propensity) {
-        return (-1.0/propensity) * log(m_uniform(m_gen));
+    double exponential(const double& propensity, const unsigned& index) {
+        return (-1.0/propensity) * log(uniform(index));
     }
 
     /**
      * Initialiases all the times until next reactions in all the containers
      */
     void initialise_next_reaction_times() {
-        // Reset the priority queue if not empty
-        if (!next_reaction_times.empty()) {
-            next_reaction_times.clear();
-            lookup_times.clear();
+        // The propensities of the voxels whose size or scheduled rates have changed are re-evaluated, at once
+        // for all the voxels if most of them have changed
+        std::vector<unsigned> changed;
+        for (unsigned i=0; i<m_voxels.size(); i++) {
+            if (m_voxels[i].update_time(m_time)) { changed.push_back(i); }
+        }
+        if (2 * changed.size() > m_voxels.size()) {
+            refresh_propensities();
+        }
+        else {
+            for (const auto& i : changed) {
+                m_voxels[i].refresh_propensities();
+            }
         }
 
-        // Populate nex reaction times
+        // Populate next reaction times and rebuild the priority queue
+        std::vector<double> times(m_voxels.size());
         for (unsigned i=0; i<m_voxels.size(); i++) {
-            double new_time = exponential(m_voxels[i].get_total_propensity());
-            next_reaction_times.emplace(std::make_pair(new_time, i));
-            lookup_times.emplace_back(new_time);
+            times[i] = next_event_time(i);
         }
+        next_reaction_times.reset(std::move(times));
+    }
+
+    /**
+     * Returns a new time of the next event in the voxel with the given index, which is not past the time until
+     * which the upper bound for the total propensity of a growing voxel is valid (see Voxel::set_look_ahead) or
+     * until a scheduled rate changes (see Voxel::set_rate_schedule)
+     * @param index the index of the voxel
+     */
+    double next_event_time(const unsigned& index) {
+        auto& vox = m_voxels[index];
+        double new_time = vox.get_integrated_hazard() ? vox.integrated_event_time(-log(uniform(index)))
+                                                      : m_time + exponential(vox.get_total_propensity(), index);
+        return std::min(new_time, vox.get_bound_end());
     }
 
     /**
@@ -81,14 +149,10 @@ protected:
      */
     void update_next_reaction_time(const unsigned& index) {
         // Calculate the new time until the next reaction for this voxel
-        double new_time = m_time + exponential(m_voxels[index].get_total_propensity());
-
-        // Update next_reaction_times
-        next_reaction_times.erase(lookup_times[index]);
-        next_reaction_times.emplace(std::make_pair(new_time, index));
+        double new_time = next_event_time(index);
 
-        // Update lookup_times
-        lookup_times[index] = new_time;
+        // Update next_reaction_times in place
+        next_reaction_times.update(index, new_time);
     }
 
 public:
@@ -96,31 +160,165 @@ public:
     /**
      * Constructor for the Simulator class
      * @param voxels vector of Voxel class instances
+     * @param time initial time
+     * @param queue_type data structure used to hold the times of the next reactions (a calendar queue
+     * is faster than the default binary heap for domains with a very large number of voxels)
+     * @param layout layout of the domain-wide molecule store (species-major needs the same number of species
+     * in every voxel)
      */
-    explicit Simulator(std::vector<StoSpa2::Voxel> voxels, double time=0) {
+    explicit Simulator(std::vector<StoSpa2::Voxel> voxels, double time=0,
+                       QueueType queue_type=QueueType::binary_heap,
+                       StoreLayout layout=StoreLayout::voxel_major) : next_reaction_times(queue_type) {
         // For generating random numbers from the uniform dist
         std::random_device rd;
         m_seed = rd();
-        m_gen = std::mt19937(m_seed);
+        m_rng.seed(RngType::mt19937, m_seed, m_replica, 0);
         m_uniform = std::uniform_real_distribution<double>(0.0, 1.0);
 
         // Set the initial time and move the container with the voxels
         m_time = time;
         m_voxels = std::move(voxels);
 
+        // Equal reactions in different voxels share their definitions
+        for (auto& vox : m_voxels) {
+            vox.share_reactions(m_reaction_table);
+        }
+
+        // The voxels read and write their molecules in a single domain-wide buffer and share their growth laws
+        bind_voxels(layout);
+        m_batch = StoSpa2::BatchPropensities(m_voxels);
+
         initialise_next_reaction_times();
     }
 
+    /**
+     * Copy constructor for the Simulator class, the voxels of the copy are views into its own molecule store and
+     * use its own growth clock
+     * @param s the simulator to be copied
+     */
+    Simulator(const Simulator& s) :
+        m_time(s.m_time), next_reaction_times(s.next_reaction_times), m_voxels(s.m_voxels),
+        m_reaction_table(s.m_reaction_table), m_batch(s.m_batch), m_seed(s.m_seed), m_replica(s.m_replica), m_rng(s.m_rng),
+        m_uniform(s.m_uniform) {
+        bind_voxels(s.m_store.get_layout());
+    }
+
+    /**
+     * Copy assignment is not supported, since the voxels hold views into the molecule store
+     */
+    Simulator& operator = (const Simulator& s) = delete;
+
+    /**
+     * Destructor for the Simulator class
+     */
+    virtual ~Simulator() = default;
+
+    /**
+     * Returns a copy of the simulator of the same class as the simulator (e.g. a TauLeapSimulator)
+     */
+    virtual std::unique_ptr<Simulator> clone() const {
+        return std::make_unique<Simulator>(*this);
+    }
+
     /**
      * Sets the seed in the random number generator
      * @param seed the value of the seed
+     * @param replica index of the replica, which gives a different sequence of random numbers for the same seed
      */
-    void set_seed(unsigned seed) {
+    void set_seed(unsigned seed, unsigned replica=0) {
         m_seed = seed;
-        m_gen = std::mt19937(m_seed);
+        m_replica = replica;
+        m_rng.seed(m_rng.get_type(), m_seed, m_replica, m_voxels.size() + 1);
+        initialise_next_reaction_times();
+    }
+
+    /**
+     * Sets the type of the random number generator, which is then seeded with the current seed and replica. The
+     * Philox streams of the voxels are keyed by (seed, replica, voxel), so their random numbers do not depend on
+     * the order in which the voxels draw them, and their state is a counter for each voxel (see get_rng_counters).
+     * @param type type of the random number generator
+     */
+    void set_rng_type(RngType type) {
+        m_rng.seed(type, m_seed, m_replica, m_voxels.size() + 1);
+        initialise_next_reaction_times();
+    }
+
+    /**
+     * Restores the state of the Philox streams saved by get_rng_counters, e.g. together with the number of
+     * molecules and the times of the next reactions when resuming a checkpoint
+     * @param counters number of random values drawn from each stream
+     */
+    void set_rng_counters(std::vector<std::uint64_t> counters) {
+        m_rng.set_counters(std::move(counters));
+    }
+
+    /**
+     * Sets the method used to pick the next reaction in all the voxels
+     * @param method method used to pick the next reaction
+     */
+    void set_selection_method(SelectionMethod method) {
+        for (auto& vox : m_voxels) {
+            vox.set_selection_method(method);
+        }
+        initialise_next_reaction_times();
+    }
+
+    /**
+     * Sets the length of the look-ahead window over which the upper bound for the total propensity of the growing
+     * voxels is computed from their growth, zero uses the extrande ratio of each voxel (see Voxel::set_look_ahead)
+     * @param look_ahead length of the look-ahead window
+     */
+    void set_look_ahead(double look_ahead) {
+        for (auto& vox : m_voxels) {
+            vox.set_look_ahead(look_ahead);
+        }
+        initialise_next_reaction_times();
+    }
+
+    /**
+     * Sets whether the time of the next event in every voxel is sampled by inverting its integrated total
+     * propensity instead of by extrande (see Voxel::set_integrated_hazard)
+     * @param integrated whether to integrate the total propensities
+     */
+    void set_integrated_hazard(bool integrated) {
+        for (auto& vox : m_voxels) {
+            vox.set_integrated_hazard(integrated);
+        }
         initialise_next_reaction_times();
     }
 
+    /**
+     * Sets whether the extrande ratio of each growing voxel is tuned online to keep the fraction of rejected
+     * (extrande) events near the target (see Voxel::set_ratio_tuning)
+     * @param tune whether to tune the extrande ratios
+     * @param target_rejection fraction of rejected events to aim for
+     * @param max_ratio largest extrande ratio that the tuning may set
+     */
+    void set_ratio_tuning(bool tune, double target_rejection=0.1, double max_ratio=10.0) {
+        for (auto& vox : m_voxels) {
+            vox.set_ratio_tuning(tune, target_rejection, max_ratio);
+        }
+    }
+
+    /**
+     * Sets whether the changes in the number of molecules are checked in all the voxels, in which case a reaction
+     * that would make a number of molecules negative or larger than the largest unsigned integer throws an exception
+     * @param check whether to check the numbers of molecules
+     */
+    void set_check_counts(bool check) {
+        for (auto& vox : m_voxels) {
+            vox.set_check_counts(check);
+        }
+    }
+
+    /**
+     * Re-evaluates the propensities of all the reactions in all the voxels, evaluating mass-action reactions
+     * for many voxels at once (which is fastest with a species-major molecule store)
+     */
+    void refresh_propensities() {
+        m_batch.evaluate(m_voxels, m_store);
+    }
+
     /**
      * Returns the number used to generate the random numbers
      */
@@ -128,6 +326,98 @@ public:
         return m_seed;
     }
 
+    /**
+     * Returns the index of the replica used to generate the random numbers
+     */
+    unsigned get_replica() {
+        return m_replica;
+    }
+
+    /**
+     * Returns the type of the random number generator
+     */
+    RngType get_rng_type() {
+        return m_rng.get_type();
+    }
+
+    /**
+     * Returns the number of random values drawn from the Philox stream of each voxel (and of the whole domain),
+     * which together with the seed and the replica is the whole state of the random number generator
+     */
+    std::vector<std::uint64_t> get_rng_counters() {
+        return m_rng.get_counters();
+    }
+
+    /**
+     * Returns the data structure used to hold the times of the next reactions
+     */
+    QueueType get_queue_type() {
+        return next_reaction_times.get_type();
+    }
+
+    /**
+     * Returns the number of distinct reaction definitions shared by the voxels
+     */
+    unsigned get_num_reaction_definitions() {
+        return m_reaction_table.size();
+    }
+
+    /**
+     * Returns the number of distinct growth laws shared by the voxels
+     */
+    unsigned get_num_growth_laws() {
+        return m_growth_clock->size();
+    }
+
+    /**
+     * Returns the number of accepted events, i.e. reactions other than the extrande reaction, in each voxel
+     */
+    std::vector<unsigned long> get_num_accepted() {
+        std::vector<unsigned long> output;
+        for (auto& vox : m_voxels) {
+            output.push_back(vox.get_num_accepted());
+        }
+        return output;
+    }
+
+    /**
+     * Returns the number of events rejected by thinning, i.e. extrande reactions, in each voxel
+     */
+    std::vector<unsigned long> get_num_rejected() {
+        std::vector<unsigned long> output;
+        for (auto& vox : m_voxels) {
+            output.push_back(vox.get_num_rejected());
+        }
+        return output;
+    }
+
+    /**
+     * Returns the extrande ratio of each voxel, which changes over time if it is tuned
+     */
+    std::vector<double> get_extrande_ratios() {
+        std::vector<double> output;
+        for (auto& vox : m_voxels) {
+            output.push_back(vox.get_extrande_ratio());
+        }
+        return output;
+    }
+
+    /**
+     * Resets the numbers of accepted and rejected events in all the voxels
+     */
+    void reset_extrande_statistics() {
+        for (auto& vox : m_voxels) {
+            vox.reset_extrande_statistics();
+        }
+    }
+
+    /**
+     * Returns the growth clock that evaluates the growth laws of all the voxels
+     */
+    const StoSpa2::GrowthClock& get_growth_clock() {
+        return *m_growth_clock;
+    }
+
     /**
      * Returns the current time in the simulation
      */
@@ -146,37 +436,55 @@ public:
      * Returns the number of molecules contained in each voxel as a single vector
      */
     std::vector<unsigned> get_molecules() {
-        std::vector<unsigned> output;
-        for (auto& vox : m_voxels) {
-            auto mols = vox.get_molecules();
-            output.insert(output.end(), mols.begin(), mols.end());
-        }
-        return output;
+        return m_store.to_vector();
+    }
+
+    /**
+     * Returns the buffer of the molecule store with the number of molecules of all the species in all the voxels,
+     * in the layout of the store and without making a copy
+     */
+    const std::vector<unsigned>& get_molecule_store() {
+        return m_store.data();
+    }
+
+    /**
+     * Returns the layout of the molecule store
+     */
+    StoreLayout get_store_layout() {
+        return m_store.get_layout();
     }
 
     /**
      * Function to make a single step in the SSA
      */
-    void step() {
+    virtual void step() {
 
         // Pick the smallest time from next_reaction_times
-        m_time = (*next_reaction_times.begin()).first;
-        auto voxel_idx = (*next_reaction_times.begin()).second;
+        m_time = next_reaction_times.top_time();
+        auto voxel_idx = next_reaction_times.top_index();
 
         m_voxels[voxel_idx].update_properties(m_time);
 
         if (m_time < inf) {
+            // At the end of the look-ahead window or at a change of a scheduled rate only a new time is needed
+            if (m_time >= m_voxels[voxel_idx].get_bound_end()) {
+                update_next_reaction_time(voxel_idx);
+                return;
+            }
+
             // Pick a reaction with the corresponding voxel
-            auto& r = m_voxels[voxel_idx].pick_reaction(m_uniform(m_gen));
+            auto draw = [this, voxel_idx]() { return uniform(voxel_idx); };
+            auto& r = m_voxels[voxel_idx].pick_reaction(uniform(voxel_idx), draw);
 
             // Update the time until the next reaction for this voxel
-            m_voxels[voxel_idx].add_vector(r.stoichiometry);
+            m_voxels[voxel_idx].add_changes(r.changes);
             update_next_reaction_time(voxel_idx);
 
             //TODO: what if r.diffusion_idx is larger than number of voxels
             if (r.diffusion_idx >= 0) {
-                // Update the number of molecules
-                m_voxels[r.diffusion_idx].subtract_vector(r.stoichiometry);
+                // Update the number of molecules, a growing neighbour is first brought up to the current time
+                m_voxels[r.diffusion_idx].update_properties(m_time);
+                m_voxels[r.diffusion_idx].subtract_changes(r.changes);
                 update_next_reaction_time(r.diffusion_idx);
             }
         }
@@ -186,7 +494,7 @@ public:
      * Function to make multiple steps to reach the given point in time
      * @param time_point the point in time in simulation that is reached
      */
-    void advance(double time_point) {
+    virtual void advance(double time_point) {
         while (m_time < time_point) {
             step();
         }
@@ -219,9 +527,13 @@ public:
      */
     void save(std::ofstream& handle) {
         handle << m_time;
-        for (auto& vox : m_voxels) {
-            auto mols = vox.get_molecules();
-            for (auto& mol : mols) {
+        if (m_store.get_layout() == StoreLayout::voxel_major) {
+            for (const auto& mol : m_store.data()) {
+                handle << " " << mol;
+            }
+        }
+        else {
+            for (const auto& mol : m_store.to_vector()) {
                 handle << " " << mol;
             }
         }
@@ -0,0 +1,123 @@
+
+#ifndef SUM_TREE_HPP
+#define SUM_TREE_HPP
+
+// stl
+#include <vector>
+
+namespace StoSpa2 {
+
+/**
+ * SumTree class - complete binary tree in which the leaves hold the propensities of the reactions
+ * and every other node holds the sum of its two children. A single propensity is updated and a reaction
+ * is picked in O(log R), where R is the number of reactions. Sums are always recomputed from the children,
+ * so no rounding errors accumulate over many updates.
+ */
+class SumTree {
+protected:
+    /** Number of leaves (power of two that is not smaller than the number of values) */
+    unsigned m_num_leaves = 1;
+
+    /** Number of values stored in the tree */
+    unsigned m_size = 0;
+
+    /** Nodes of the tree, the root is at index 1 and leaves start at index m_num_leaves */
+    std::vector<double> m_nodes = std::vector<double>(2, 0.0);
+
+public:
+
+    /**
+     * Default constructor for the SumTree class, creates an empty tree
+     */
+    SumTree() = default;
+
+    /**
+     * Constructor for the SumTree class
+     * @param values values to be stored in the leaves of the tree
+     */
+    explicit SumTree(const std::vector<double>& values) {
+        reset(values);
+    }
+
+    /**
+     * Replaces all the values stored in the tree and recomputes all the sums in O(R)
+     * @param values values to be stored in the leaves of the tree
+     */
+    void reset(const std::vector<double>& values) {
+        m_size = values.size();
+        m_num_leaves = 1;
+        while (m_num_leaves < m_size) {
+            m_num_leaves *= 2;
+        }
+
+        m_nodes.assign(2 * m_num_leaves, 0.0);
+        for (unsigned i=0; i<m_size; i++) {
+            m_nodes[m_num_leaves + i] = values[i];
+        }
+        for (unsigned node=m_num_leaves-1; node>0; node--) {
+            m_nodes[node] = m_nodes[2 * node] + m_nodes[2 * node + 1];
+        }
+    }
+
+    /**
+     * Changes the value with the given index and the sums above it
+     * @param index index of the value
+     * @param value new value
+     */
+    void update(const unsigned& index, const double& value) {
+        unsigned node = m_num_leaves + index;
+        m_nodes[node] = value;
+        for (node /= 2; node > 0; node /= 2) {
+            m_nodes[node] = m_nodes[2 * node] + m_nodes[2 * node + 1];
+        }
+    }
+
+    /**
+     * Returns the sum of all the values
+     */
+    double total() const {
+        return m_nodes[1];
+    }
+
+    /**
+     * Returns the value with the given index
+     * @param index index of the value
+     */
+    double get_value(const unsigned& index) const {
+        return m_nodes[m_num_leaves + index];
+    }
+
+    /**
+     * Finds the index i such that the sum of values before i is not greater than the given number and the
+     * sum of values up to and including i is greater than it. Values equal to zero are never picked.
+     * @param random_num number in the interval [0, total())
+     * @return the index of the value
+     */
+    unsigned search(double random_num) const {
+        unsigned node = 1;
+        while (node < m_num_leaves) {
+            unsigned left = 2 * node;
+            // Go right only if the number lies beyond the left subtree and the right subtree is not empty,
+            // this guards against rounding errors picking values equal to zero
+            if (random_num < m_nodes[left] or m_nodes[left + 1] <= 0) {
+                node = left;
+            }
+            else {
+                random_num -= m_nodes[left];
+                node = left + 1;
+            }
+        }
+        return node - m_num_leaves;
+    }
+
+    /**
+     * Returns the number of values stored in the tree
+     */
+    unsigned size() const {
+        return m_size;
+    }
+};
+
+}
+
+#endif // SUM_TREE_HPP
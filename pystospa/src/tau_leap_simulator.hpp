@@ -0,0 +1,343 @@
+
+// The step size selection follows Cao Y, Gillespie DT, Petzold LR (2006) Efficient step size selection for the
+// tau-leaping simulation method. J Chem Phys 124(4): 044109. https://doi.org/10.1063/1.2159468
+// and the binomial firing counts follow Tian T, Burrage K (2004) Binomial leap methods for simulating stochastic
+// chemical kinetics. J Chem Phys 121(21): 10356. https://doi.org/10.1063/1.1810475
+
+#ifndef TAU_LEAP_SIMULATOR_HPP
+#define TAU_LEAP_SIMULATOR_HPP
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+// other header files
+#include "reaction.hpp"
+#include "simulator.hpp"
+#include "voxel.hpp"
+
+namespace StoSpa2 {
+
+/**
+ * TauLeapSimulator class - used to step in time using the explicit tau-leaping method, where many reactions
+ * fire in one step of size tau. The step size is chosen adaptively, such that the propensities do not change
+ * by more than a fraction epsilon of their values. Reactions that are close to exhausting one of their reactants
+ * (critical reactions) fire at most once per step, and if the step would be too short to be worthwhile, then
+ * a number of exact steps of the next subvolume method are taken instead.
+ */
+class TauLeapSimulator : public Simulator {
+protected:
+    /** Bound on the relative change of propensities in a single step */
+    double m_epsilon;
+
+    /** Reactions that can fire fewer than this number of times before exhausting a reactant are critical */
+    unsigned m_num_critical;
+
+    /** Highest order of reactions, assumed to be the same for all species (g_i in Cao et al.) */
+    double m_highest_order = 2.0;
+
+    /** Exact steps are taken if tau is smaller than this number divided by the total propensity */
+    double m_ssa_threshold = 10.0;
+
+    /** Number of exact steps taken whenever tau is too small */
+    unsigned m_num_ssa_steps = 100;
+
+    /** Reactions of each voxel (they do not change during a simulation, so they are copied once) */
+    std::vector<std::vector<StoSpa2::Reaction>> m_reactions;
+
+    /** Offset of each voxel in the domain-wide vectors of species */
+    std::vector<unsigned> m_offsets;
+
+    /** Number of molecules of each species in each voxel */
+    std::vector<long> m_state;
+
+    /** Change in the number of molecules of each species in each voxel in the current step */
+    std::vector<long> m_delta;
+
+    /** Expected change in the number of molecules per unit time due to non-critical reactions */
+    std::vector<double> m_mu;
+
+    /** Variance of the change in the number of molecules per unit time due to non-critical reactions */
+    std::vector<double> m_sigma2;
+
+    /** Whether a species in a voxel is a reactant of a non-critical reaction */
+    std::vector<bool> m_is_reactant;
+
+    /**
+     * Returns how many times a reaction can fire before one of its reactants is exhausted
+     * @param voxel_idx index of the voxel that contains the reaction
+     * @param r the reaction
+     * @return number of times the reaction can fire (infinity if it has no reactants)
+     */
+    double firing_limit(const unsigned& voxel_idx, const StoSpa2::Reaction& r) {
+        double limit = inf;
+        for (const auto& change : r.changes) {
+            unsigned i = change.species;
+            int v = change.delta;
+            if (v < 0) {
+                limit = std::min(limit, std::floor(m_state[m_offsets[voxel_idx] + i] / (double) -v));
+            }
+            // The target voxel of a diffusion reaction changes by the negative of the stoichiometry vector
+            if (r.diffusion_idx >= 0 and v > 0) {
+                limit = std::min(limit, std::floor(m_state[m_offsets[r.diffusion_idx] + i] / (double) v));
+            }
+        }
+        return limit;
+    }
+
+    /**
+     * Adds the change due to a reaction firing the given number of times to m_delta
+     * @param voxel_idx index of the voxel that contains the reaction
+     * @param r the reaction
+     * @param num_firings number of times the reaction fires
+     */
+    void add_firings(const unsigned& voxel_idx, const StoSpa2::Reaction& r, const long& num_firings) {
+        for (const auto& change : r.changes) {
+            m_delta[m_offsets[voxel_idx] + change.species] += num_firings * change.delta;
+            if (r.diffusion_idx >= 0) {
+                m_delta[m_offsets[r.diffusion_idx] + change.species] -= num_firings * change.delta;
+            }
+        }
+    }
+
+    /**
+     * Adds the expected change and its variance due to a non-critical reaction to m_mu and m_sigma2
+     * @param voxel_idx index of the voxel that contains the reaction
+     * @param r the reaction
+     * @param propensity propensity of the reaction
+     */
+    void add_moments(const unsigned& voxel_idx, const StoSpa2::Reaction& r, const double& propensity) {
+        for (const auto& change : r.changes) {
+            double v = change.delta;
+            unsigned idx = m_offsets[voxel_idx] + change.species;
+            m_mu[idx] += v * propensity;
+            m_sigma2[idx] += v * v * propensity;
+            if (v < 0) { m_is_reactant[idx] = true; }
+            if (r.diffusion_idx >= 0) {
+                idx = m_offsets[r.diffusion_idx] + change.species;
+                m_mu[idx] -= v * propensity;
+                m_sigma2[idx] += v * v * propensity;
+                if (v > 0) { m_is_reactant[idx] = true; }
+            }
+        }
+    }
+
+    /**
+     * Takes a number of exact steps of the next subvolume method without going past the given time point
+     * @param time_point the point in time which is not to be passed
+     */
+    void exact_steps(const double& time_point) {
+        // The state has changed in many voxels since the last exact step, hence all times are redrawn
+        initialise_next_reaction_times();
+        for (unsigned n=0; n<m_num_ssa_steps; n++) {
+            if (next_reaction_times.top_time() > time_point) {
+                m_time = time_point;
+                return;
+            }
+            Simulator::step();
+        }
+    }
+
+    /**
+     * Takes a single step of the tau-leaping method without going past the given time point
+     * @param time_point the point in time which is not to be passed
+     */
+    void leap(const double& time_point) {
+        // Gather the state of the whole domain and update growing voxels
+        for (unsigned k=0; k<m_voxels.size(); k++) {
+            m_voxels[k].update_properties(m_time);
+            for (unsigned i=0; i<m_offsets[k+1]-m_offsets[k]; i++) {
+                m_state[m_offsets[k] + i] = m_voxels[k].get_molecules(i);
+            }
+        }
+        std::fill(m_mu.begin(), m_mu.end(), 0.0);
+        std::fill(m_sigma2.begin(), m_sigma2.end(), 0.0);
+        std::fill(m_is_reactant.begin(), m_is_reactant.end(), false);
+
+        // Split the reactions into critical and non-critical ones
+        double a_0 = 0;
+        double a_0_critical = 0;
+        for (unsigned k=0; k<m_voxels.size(); k++) {
+            for (unsigned j=0; j<m_reactions[k].size(); j++) {
+                double propensity = m_voxels[k].get_propensity(j);
+                if (propensity <= 0) { continue; }
+                a_0 += propensity;
+                if (firing_limit(k, m_reactions[k][j]) < m_num_critical) {
+                    a_0_critical += propensity;
+                }
+                else {
+                    add_moments(k, m_reactions[k][j], propensity);
+                }
+            }
+        }
+
+        if (a_0 <= 0) {
+            m_time = time_point;
+            return;
+        }
+
+        // Largest step for which the propensities of non-critical reactions do not change by much
+        double tau_non_critical = inf;
+        for (unsigned idx=0; idx<m_state.size(); idx++) {
+            if (!m_is_reactant[idx]) { continue; }
+            double bound = std::max(m_epsilon * m_state[idx] / m_highest_order, 1.0);
+            if (m_mu[idx] != 0) {
+                tau_non_critical = std::min(tau_non_critical, bound / std::abs(m_mu[idx]));
+            }
+            if (m_sigma2[idx] > 0) {
+                tau_non_critical = std::min(tau_non_critical, bound * bound / m_sigma2[idx]);
+            }
+        }
+
+        // If the step is too short, exact steps are more efficient, and if nothing bounds it (e.g. only production)
+        // exact steps are taken instead of an infinite leap
+        bool unbounded = tau_non_critical == inf and a_0_critical <= 0 and time_point == inf;
+        if (tau_non_critical < m_ssa_threshold / a_0 or unbounded) {
+            exact_steps(time_point);
+            return;
+        }
+
+        double tau_critical = (a_0_critical > 0) ? exponential(a_0_critical, m_voxels.size()) : inf;
+        while (true) {
+            double tau = std::min(tau_non_critical, tau_critical);
+            bool critical_fires = tau_critical <= tau_non_critical;
+            bool reaches_time_point = m_time + tau >= time_point;
+            if (reaches_time_point) {
+                tau = time_point - m_time;
+                critical_fires = false;
+            }
+
+            std::fill(m_delta.begin(), m_delta.end(), 0);
+
+            // One critical reaction fires (if any), picked with probability proportional to its propensity
+            double r_a_0 = critical_fires ? uniform(m_voxels.size()) * a_0_critical : -1.0;
+
+            for (unsigned k=0; k<m_voxels.size(); k++) {
+                for (unsigned j=0; j<m_reactions[k].size(); j++) {
+                    double propensity = m_voxels[k].get_propensity(j);
+                    if (propensity <= 0) { continue; }
+                    const auto& r = m_reactions[k][j];
+                    double limit = firing_limit(k, r);
+
+                    if (limit < m_num_critical) {
+                        if (r_a_0 >= 0 and r_a_0 < propensity) {
+                            add_firings(k, r, 1);
+                        }
+                        r_a_0 -= propensity;
+                    }
+                    else if (limit < inf) {
+                        // Binomial firing counts can not exceed the number of available reactants
+                        double p = std::min(1.0, propensity * tau / limit);
+                        std::binomial_distribution<long> binomial((long) limit, p);
+                        auto stream = m_rng.stream(k);
+                        add_firings(k, r, binomial(stream));
+                    }
+                    else {
+                        std::poisson_distribution<long> poisson(propensity * tau);
+                        auto stream = m_rng.stream(k);
+                        add_firings(k, r, poisson(stream));
+                    }
+                }
+            }
+
+            // Reject the step if any number of molecules would become negative and try a shorter one
+            bool negative = false;
+            for (unsigned idx=0; idx<m_state.size(); idx++) {
+                if (m_state[idx] + m_delta[idx] < 0) {
+                    negative = true;
+                    break;
+                }
+            }
+            if (negative) {
+                tau_non_critical /= 2;
+                continue;
+            }
+
+            // Apply the changes in the molecule store and re-evaluate all the propensities at once
+            for (unsigned k=0; k<m_voxels.size(); k++) {
+                for (unsigned i=0; i<m_offsets[k+1]-m_offsets[k]; i++) {
+                    m_store.at(k, i) = (unsigned) (m_state[m_offsets[k] + i] + m_delta[m_offsets[k] + i]);
+                }
+            }
+            refresh_propensities();
+            m_time = reaches_time_point ? time_point : m_time + tau;
+            return;
+        }
+    }
+
+public:
+
+    /**
+     * Constructor for the TauLeapSimulator class
+     * @param voxels vector of Voxel class instances
+     * @param time initial time
+     * @param epsilon bound on the relative change of propensities in a single step
+     * @param num_critical reactions that can fire fewer than this number of times are critical
+     */
+    explicit TauLeapSimulator(std::vector<StoSpa2::Voxel> voxels, double time=0, double epsilon=0.03,
+                              unsigned num_critical=10) : Simulator(std::move(voxels), time) {
+        if (epsilon <= 0 or epsilon >= 1) {
+            throw std::runtime_error("TauLeapSimulator::TauLeapSimulator: epsilon needs to be between 0 and 1");
+        }
+        m_epsilon = epsilon;
+        m_num_critical = num_critical;
+
+        // Copy the reactions and lay out the species of all the voxels one after another
+        m_offsets.push_back(0);
+        for (auto& vox : m_voxels) {
+            m_reactions.push_back(vox.get_reactions());
+            m_offsets.push_back(m_offsets.back() + vox.get_molecules().size());
+        }
+        for (unsigned k=0; k<m_voxels.size(); k++) {
+            for (const auto& r : m_reactions[k]) {
+                if (r.diffusion_idx >= (int) m_voxels.size()) {
+                    throw std::runtime_error("TauLeapSimulator::TauLeapSimulator: diffusion_idx out of range");
+                }
+            }
+        }
+        m_state.resize(m_offsets.back());
+        m_delta.resize(m_offsets.back());
+        m_mu.resize(m_offsets.back());
+        m_sigma2.resize(m_offsets.back());
+        m_is_reactant.resize(m_offsets.back());
+    }
+
+    /**
+     * Returns a copy of the simulator
+     */
+    std::unique_ptr<Simulator> clone() const override {
+        return std::make_unique<TauLeapSimulator>(*this);
+    }
+
+    /**
+     * Returns the bound on the relative change of propensities in a single step
+     */
+    double get_epsilon() {
+        return m_epsilon;
+    }
+
+    /**
+     * Function to make a single step of the tau-leaping method
+     */
+    void step() override {
+        leap(inf);
+    }
+
+    /**
+     * Function to make multiple steps to reach the given point in time (without going past it)
+     * @param time_point the point in time in simulation that is reached
+     */
+    void advance(double time_point) override {
+        while (m_time < time_point) {
+            leap(time_point);
+        }
+    }
+};
+
+}
+
+#endif // TAU_LEAP_SIMULATOR_HPP
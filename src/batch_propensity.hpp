@@ -0,0 +1,301 @@
+#ifndef BATCH_PROPENSITY_HPP
+#define BATCH_PROPENSITY_HPP
+
+// stl
+#include <array>
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+// simd
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+// other header files
+#include "molecule_store.hpp"
+#include "reaction.hpp"
+#include "voxel.hpp"
+
+namespace StoSpa2 {
+
+/**
+ * Evaluates the propensity (without the rate) of a mass-action reaction of the given order in many voxels at once,
+ * using AVX-512 or AVX2 instructions when the compiler targets them (e.g. -march=native) and a scalar loop
+ * otherwise. The operations are the same as in Reaction, so the results are identical to evaluating each voxel
+ * on its own. Numbers of molecules that are not contiguous are read by the scalar loop.
+ * @param x number of molecules of each reactant (unused entries may be nullptr), one value per voxel
+ * @param repeats number of preceding reactants of the same species (see ReactionDefinition)
+ * @param voxel_sizes size of each voxel
+ * @param n number of voxels
+ * @param output propensity in each voxel
+ * @param stride distance between the numbers of molecules of consecutive voxels in x
+ */
+template<unsigned Order>
+void mass_action_batch(const std::array<const unsigned*, 3>& x, const std::array<double, 3>& repeats,
+                       const double* voxel_sizes, const std::size_t& n, double* output, const std::size_t& stride=1) {
+    std::size_t t = 0;
+#if defined(__AVX512F__)
+    const std::size_t n_vector = stride == 1 ? n : 0;
+    const __m512d r1 = _mm512_set1_pd(repeats[1]);
+    const __m512d r2 = _mm512_set1_pd(repeats[2]);
+    for (; t + 8 <= n_vector; t += 8) {
+        __m512d size = _mm512_loadu_pd(voxel_sizes + t);
+        __m512d p = size;
+        if (Order >= 1) {
+            p = _mm512_cvtepu32_pd(_mm256_loadu_si256((const __m256i*) (x[0] + t)));
+        }
+        if (Order >= 2) {
+            __m512d x1 = _mm512_cvtepu32_pd(_mm256_loadu_si256((const __m256i*) (x[1] + t)));
+            p = _mm512_mul_pd(p, _mm512_sub_pd(x1, r1));
+        }
+        if (Order == 2) {
+            p = _mm512_div_pd(p, size);
+        }
+        if (Order == 3) {
+            __m512d x2 = _mm512_cvtepu32_pd(_mm256_loadu_si256((const __m256i*) (x[2] + t)));
+            p = _mm512_div_pd(_mm512_mul_pd(p, _mm512_sub_pd(x2, r2)), _mm512_mul_pd(size, size));
+        }
+        _mm512_storeu_pd(output + t, p);
+    }
+#elif defined(__AVX2__)
+    const std::size_t n_vector = stride == 1 ? n : 0;
+    // Unsigned counts are converted by flipping the sign bit, converting as signed and adding 2^31 back
+    const __m128i sign = _mm_set1_epi32((int) 0x80000000u);
+    const __m256d offset = _mm256_set1_pd(2147483648.0);
+    auto load = [&sign, &offset](const unsigned* counts) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*) counts), sign);
+        return _mm256_add_pd(_mm256_cvtepi32_pd(v), offset);
+    };
+    const __m256d r1 = _mm256_set1_pd(repeats[1]);
+    const __m256d r2 = _mm256_set1_pd(repeats[2]);
+    for (; t + 4 <= n_vector; t += 4) {
+        __m256d size = _mm256_loadu_pd(voxel_sizes + t);
+        __m256d p = size;
+        if (Order >= 1) {
+            p = load(x[0] + t);
+        }
+        if (Order >= 2) {
+            p = _mm256_mul_pd(p, _mm256_sub_pd(load(x[1] + t), r1));
+        }
+        if (Order == 2) {
+            p = _mm256_div_pd(p, size);
+        }
+        if (Order == 3) {
+            p = _mm256_div_pd(_mm256_mul_pd(p, _mm256_sub_pd(load(x[2] + t), r2)), _mm256_mul_pd(size, size));
+        }
+        _mm256_storeu_pd(output + t, p);
+    }
+#endif
+    for (; t < n; t++) {
+        double size = voxel_sizes[t];
+        switch (Order) {
+            case 0:
+                output[t] = size;
+                break;
+            case 1:
+                output[t] = x[0][t * stride];
+                break;
+            case 2:
+                output[t] = x[0][t * stride] * (x[1][t * stride] - repeats[1]) / size;
+                break;
+            default:
+                output[t] = x[0][t * stride] * (x[1][t * stride] - repeats[1]) * (x[2][t * stride] - repeats[2])
+                            / (size * size);
+        }
+    }
+}
+
+/**
+ * BatchPropensities class - re-evaluates the propensities of all the reactions in all the voxels of a domain.
+ * Mass-action reactions that share a definition (see ReactionTable) are grouped, so that each group is evaluated
+ * for many voxels at once by mass_action_batch. The numbers of molecules of a group of consecutive voxels are
+ * read in place from the MoleculeStore (contiguously with a species-major store and strided with a voxel-major
+ * one whose voxels have the same number of species), otherwise they are gathered first. Other reactions are
+ * evaluated one at a time. Growth does not change the mass-action propensities, which are cached at the initial
+ * size of each voxel.
+ */
+class BatchPropensities {
+protected:
+    /** Mass-action reactions with the same definition in increasing order of voxels */
+    struct Group {
+        /** Kind of the reactions */
+        ReactionKind kind;
+
+        /** Indices of the species of the reactants */
+        std::array<unsigned, 3> species;
+
+        /** Number of preceding reactants of the same species */
+        std::array<double, 3> repeats;
+
+        /** Index of the voxel of each reaction */
+        std::vector<unsigned> voxels;
+
+        /** Whether the voxels are consecutive and have the same number of species, i.e. are read in place */
+        bool in_place;
+    };
+
+    /** Groups of mass-action reactions */
+    std::vector<Group> m_groups;
+
+    /** Indices of the reactions of each voxel that are not in any group */
+    std::vector<std::vector<unsigned>> m_others;
+
+    /** Index of the first reaction of each voxel in m_slot_reactions (and the total number of such reactions) */
+    std::vector<std::size_t> m_slot_offsets;
+
+    /** Index within its voxel of each reaction in a group, in increasing order of voxels */
+    std::vector<unsigned> m_slot_reactions;
+
+    /** Index in m_values of the propensity of each reaction in m_slot_reactions */
+    std::vector<std::size_t> m_slot_values;
+
+    /** Initial size of each voxel, at which mass-action propensities are cached (see Voxel::ScalingClass) */
+    std::vector<double> m_sizes;
+
+    /** Numbers of molecules of the reactants gathered for a group */
+    std::array<std::vector<unsigned>, 3> m_counts;
+
+    /** Sizes of the voxels gathered for a group */
+    std::vector<double> m_group_sizes;
+
+    /** Index in m_values of the first propensity of each group */
+    std::vector<std::size_t> m_group_offsets;
+
+    /** Propensities (without the rates) of all the groups, one group after another */
+    std::vector<double> m_values;
+
+public:
+
+    /**
+     * Default constructor for the BatchPropensities class, there are no reactions to evaluate
+     */
+    BatchPropensities() = default;
+
+    /**
+     * Constructor for the BatchPropensities class
+     * @param voxels vector of Voxel class instances, whose reactions do not change afterwards
+     */
+    explicit BatchPropensities(std::vector<StoSpa2::Voxel>& voxels) {
+        // Reactions are grouped by their definition and by how many times the definition occurs before them in
+        // the same voxel (e.g. diffusion to the left and to the right), so that groups cover consecutive voxels
+        std::map<std::pair<const ReactionDefinition*, unsigned>, unsigned> indices;
+        std::vector<unsigned> slot_groups;
+        m_others.resize(voxels.size());
+        for (unsigned k=0; k<voxels.size(); k++) {
+            m_slot_offsets.push_back(m_slot_reactions.size());
+            auto& reactions = voxels[k].m_reactions;
+            std::map<const ReactionDefinition*, unsigned> occurrences;
+            for (unsigned j=0; j<reactions.size(); j++) {
+                const auto& d = reactions[j].get_definition();
+                if (d.kind == ReactionKind::custom or d.kind == ReactionKind::expression) {
+                    m_others[k].push_back(j);
+                    continue;
+                }
+                auto key = std::make_pair(&d, occurrences[&d]++);
+                auto it = indices.find(key);
+                if (it == indices.end()) {
+                    it = indices.emplace(key, m_groups.size()).first;
+                    m_groups.push_back({d.kind, d.species, d.repeats, {}, false});
+                }
+                m_slot_reactions.push_back(j);
+                m_slot_values.push_back(m_groups[it->second].voxels.size());
+                slot_groups.push_back(it->second);
+                m_groups[it->second].voxels.push_back(k);
+            }
+        }
+        m_slot_offsets.push_back(m_slot_reactions.size());
+        for (auto& group : m_groups) {
+            unsigned first = group.voxels.front();
+            group.in_place = group.voxels.back() - first + 1 == group.voxels.size();
+            for (unsigned k=first; k<=group.voxels.back() and group.in_place; k++) {
+                group.in_place = voxels[k].get_num_species() == voxels[first].get_num_species();
+            }
+        }
+
+        // The values of each group are stored one group after another
+        m_group_offsets.push_back(0);
+        for (const auto& group : m_groups) {
+            m_group_offsets.push_back(m_group_offsets.back() + group.voxels.size());
+        }
+        for (std::size_t s=0; s<m_slot_values.size(); s++) {
+            m_slot_values[s] += m_group_offsets[slot_groups[s]];
+        }
+        m_values.resize(m_group_offsets.back());
+        for (const auto& vox : voxels) {
+            m_sizes.push_back(vox.m_initial_voxel_size);
+        }
+    }
+
+    /**
+     * Re-evaluates the propensities of all the reactions in all the voxels and their sums
+     * @param voxels vector of Voxel class instances used to construct the instance
+     * @param store the molecule store that the voxels hold views into
+     */
+    void evaluate(std::vector<StoSpa2::Voxel>& voxels, const StoSpa2::MoleculeStore& store) {
+        for (unsigned g=0; g<m_groups.size(); g++) {
+            const auto& group = m_groups[g];
+            std::size_t n = group.voxels.size();
+            unsigned order = group.kind == ReactionKind::zeroth_order ? 0 : group.kind == ReactionKind::first_order
+                             ? 1 : group.kind == ReactionKind::second_order ? 2 : 3;
+
+            // Consecutive voxels are read in place, one after another in a species-major store and a fixed number
+            // of species apart in a voxel-major one, otherwise the counts are gathered
+            std::array<const unsigned*, 3> x = {{nullptr, nullptr, nullptr}};
+            const double* sizes = m_sizes.data() + group.voxels.front();
+            std::size_t stride = 1;
+            if (group.in_place) {
+                const auto& first = voxels[group.voxels.front()].m_molecules;
+                stride = store.get_layout() == StoreLayout::species_major ? 1 : first.size();
+                for (unsigned p=0; p<order; p++) {
+                    x[p] = first.data() + group.species[p] * first.stride();
+                }
+            }
+            else {
+                for (unsigned p=0; p<order; p++) {
+                    m_counts[p].resize(n);
+                    for (std::size_t t=0; t<n; t++) {
+                        m_counts[p][t] = voxels[group.voxels[t]].m_molecules[group.species[p]];
+                    }
+                    x[p] = m_counts[p].data();
+                }
+                if (group.voxels.back() - group.voxels.front() + 1 != n) {
+                    m_group_sizes.resize(n);
+                    for (std::size_t t=0; t<n; t++) {
+                        m_group_sizes[t] = m_sizes[group.voxels[t]];
+                    }
+                    sizes = m_group_sizes.data();
+                }
+            }
+
+            double* values = m_values.data() + m_group_offsets[g];
+            switch (order) {
+                case 0: mass_action_batch<0>(x, group.repeats, sizes, n, values, stride); break;
+                case 1: mass_action_batch<1>(x, group.repeats, sizes, n, values, stride); break;
+                case 2: mass_action_batch<2>(x, group.repeats, sizes, n, values, stride); break;
+                default: mass_action_batch<3>(x, group.repeats, sizes, n, values, stride);
+            }
+        }
+
+        // The propensities are written back in a single pass over the voxels
+        for (unsigned k=0; k<voxels.size(); k++) {
+            auto& vox = voxels[k];
+            for (std::size_t s=m_slot_offsets[k]; s<m_slot_offsets[k+1]; s++) {
+                unsigned j = m_slot_reactions[s];
+                auto& r = vox.m_reactions[j];
+                vox.m_propensities[j] = r.get_rate() * m_values[m_slot_values[s]];
+            }
+            for (const auto& j : m_others[k]) {
+                vox.m_propensities[j] = vox.evaluate_propensity(j);
+            }
+            vox.m_stale.clear();
+            vox.reset_selection();
+            vox.sum_propensities();
+        }
+    }
+};
+
+}
+
+#endif // BATCH_PROPENSITY_HPP
@@ -0,0 +1,234 @@
+
+// The composition-rejection method follows Slepoy A, Thompson AP, Plimpton SJ (2008) A constant-time kinetic
+// Monte Carlo algorithm for simulation of large biochemical reaction networks. J Chem Phys 128(20): 205101.
+// https://doi.org/10.1063/1.2919546
+
+#ifndef COMPOSITION_REJECTION_HPP
+#define COMPOSITION_REJECTION_HPP
+
+// stl
+#include <cmath>
+#include <vector>
+
+namespace StoSpa2 {
+
+/**
+ * CompositionRejection class - groups the propensities of the reactions into bins, such that a bin with
+ * exponent e contains the propensities in the interval [2^(e-1), 2^e). A bin is picked with probability
+ * proportional to the sum of its propensities (composition) and a reaction within the bin is picked by
+ * rejection sampling against the upper bound 2^e, which accepts with probability of at least a half.
+ * Hence the expected cost of picking a reaction does not depend on the number of reactions. Moving a
+ * propensity between bins takes O(1).
+ */
+class CompositionRejection {
+protected:
+    /** Bin of the propensities with the same binary exponent */
+    struct Bin {
+        /** Indices of the reactions in this bin */
+        std::vector<unsigned> reactions;
+
+        /** Sum of the propensities in this bin */
+        double sum = 0;
+
+        /** Number of times the sum has been changed incrementally since it was last recomputed */
+        unsigned num_updates = 0;
+    };
+
+    /** Propensities of the reactions */
+    std::vector<double> m_values;
+
+    /** Bin of each reaction (relative to m_min_exponent), negative if the propensity is zero */
+    std::vector<int> m_bin_of;
+
+    /** Position of each reaction within its bin */
+    std::vector<unsigned> m_position;
+
+    /** Bins ordered by increasing exponent */
+    std::vector<Bin> m_bins;
+
+    /** Exponent of the first bin in m_bins */
+    int m_min_exponent = 0;
+
+    /**
+     * Returns the exponent of the bin to which the given propensity belongs
+     * @param value propensity (greater than zero)
+     */
+    static int exponent(const double& value) {
+        int e;
+        std::frexp(value, &e);
+        return e;
+    }
+
+    /**
+     * Returns the index of the bin for the given exponent, adding bins if it is out of the current range
+     * @param e exponent of the bin
+     */
+    int bin_index(const int& e) {
+        if (m_bins.empty()) {
+            m_min_exponent = e;
+            m_bins.resize(1);
+        }
+        else if (e < m_min_exponent) {
+            // Prepend bins and shift the bins of all the reactions accordingly
+            int shift = m_min_exponent - e;
+            m_bins.insert(m_bins.begin(), shift, Bin());
+            for (auto& bin : m_bin_of) {
+                if (bin >= 0) { bin += shift; }
+            }
+            m_min_exponent = e;
+        }
+        else if (e - m_min_exponent >= (int) m_bins.size()) {
+            m_bins.resize(e - m_min_exponent + 1);
+        }
+        return e - m_min_exponent;
+    }
+
+    /**
+     * Counts an incremental change of the sum of a bin and recomputes the sum from the propensities in the bin
+     * once the number of changes exceeds the number of reactions in it, so that rounding errors do not
+     * accumulate over a run at an amortised constant cost
+     * @param b index of the bin
+     */
+    void count_update(const int& b) {
+        Bin& bin = m_bins[b];
+        if (++bin.num_updates <= bin.reactions.size() + 16) { return; }
+        bin.sum = 0;
+        for (const auto& index : bin.reactions) {
+            bin.sum += m_values[index];
+        }
+        bin.num_updates = 0;
+    }
+
+    /**
+     * Removes the reaction with the given index from its bin
+     * @param index index of the reaction
+     */
+    void remove(const unsigned& index) {
+        Bin& bin = m_bins[m_bin_of[index]];
+        unsigned last = bin.reactions.back();
+        bin.reactions[m_position[index]] = last;
+        m_position[last] = m_position[index];
+        bin.reactions.pop_back();
+
+        // Empty bins have exactly zero sum, so that rounding errors do not accumulate there
+        bin.sum = bin.reactions.empty() ? 0.0 : bin.sum - m_values[index];
+        count_update(m_bin_of[index]);
+        m_bin_of[index] = -1;
+    }
+
+    /**
+     * Inserts the reaction with the given index into the bin corresponding to its propensity
+     * @param index index of the reaction
+     */
+    void insert(const unsigned& index) {
+        if (m_values[index] <= 0) { return; }
+        int b = bin_index(exponent(m_values[index]));
+        m_bin_of[index] = b;
+        m_position[index] = m_bins[b].reactions.size();
+        m_bins[b].reactions.push_back(index);
+        m_bins[b].sum += m_values[index];
+    }
+
+public:
+
+    /**
+     * Default constructor for the CompositionRejection class
+     */
+    CompositionRejection() = default;
+
+    /**
+     * Constructor for the CompositionRejection class
+     * @param values propensities of the reactions
+     */
+    explicit CompositionRejection(const std::vector<double>& values) {
+        reset(values);
+    }
+
+    /**
+     * Replaces all the propensities and rebuilds the bins
+     * @param values propensities of the reactions
+     */
+    void reset(const std::vector<double>& values) {
+        m_values = values;
+        m_bins.clear();
+        m_bin_of.assign(m_values.size(), -1);
+        m_position.assign(m_values.size(), 0);
+        for (unsigned i=0; i<m_values.size(); i++) {
+            insert(i);
+        }
+    }
+
+    /**
+     * Changes the propensity of the reaction with the given index
+     * @param index index of the reaction
+     * @param value new propensity
+     */
+    void update(const unsigned& index, const double& value) {
+        int b = m_bin_of[index];
+        if (b >= 0 and value > 0 and exponent(value) == b + m_min_exponent) {
+            // The reaction stays in the same bin
+            m_bins[b].sum += value - m_values[index];
+            m_values[index] = value;
+            count_update(b);
+            return;
+        }
+
+        if (b >= 0) { remove(index); }
+        m_values[index] = value;
+        insert(index);
+    }
+
+    /**
+     * Returns the sum of all the propensities
+     */
+    double total() const {
+        double total = 0;
+        for (const auto& bin : m_bins) {
+            total += bin.sum;
+        }
+        return total;
+    }
+
+    /**
+     * Picks a reaction with probability proportional to its propensity
+     * @param random_num number in the interval [0, total())
+     * @param uniform callable returning random numbers from the uniform distribution on [0, 1)
+     * @return index of the picked reaction
+     */
+    template<typename UniformGenerator>
+    unsigned pick(double random_num, UniformGenerator& uniform) const {
+        // Composition: bins with larger propensities are checked first as they are more likely to be picked
+        int picked = -1;
+        double cumulative = 0;
+        for (int b=(int) m_bins.size()-1; b>=0; b--) {
+            if (m_bins[b].reactions.empty()) { continue; }
+            picked = b;
+            cumulative += m_bins[b].sum;
+            if (random_num < cumulative) { break; }
+        }
+
+        // Rejection: pick a reaction within the bin uniformly and accept it with probability propensity / 2^e
+        const auto& reactions = m_bins[picked].reactions;
+        double bound = std::ldexp(1.0, picked + m_min_exponent);
+        while (true) {
+            double x = uniform() * reactions.size();
+            unsigned i = (unsigned) x;
+            if (i >= reactions.size()) { i = reactions.size() - 1; }
+            // The fractional part of x is itself uniformly distributed and is reused for the acceptance test
+            if ((x - i) * bound < m_values[reactions[i]]) {
+                return reactions[i];
+            }
+        }
+    }
+
+    /**
+     * Returns the number of reactions
+     */
+    unsigned size() const {
+        return m_values.size();
+    }
+};
+
+}
+
+#endif // COMPOSITION_REJECTION_HPP
@@ -0,0 +1,190 @@
+#ifndef ENSEMBLE_HPP
+#define ENSEMBLE_HPP
+
+// stl
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// other header files
+#include "simulator.hpp"
+
+namespace StoSpa2 {
+
+/**
+ * Ensemble class - runs many independent replicas of the same model concurrently on a pool of worker threads.
+ * Every replica is a copy of a prototype simulation whose random numbers depend on the master seed and the index
+ * of the replica (see Simulator::set_seed), so the results do not depend on the number of threads or on the order
+ * in which the replicas are run. The replicas are simulated by the class of the prototype (see Simulator::clone),
+ * e.g. tau-leaping for a TauLeapSimulator and the next subvolume method for a Simulator. With the Philox streams of a prototype (see Simulator::set_rng_type) a copy
+ * does not need to copy the state of a Mersenne twister.
+ */
+class Ensemble {
+protected:
+    /** Simulation that every replica is a copy of, which keeps the class of the simulation that it was made from */
+    std::shared_ptr<const StoSpa2::Simulator> m_prototype;
+
+    /** Number of replicas */
+    unsigned m_num_replicas;
+
+    /** Master seed from which the seed of each replica is derived */
+    unsigned m_seed;
+
+    /** Number of worker threads, including the calling thread */
+    unsigned m_num_threads;
+
+    /**
+     * Calls the given function with the index of every replica, spreading the replicas over the worker threads.
+     * The first exception thrown by any replica stops the remaining ones and is rethrown.
+     * @param work function that runs a single replica
+     */
+    template<typename Work>
+    void for_each_replica(Work&& work) {
+        std::atomic<unsigned> next(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto worker = [&]() {
+            for (unsigned replica = next++; replica < m_num_replicas; replica = next++) {
+                try {
+                    work(replica);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) { error = std::current_exception(); }
+                    next = m_num_replicas;
+                }
+            }
+        };
+
+        // The calling thread is one of the workers
+        std::vector<std::thread> threads;
+        for (unsigned t=1; t<std::min(m_num_threads, m_num_replicas); t++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (error) { std::rethrow_exception(error); }
+    }
+
+    /**
+     * Returns a new replica, i.e. a copy of the prototype simulation with the master seed and the index of the
+     * replica
+     * @param replica index of the replica
+     */
+    std::unique_ptr<StoSpa2::Simulator> make_replica(const unsigned& replica) {
+        auto sim = m_prototype->clone();
+        sim->set_seed(m_seed, replica);
+        return sim;
+    }
+
+public:
+
+    /**
+     * Constructor for the Ensemble class
+     * @param prototype simulation that every replica is a copy of, of any class derived from Simulator (its seed
+     * is not used)
+     * @param num_replicas number of replicas
+     * @param seed master seed from which the seed of each replica is derived
+     * @param num_threads number of worker threads, zero uses the number of hardware threads
+     */
+    Ensemble(const StoSpa2::Simulator& prototype, unsigned num_replicas, unsigned seed, unsigned num_threads=0) :
+        m_prototype(prototype.clone()), m_num_replicas(num_replicas), m_seed(seed) {
+        set_num_threads(num_threads);
+    }
+
+    /**
+     * Constructor for the Ensemble class
+     * @param voxels vector of Voxel class instances that every replica starts from
+     * @param num_replicas number of replicas
+     * @param seed master seed from which the seed of each replica is derived
+     * @param num_threads number of worker threads, zero uses the number of hardware threads
+     */
+    Ensemble(std::vector<StoSpa2::Voxel> voxels, unsigned num_replicas, unsigned seed, unsigned num_threads=0) :
+        Ensemble(StoSpa2::Simulator(std::move(voxels)), num_replicas, seed, num_threads) {}
+
+    /**
+     * Returns the seed of the Mersenne twister of a replica, which mixes the master seed and the index of the
+     * replica (see mix_seed). The Philox streams of a replica are keyed by the master seed and the index directly.
+     * @param seed master seed
+     * @param replica index of the replica
+     */
+    static unsigned replica_seed(unsigned seed, unsigned replica) {
+        return replica == 0 ? seed : StoSpa2::mix_seed(seed, replica);
+    }
+
+    /**
+     * Sets the number of worker threads
+     * @param num_threads number of worker threads, zero uses the number of hardware threads
+     */
+    void set_num_threads(unsigned num_threads) {
+        m_num_threads = num_threads > 0 ? num_threads : std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    /**
+     * Returns the number of worker threads
+     */
+    unsigned get_num_threads() {
+        return m_num_threads;
+    }
+
+    /**
+     * Returns the number of replicas
+     */
+    unsigned get_num_replicas() {
+        return m_num_replicas;
+    }
+
+    /**
+     * Returns the master seed
+     */
+    unsigned get_seed() {
+        return m_seed;
+    }
+
+    /**
+     * Runs every replica until the given time (see Simulator::advance)
+     * @param time_point the point in time that every replica reaches
+     * @return number of molecules in each voxel (see Simulator::get_molecules) of each replica
+     */
+    std::vector<std::vector<unsigned>> run(double time_point) {
+        std::vector<std::vector<unsigned>> output(m_num_replicas);
+        for_each_replica([this, &output, &time_point](const unsigned& replica) {
+            auto sim = make_replica(replica);
+            sim->advance(time_point);
+            output[replica] = sim->get_molecules();
+        });
+        return output;
+    }
+
+    /**
+     * Runs every replica through the given times and passes the number of molecules at each of them to the given
+     * function as soon as it is reached. The function is called from the worker threads, one call at a time, in
+     * increasing order of time for each replica but with the replicas interleaved.
+     * @param time_points increasing points in time that every replica reaches
+     * @param output function that takes the index of a replica, the time and the number of molecules in each voxel
+     */
+    void run(const std::vector<double>& time_points,
+             const std::function<void (const unsigned&, const double&, const std::vector<unsigned>&)>& output) {
+        std::mutex output_mutex;
+        for_each_replica([this, &time_points, &output, &output_mutex](const unsigned& replica) {
+            auto sim = make_replica(replica);
+            for (const auto& time_point : time_points) {
+                sim->advance(time_point);
+                auto molecules = sim->get_molecules();
+                std::lock_guard<std::mutex> lock(output_mutex);
+                output(replica, time_point, molecules);
+            }
+        });
+    }
+};
+
+}
+
+#endif // ENSEMBLE_HPP
@@ -0,0 +1,268 @@
+
+#ifndef EVENT_QUEUE_HPP
+#define EVENT_QUEUE_HPP
+
+// stl
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// other header files
+#include "calendar_queue.hpp"
+
+namespace StoSpa2 {
+
+/**
+ * IndexedPriorityQueue class - binary min-heap of the times of the next events, one for each voxel.
+ * Alongside the heap, the position of each voxel within the heap is stored, so that the time of any voxel
+ * can be changed in place (sift-up / sift-down) in O(log N) without any allocation. This is the queue used
+ * by the next subvolume method. Ties are broken by the voxel index and infinite times are valid entries.
+ */
+class IndexedPriorityQueue {
+protected:
+    /** Time of the next event for each voxel ordered according to voxel indices */
+    std::vector<double> m_times;
+
+    /** Binary heap of voxel indices, the voxel with the earliest next event is at the root */
+    std::vector<unsigned> m_heap;
+
+    /** Position of each voxel within m_heap ordered according to voxel indices */
+    std::vector<unsigned> m_positions;
+
+    /**
+     * Returns whether the event of voxel a comes before the event of voxel b
+     * @param a index of the first voxel
+     * @param b index of the second voxel
+     * @return whether voxel a is to be placed above voxel b in the heap
+     */
+    bool before(const unsigned& a, const unsigned& b) const {
+        if (m_times[a] != m_times[b]) {
+            return m_times[a] < m_times[b];
+        }
+        return a < b;
+    }
+
+    /**
+     * Moves the voxel at the given position towards the root of the heap until the heap property holds
+     * @param pos position within the heap
+     */
+    void sift_up(unsigned pos) {
+        unsigned index = m_heap[pos];
+        while (pos > 0) {
+            unsigned parent = (pos - 1) / 2;
+            if (!before(index, m_heap[parent])) { break; }
+            m_heap[pos] = m_heap[parent];
+            m_positions[m_heap[pos]] = pos;
+            pos = parent;
+        }
+        m_heap[pos] = index;
+        m_positions[index] = pos;
+    }
+
+    /**
+     * Moves the voxel at the given position towards the leaves of the heap until the heap property holds
+     * @param pos position within the heap
+     */
+    void sift_down(unsigned pos) {
+        unsigned index = m_heap[pos];
+        unsigned n = m_heap.size();
+        while (true) {
+            unsigned child = 2 * pos + 1;
+            if (child >= n) { break; }
+            if (child + 1 < n and before(m_heap[child + 1], m_heap[child])) {
+                child += 1;
+            }
+            if (!before(m_heap[child], index)) { break; }
+            m_heap[pos] = m_heap[child];
+            m_positions[m_heap[pos]] = pos;
+            pos = child;
+        }
+        m_heap[pos] = index;
+        m_positions[index] = pos;
+    }
+
+public:
+
+    /**
+     * Default constructor for the IndexedPriorityQueue class, creates an empty queue
+     */
+    IndexedPriorityQueue() = default;
+
+    /**
+     * Constructor for the IndexedPriorityQueue class
+     * @param times times of the next events ordered according to voxel indices
+     */
+    explicit IndexedPriorityQueue(std::vector<double> times) {
+        reset(std::move(times));
+    }
+
+    /**
+     * Replaces the contents of the queue and rebuilds the heap in O(N)
+     * @param times times of the next events ordered according to voxel indices
+     */
+    void reset(std::vector<double> times) {
+        m_times = std::move(times);
+        m_heap.resize(m_times.size());
+        m_positions.resize(m_times.size());
+        for (unsigned i=0; i<m_times.size(); i++) {
+            m_heap[i] = i;
+            m_positions[i] = i;
+        }
+        for (unsigned pos=m_heap.size()/2; pos-- > 0;) {
+            sift_down(pos);
+        }
+    }
+
+    /**
+     * Changes the time of the next event for the voxel with the given index
+     * @param index index of the voxel
+     * @param time new time of the next event
+     */
+    void update(const unsigned& index, const double& time) {
+        double old_time = m_times[index];
+        m_times[index] = time;
+        if (time < old_time) {
+            sift_up(m_positions[index]);
+        }
+        else {
+            sift_down(m_positions[index]);
+        }
+    }
+
+    /**
+     * Returns the index of the voxel with the earliest next event
+     */
+    unsigned top_index() const {
+        if (m_heap.empty()) {
+            throw std::runtime_error("IndexedPriorityQueue::top_index: the queue is empty");
+        }
+        return m_heap[0];
+    }
+
+    /**
+     * Returns the time of the earliest next event (infinity if the queue is empty)
+     */
+    double top_time() const {
+        return m_heap.empty() ? std::numeric_limits<double>::infinity() : m_times[m_heap[0]];
+    }
+
+    /**
+     * Returns the time of the next event for the voxel with the given index
+     * @param index index of the voxel
+     */
+    double get_time(const unsigned& index) const {
+        return m_times[index];
+    }
+
+    /**
+     * Returns the number of voxels in the queue
+     */
+    unsigned size() const {
+        return m_times.size();
+    }
+
+    /**
+     * Returns whether the queue is empty
+     */
+    bool empty() const {
+        return m_times.empty();
+    }
+};
+
+/**
+ * Data structures that can hold the times of the next reactions in a simulation
+ */
+enum class QueueType { binary_heap, calendar };
+
+/**
+ * EventQueue class - times of the next events, one for each voxel, held either in a binary heap (O(log N)
+ * updates, a good default) or in a calendar queue (amortised O(1) updates, faster for very large domains).
+ * The data structure is chosen at construction and all the calls are forwarded to it.
+ */
+class EventQueue {
+protected:
+    /** Data structure used to hold the times */
+    QueueType m_type;
+
+    /** Binary heap, used if m_type is QueueType::binary_heap */
+    IndexedPriorityQueue m_heap;
+
+    /** Calendar queue, used if m_type is QueueType::calendar */
+    CalendarQueue m_calendar;
+
+public:
+
+    /**
+     * Constructor for the EventQueue class, creates an empty queue
+     * @param type data structure used to hold the times
+     */
+    explicit EventQueue(QueueType type=QueueType::binary_heap) : m_type(type) {}
+
+    /**
+     * Returns the data structure used to hold the times
+     */
+    QueueType get_type() const {
+        return m_type;
+    }
+
+    /**
+     * Replaces the contents of the queue
+     * @param times times of the next events ordered according to voxel indices
+     */
+    void reset(std::vector<double> times) {
+        if (m_type == QueueType::calendar) { m_calendar.reset(std::move(times)); }
+        else { m_heap.reset(std::move(times)); }
+    }
+
+    /**
+     * Changes the time of the next event for the voxel with the given index
+     * @param index index of the voxel
+     * @param time new time of the next event
+     */
+    void update(const unsigned& index, const double& time) {
+        if (m_type == QueueType::calendar) { m_calendar.update(index, time); }
+        else { m_heap.update(index, time); }
+    }
+
+    /**
+     * Returns the index of the voxel with the earliest next event
+     */
+    unsigned top_index() {
+        return m_type == QueueType::calendar ? m_calendar.top_index() : m_heap.top_index();
+    }
+
+    /**
+     * Returns the time of the earliest next event (infinity if the queue is empty)
+     */
+    double top_time() {
+        return m_type == QueueType::calendar ? m_calendar.top_time() : m_heap.top_time();
+    }
+
+    /**
+     * Returns the time of the next event for the voxel with the given index
+     * @param index index of the voxel
+     */
+    double get_time(const unsigned& index) const {
+        return m_type == QueueType::calendar ? m_calendar.get_time(index) : m_heap.get_time(index);
+    }
+
+    /**
+     * Returns the number of voxels in the queue
+     */
+    unsigned size() const {
+        return m_type == QueueType::calendar ? m_calendar.size() : m_heap.size();
+    }
+
+    /**
+     * Returns whether the queue is empty
+     */
+    bool empty() const {
+        return size() == 0;
+    }
+};
+
+}
+
+#endif // EVENT_QUEUE_HPP
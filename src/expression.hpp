@@ -0,0 +1,482 @@
+
+#ifndef EXPRESSION_HPP
+#define EXPRESSION_HPP
+
+// stl
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace StoSpa2 {
+
+/**
+ * Expression class - propensity given as a string, e.g. "A*(A-1)*B/V^2", which is parsed once and compiled into
+ * a short list of register instructions that are evaluated natively. Names of species are given to the
+ * constructor and V stands for the voxel size. Supported are numbers, + - * / ^, parentheses and the functions
+ * exp, log, sqrt, min and max. Subexpressions that only contain numbers are evaluated at compile time.
+ */
+class Expression {
+protected:
+    /** Operations of the instructions (K denotes a constant right operand) */
+    enum class Op : unsigned char { constant, species, size, add, sub, mul, div, pow, add_k, sub_k, mul_k, div_k, pow_k, pow_int,
+                    neg, exp, log, sqrt, min, max };
+
+    /** Single register instruction: registers[dst] = registers[a] op registers[b] (or op value) */
+    struct Instruction {
+        /** Operation */
+        Op op;
+
+        /** Register that holds the result */
+        unsigned char dst;
+
+        /** Register of the left (or only) operand */
+        unsigned char a;
+
+        /** Register of the right operand */
+        unsigned char b;
+
+        /** Index of a species */
+        unsigned index;
+
+        /** Constant operand or integer exponent */
+        double value;
+    };
+
+    /** Node of the syntax tree built by the parser */
+    struct Node {
+        /** Operation */
+        Op op;
+
+        /** Value of a constant or index of a species */
+        double value;
+
+        /** Children in m_nodes (-1 if absent) */
+        int left, right;
+    };
+
+    /** Original text of the expression */
+    std::string m_text;
+
+    /** Names of the species in the order of their indices */
+    std::vector<std::string> m_species;
+
+    /** Indices of the species that appear in the expression in increasing order */
+    std::vector<unsigned> m_used_species;
+
+    /** Compiled instructions, the result is left in the first register */
+    std::vector<Instruction> m_code;
+
+    /** Number of registers used during evaluation */
+    unsigned m_num_registers = 1;
+
+    /** Syntax tree, only used while compiling */
+    std::vector<Node> m_nodes;
+
+    /** Position of the parser within m_text */
+    std::size_t m_pos = 0;
+
+    /**
+     * Throws an error that describes the position of the parser
+     * @param message description of the error
+     */
+    [[noreturn]] void error(const std::string& message) const {
+        throw std::runtime_error("Expression::Expression: " + message + " at position " + std::to_string(m_pos) +
+                                 " in \"" + m_text + "\"");
+    }
+
+    /**
+     * Skips whitespace and returns the next character (or zero at the end of the text)
+     */
+    char peek() {
+        while (m_pos < m_text.size() and std::isspace((unsigned char) m_text[m_pos])) { m_pos++; }
+        return m_pos < m_text.size() ? m_text[m_pos] : '\0';
+    }
+
+    /**
+     * Adds a node to the syntax tree, evaluating it right away if all of its children are constants
+     * @return index of the node
+     */
+    int add_node(Op op, int left=-1, int right=-1, double value=0.0) {
+        bool constant_left = left >= 0 and m_nodes[left].op == Op::constant;
+        bool constant_right = right < 0 or m_nodes[right].op == Op::constant;
+        if (left >= 0 and constant_left and constant_right) {
+            double x = m_nodes[left].value;
+            double y = right >= 0 ? m_nodes[right].value : 0.0;
+            m_nodes.push_back({Op::constant, apply(op, x, y), -1, -1});
+        }
+        else {
+            m_nodes.push_back({op, value, left, right});
+        }
+        return m_nodes.size() - 1;
+    }
+
+    /**
+     * Returns the result of a binary or unary operation
+     */
+    static double apply(const Op& op, const double& x, const double& y) {
+        switch (op) {
+            case Op::add: case Op::add_k: return x + y;
+            case Op::sub: case Op::sub_k: return x - y;
+            case Op::mul: case Op::mul_k: return x * y;
+            case Op::div: case Op::div_k: return x / y;
+            case Op::pow: case Op::pow_k: return std::pow(x, y);
+            case Op::neg: return -x;
+            case Op::exp: return std::exp(x);
+            case Op::log: return std::log(x);
+            case Op::sqrt: return std::sqrt(x);
+            case Op::min: return std::min(x, y);
+            case Op::max: return std::max(x, y);
+            default: return x;
+        }
+    }
+
+    /** expression := term (('+' | '-') term)* */
+    int parse_expression() {
+        int node = parse_term();
+        while (peek() == '+' or peek() == '-') {
+            Op op = m_text[m_pos++] == '+' ? Op::add : Op::sub;
+            node = add_node(op, node, parse_term());
+        }
+        return node;
+    }
+
+    /** term := unary (('*' | '/') unary)* */
+    int parse_term() {
+        int node = parse_unary();
+        while (peek() == '*' or peek() == '/') {
+            Op op = m_text[m_pos++] == '*' ? Op::mul : Op::div;
+            node = add_node(op, node, parse_unary());
+        }
+        return node;
+    }
+
+    /** unary := ('-' | '+') unary | power */
+    int parse_unary() {
+        if (peek() == '-') {
+            m_pos++;
+            return add_node(Op::neg, parse_unary());
+        }
+        if (peek() == '+') {
+            m_pos++;
+            return parse_unary();
+        }
+        return parse_power();
+    }
+
+    /** power := primary ('^' unary)? */
+    int parse_power() {
+        int node = parse_primary();
+        if (peek() == '^') {
+            m_pos++;
+            node = add_node(Op::pow, node, parse_unary());
+        }
+        return node;
+    }
+
+    /** primary := number | species | 'V' | function '(' arguments ')' | '(' expression ')' */
+    int parse_primary() {
+        char c = peek();
+        if (c == '(') {
+            m_pos++;
+            int node = parse_expression();
+            if (peek() != ')') { error("expected ')'"); }
+            m_pos++;
+            return node;
+        }
+        if (std::isdigit((unsigned char) c) or c == '.') {
+            const char* start = m_text.c_str() + m_pos;
+            char* end;
+            double value = std::strtod(start, &end);
+            if (end == start) { error("invalid number"); }
+            m_pos += end - start;
+            return add_node(Op::constant, -1, -1, value);
+        }
+        if (std::isalpha((unsigned char) c) or c == '_') {
+            std::size_t start = m_pos;
+            while (m_pos < m_text.size() and (std::isalnum((unsigned char) m_text[m_pos]) or m_text[m_pos] == '_')) {
+                m_pos++;
+            }
+            std::string name = m_text.substr(start, m_pos - start);
+            if (peek() == '(') {
+                return parse_function(name);
+            }
+
+            auto it = std::find(m_species.begin(), m_species.end(), name);
+            if (it != m_species.end()) {
+                unsigned index = it - m_species.begin();
+                m_used_species.push_back(index);
+                return add_node(Op::species, -1, -1, index);
+            }
+            if (name == "V") {
+                return add_node(Op::size);
+            }
+            m_pos = start;
+            error("unknown name '" + name + "'");
+        }
+        error(c == '\0' ? "unexpected end" : std::string("unexpected character '") + c + "'");
+    }
+
+    /**
+     * Parses the arguments of a function
+     * @param name name of the function
+     */
+    int parse_function(const std::string& name) {
+        m_pos++;
+        int first = parse_expression();
+        int second = -1;
+        if (name == "min" or name == "max") {
+            if (peek() != ',') { error("expected ','"); }
+            m_pos++;
+            second = parse_expression();
+        }
+        if (peek() != ')') { error("expected ')'"); }
+        m_pos++;
+
+        if (name == "exp") { return add_node(Op::exp, first); }
+        if (name == "log") { return add_node(Op::log, first); }
+        if (name == "sqrt") { return add_node(Op::sqrt, first); }
+        if (name == "min") { return add_node(Op::min, first, second); }
+        if (name == "max") { return add_node(Op::max, first, second); }
+        error("unknown function '" + name + "'");
+    }
+
+    /**
+     * Appends a single instruction to the compiled code
+     */
+    void push(Op op, unsigned dst, unsigned a, unsigned b, double value) {
+        unsigned index = op == Op::species ? (unsigned) value : 0;
+        m_code.push_back({op, (unsigned char) dst, (unsigned char) a, (unsigned char) b, index, value});
+    }
+
+    /**
+     * Emits the instructions that leave the value of the node in the given register
+     * @param node index of the node
+     * @param reg register for the result, registers above it are free
+     */
+    void emit(const int& node, const unsigned& reg) {
+        const Node& n = m_nodes[node];
+        if (reg >= max_registers) { error("expression nested too deeply"); }
+        m_num_registers = std::max(m_num_registers, reg + 1);
+
+        switch (n.op) {
+            case Op::constant:
+            case Op::species:
+            case Op::size:
+                push(n.op, reg, 0, 0, n.value);
+                return;
+            default:
+                break;
+        }
+
+        emit(n.left, reg);
+        if (n.right < 0) {
+            push(n.op, reg, reg, 0, 0.0);
+            return;
+        }
+
+        const Node& right = m_nodes[n.right];
+        if (right.op == Op::constant) {
+            // Small integer powers are evaluated by repeated multiplication
+            double constant = right.value;
+            if (n.op == Op::pow and constant == std::floor(constant) and std::abs(constant) <= 16) {
+                push(Op::pow_int, reg, reg, 0, constant);
+                return;
+            }
+
+            // Operations with a constant right operand do not need another register
+            Op op_k = n.op == Op::add ? Op::add_k : n.op == Op::sub ? Op::sub_k : n.op == Op::mul ? Op::mul_k :
+                      n.op == Op::div ? Op::div_k : n.op == Op::pow ? Op::pow_k : n.op;
+            if (op_k != n.op) {
+                push(op_k, reg, reg, 0, constant);
+                return;
+            }
+        }
+
+        emit(n.right, reg + 1);
+        push(n.op, reg, reg, reg + 1, 0.0);
+    }
+
+public:
+    /** Maximum number of registers, which limits how deeply the expression can be nested */
+    static constexpr unsigned max_registers = 32;
+
+    /**
+     * Default constructor for the Expression class, the expression evaluates to zero
+     */
+    Expression() : m_text("0"), m_code({{Op::constant, 0, 0, 0, 0, 0.0}}) {}
+
+    /**
+     * Constructor for the Expression class, parses and compiles the expression
+     * @param text the expression, e.g. "A*(A-1)*B/V^2"
+     * @param species names of the species in the order of their indices
+     */
+    Expression(std::string text, std::vector<std::string> species) :
+        m_text(std::move(text)), m_species(std::move(species)) {
+
+        for (const auto& name : m_species) {
+            if (name == "V" or name == "exp" or name == "log" or name == "sqrt" or name == "min" or name == "max") {
+                throw std::runtime_error("Expression::Expression: '" + name + "' cannot be a name of a species");
+            }
+        }
+
+        int root = parse_expression();
+        if (peek() != '\0') {
+            error(std::string("unexpected character '") + m_text[m_pos] + "'");
+        }
+        emit(root, 0);
+        m_nodes.clear();
+
+        std::sort(m_used_species.begin(), m_used_species.end());
+        m_used_species.erase(std::unique(m_used_species.begin(), m_used_species.end()), m_used_species.end());
+    }
+
+    /**
+     * Evaluates the expression
+     * @param num_molecules number of molecules given as a vector
+     * @param voxel_size length / area / volume of a voxel
+     */
+    double evaluate(const std::vector<unsigned>& num_molecules, const double& voxel_size) const {
+        return evaluate(num_molecules.data(), 1, voxel_size);
+    }
+
+    /**
+     * Evaluates the expression given the number of molecules held with a stride (e.g. in a MoleculeStore)
+     * @param num_molecules pointer to the number of molecules of the first species
+     * @param stride distance between the numbers of molecules of consecutive species
+     * @param voxel_size length / area / volume of a voxel
+     */
+    double evaluate(const unsigned* num_molecules, const std::size_t& stride, const double& voxel_size) const {
+        // Registers live on the stack, so that the same expression can be evaluated concurrently
+        double r[max_registers];
+        for (const auto& ins : m_code) {
+            switch (ins.op) {
+                case Op::constant: r[ins.dst] = ins.value; break;
+                case Op::species: r[ins.dst] = num_molecules[ins.index * stride]; break;
+                case Op::size: r[ins.dst] = voxel_size; break;
+                case Op::add: r[ins.dst] = r[ins.a] + r[ins.b]; break;
+                case Op::sub: r[ins.dst] = r[ins.a] - r[ins.b]; break;
+                case Op::mul: r[ins.dst] = r[ins.a] * r[ins.b]; break;
+                case Op::div: r[ins.dst] = r[ins.a] / r[ins.b]; break;
+                case Op::pow: r[ins.dst] = std::pow(r[ins.a], r[ins.b]); break;
+                case Op::add_k: r[ins.dst] = r[ins.a] + ins.value; break;
+                case Op::sub_k: r[ins.dst] = r[ins.a] - ins.value; break;
+                case Op::mul_k: r[ins.dst] = r[ins.a] * ins.value; break;
+                case Op::div_k: r[ins.dst] = r[ins.a] / ins.value; break;
+                case Op::pow_k: r[ins.dst] = std::pow(r[ins.a], ins.value); break;
+                case Op::pow_int: {
+                    double base = r[ins.a];
+                    double result = 1.0;
+                    int n = (int) std::abs(ins.value);
+                    for (int i=0; i<n; i++) { result *= base; }
+                    r[ins.dst] = ins.value < 0 ? 1.0 / result : result;
+                    break;
+                }
+                case Op::neg: r[ins.dst] = -r[ins.a]; break;
+                case Op::exp: r[ins.dst] = std::exp(r[ins.a]); break;
+                case Op::log: r[ins.dst] = std::log(r[ins.a]); break;
+                case Op::sqrt: r[ins.dst] = std::sqrt(r[ins.a]); break;
+                case Op::min: r[ins.dst] = std::min(r[ins.a], r[ins.b]); break;
+                case Op::max: r[ins.dst] = std::max(r[ins.a], r[ins.b]); break;
+            }
+        }
+        return r[0];
+    }
+
+    /**
+     * Returns the original text of the expression
+     */
+    std::string get_text() const {
+        return m_text;
+    }
+
+    /**
+     * Returns the indices of the species that appear in the expression in increasing order
+     */
+    std::vector<unsigned> get_species() const {
+        return m_used_species;
+    }
+
+    /**
+     * Returns the number of registers used during evaluation
+     */
+    unsigned get_num_registers() const {
+        return m_num_registers;
+    }
+
+    /**
+     * Returns the body of a C++ function equivalent to the compiled instructions, in which the number of
+     * molecules are given by the array x and the voxel size by V (see KernelCompiler)
+     */
+    std::string to_cpp() const {
+        auto reg = [](const unsigned& i) { return "r" + std::to_string(i); };
+        auto num = [](const double& value) {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+            std::string text(buffer);
+            // Keep the constants in double precision, e.g. "2" becomes "2.0"
+            if (text.find_first_of(".en") == std::string::npos) { text += ".0"; }
+            return "(" + text + ")";
+        };
+
+        std::string code = "    double";
+        for (unsigned i=0; i<m_num_registers; i++) {
+            code += (i > 0 ? ", " : " ") + reg(i);
+        }
+        code += ";\n";
+
+        for (const auto& ins : m_code) {
+            std::string a = reg(ins.a), b = reg(ins.b);
+            std::string rhs;
+            switch (ins.op) {
+                case Op::constant: rhs = num(ins.value); break;
+                case Op::species: rhs = "(double) x[" + std::to_string(ins.index) + "]"; break;
+                case Op::size: rhs = "V"; break;
+                case Op::add: rhs = a + " + " + b; break;
+                case Op::sub: rhs = a + " - " + b; break;
+                case Op::mul: rhs = a + " * " + b; break;
+                case Op::div: rhs = a + " / " + b; break;
+                case Op::pow: rhs = "std::pow(" + a + ", " + b + ")"; break;
+                case Op::add_k: rhs = a + " + " + num(ins.value); break;
+                case Op::sub_k: rhs = a + " - " + num(ins.value); break;
+                case Op::mul_k: rhs = a + " * " + num(ins.value); break;
+                case Op::div_k: rhs = a + " / " + num(ins.value); break;
+                case Op::pow_k: rhs = "std::pow(" + a + ", " + num(ins.value) + ")"; break;
+                case Op::pow_int: {
+                    int n = (int) std::abs(ins.value);
+                    rhs = "1.0";
+                    for (int i=0; i<n; i++) { rhs += " * " + a; }
+                    if (ins.value < 0) { rhs = "1.0 / (" + rhs + ")"; }
+                    break;
+                }
+                case Op::neg: rhs = "-" + a; break;
+                case Op::exp: rhs = "std::exp(" + a + ")"; break;
+                case Op::log: rhs = "std::log(" + a + ")"; break;
+                case Op::sqrt: rhs = "std::sqrt(" + a + ")"; break;
+                case Op::min: rhs = "std::min(" + a + ", " + b + ")"; break;
+                case Op::max: rhs = "std::max(" + a + ", " + b + ")"; break;
+            }
+            code += "    " + reg(ins.dst) + " = " + rhs + ";\n";
+        }
+        code += "    return r0;\n";
+        return code;
+    }
+
+    /**
+     * Returns the number of compiled instructions
+     */
+    unsigned get_num_instructions() const {
+        return m_code.size();
+    }
+};
+
+constexpr unsigned Expression::max_registers;
+
+}
+
+#endif // EXPRESSION_HPP
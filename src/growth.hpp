@@ -0,0 +1,367 @@
+#ifndef GROWTH_HPP
+#define GROWTH_HPP
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace StoSpa2 {
+
+/**
+ * Kinds of growth laws. Closed-form laws and laws interpolated from a table are evaluated without calling a
+ * std::function (and hence without re-entering the Python interpreter for laws created from pystospa).
+ */
+enum class GrowthKind { custom, constant, exponential, linear, logistic, piecewise, tabulated };
+
+/**
+ * GrowthLaw class - the factor by which a voxel has grown in a single spatial dimension as a function of time.
+ * A law is either an arbitrary function, a closed-form law (exponential, linear or logistic growth, all equal to
+ * one at time zero), a piecewise linear law through the given points or a function tabulated on a uniform grid
+ * once at setup and interpolated linearly afterwards.
+ */
+class GrowthLaw {
+protected:
+    /** Kind of the growth law */
+    GrowthKind m_kind;
+
+    /** Arbitrary growth function shared by the copies of the law (custom only) */
+    std::shared_ptr<const std::function<double (const double&)>> m_func;
+
+    /** Identity of the function that the law was made from, custom laws with the same identity are equal */
+    const void* m_identity = nullptr;
+
+    /** Growth rate (exponential, linear and logistic only) */
+    double m_rate = 0;
+
+    /** Carrying capacity relative to the initial size (logistic only) */
+    double m_capacity = 1;
+
+    /** Times of the points, evenly spaced for a tabulated law (piecewise and tabulated only) */
+    std::vector<double> m_times;
+
+    /** Growth factors at the points (piecewise and tabulated only) */
+    std::vector<double> m_factors;
+
+    /**
+     * Constructor for the GrowthLaw class
+     * @param kind kind of the growth law
+     */
+    explicit GrowthLaw(GrowthKind kind) : m_kind(kind) {}
+
+    /**
+     * Interpolates linearly between the points, the factor is constant before the first and after the last point
+     * @param time time at which the law is evaluated
+     */
+    double interpolate(const double& time) const {
+        if (time <= m_times.front()) { return m_factors.front(); }
+        if (time >= m_times.back()) { return m_factors.back(); }
+
+        // The points of a tabulated law are evenly spaced, so the interval is found without a search
+        std::size_t i;
+        if (m_kind == GrowthKind::tabulated) {
+            double step = (m_times.back() - m_times.front()) / (m_times.size() - 1);
+            i = std::min((std::size_t) ((time - m_times.front()) / step), m_times.size() - 2);
+        }
+        else {
+            i = std::upper_bound(m_times.begin(), m_times.end(), time) - m_times.begin() - 1;
+        }
+        double w = (time - m_times[i]) / (m_times[i+1] - m_times[i]);
+        return (1 - w) * m_factors[i] + w * m_factors[i+1];
+    }
+
+public:
+
+    /**
+     * Constructor for the GrowthLaw class from an arbitrary growth function
+     * @param func growth factor as a function of time
+     * @param identity identity of the object that the function wraps (e.g. a Python function), which func needs
+     * to keep alive, so that laws made from the same object separately are equal. Only copies of the law are
+     * equal if it is null.
+     */
+    GrowthLaw(std::function<double (const double&)> func, const void* identity=nullptr) :
+        m_kind(GrowthKind::custom) {
+        if (!func) {
+            throw std::runtime_error("GrowthLaw::GrowthLaw: the growth function is empty");
+        }
+        m_func = std::make_shared<const std::function<double (const double&)>>(std::move(func));
+        m_identity = identity ? identity : m_func.get();
+    }
+
+    /**
+     * Returns a law of a voxel that does not grow
+     */
+    static GrowthLaw constant() {
+        return GrowthLaw(GrowthKind::constant);
+    }
+
+    /**
+     * Returns the law exp(rate * t)
+     * @param rate growth rate
+     */
+    static GrowthLaw exponential(double rate) {
+        GrowthLaw law(GrowthKind::exponential);
+        law.m_rate = rate;
+        return law;
+    }
+
+    /**
+     * Returns the law 1 + rate * t
+     * @param rate growth rate
+     */
+    static GrowthLaw linear(double rate) {
+        GrowthLaw law(GrowthKind::linear);
+        law.m_rate = rate;
+        return law;
+    }
+
+    /**
+     * Returns the law capacity / (1 + (capacity - 1) * exp(-rate * t))
+     * @param rate growth rate
+     * @param capacity carrying capacity relative to the initial size
+     */
+    static GrowthLaw logistic(double rate, double capacity) {
+        if (capacity <= 0) {
+            throw std::runtime_error("GrowthLaw::logistic: capacity needs to be greater than 0.0");
+        }
+        GrowthLaw law(GrowthKind::logistic);
+        law.m_rate = rate;
+        law.m_capacity = capacity;
+        return law;
+    }
+
+    /**
+     * Returns the law that is linear between the given points and constant before the first and after the last
+     * @param times increasing times of the points
+     * @param factors growth factors at the points
+     */
+    static GrowthLaw piecewise(std::vector<double> times, std::vector<double> factors) {
+        if (times.empty() or times.size() != factors.size()) {
+            std::string m = "GrowthLaw::piecewise: times and factors need to be non-empty and of the same size";
+            throw std::runtime_error(m);
+        }
+        for (std::size_t i=1; i<times.size(); i++) {
+            if (times[i] <= times[i-1]) {
+                throw std::runtime_error("GrowthLaw::piecewise: times need to be increasing");
+            }
+        }
+        GrowthLaw law(GrowthKind::piecewise);
+        law.m_times = std::move(times);
+        law.m_factors = std::move(factors);
+        return law;
+    }
+
+    /**
+     * Returns the law that samples the given function once at evenly spaced times and interpolates linearly
+     * between them, the factor is constant outside of the sampled interval
+     * @param func growth factor as a function of time
+     * @param start_time first sampled time
+     * @param end_time last sampled time
+     * @param num_points number of sampled times
+     */
+    static GrowthLaw tabulated(const std::function<double (const double&)>& func, double start_time,
+                               double end_time, unsigned num_points=1001) {
+        if (num_points < 2 or end_time <= start_time) {
+            std::string m = "GrowthLaw::tabulated: at least two points in an interval of positive length are needed";
+            throw std::runtime_error(m);
+        }
+        GrowthLaw law(GrowthKind::tabulated);
+        for (unsigned i=0; i<num_points; i++) {
+            double time = i + 1 < num_points ? start_time + i * (end_time - start_time) / (num_points - 1)
+                                             : end_time;
+            law.m_times.push_back(time);
+            law.m_factors.push_back(func(time));
+        }
+        return law;
+    }
+
+    /**
+     * Returns the growth factor at the given time
+     * @param time time at which the law is evaluated
+     */
+    double operator () (const double& time) const {
+        switch (m_kind) {
+            case GrowthKind::constant:
+                return 1.0;
+            case GrowthKind::exponential:
+                return std::exp(m_rate * time);
+            case GrowthKind::linear:
+                return 1.0 + m_rate * time;
+            case GrowthKind::logistic:
+                return m_capacity / (1.0 + (m_capacity - 1.0) * std::exp(-m_rate * time));
+            case GrowthKind::piecewise:
+            case GrowthKind::tabulated:
+                return interpolate(time);
+            default:
+                return (*m_func)(time);
+        }
+    }
+
+    /**
+     * Returns the smallest and the largest growth factor over the given interval of time. These are exact for
+     * all the kinds except custom, whose function is assumed to be monotone over the interval.
+     * @param start_time start of the interval
+     * @param end_time end of the interval
+     */
+    std::pair<double, double> range(const double& start_time, const double& end_time) const {
+        double start = (*this)(start_time);
+        double end = (*this)(end_time);
+        std::pair<double, double> extremes = std::minmax(start, end);
+
+        // Piecewise linear laws also reach their extremes at the points inside the interval
+        if (m_kind == GrowthKind::piecewise or m_kind == GrowthKind::tabulated) {
+            auto first = std::upper_bound(m_times.begin(), m_times.end(), start_time);
+            auto last = std::lower_bound(m_times.begin(), m_times.end(), end_time);
+            for (auto it = first; it < last; it++) {
+                double factor = m_factors[it - m_times.begin()];
+                extremes.first = std::min(extremes.first, factor);
+                extremes.second = std::max(extremes.second, factor);
+            }
+        }
+        return extremes;
+    }
+
+    /**
+     * Returns the kind of the growth law
+     */
+    GrowthKind get_kind() const {
+        return m_kind;
+    }
+
+    /**
+     * Returns the growth rate (exponential, linear and logistic only)
+     */
+    double get_rate() const {
+        return m_rate;
+    }
+
+    /**
+     * Returns a hash of the law, equal laws have equal hashes
+     */
+    std::size_t hash() const {
+        std::size_t seed = std::hash<int>()((int) m_kind);
+        auto combine = [&seed](std::size_t value) { seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2); };
+        combine(std::hash<const void*>()(m_identity));
+        combine(std::hash<double>()(m_rate));
+        combine(std::hash<double>()(m_capacity));
+        for (std::size_t i=0; i<m_times.size(); i++) {
+            combine(std::hash<double>()(m_times[i]));
+            combine(std::hash<double>()(m_factors[i]));
+        }
+        return seed;
+    }
+
+    /**
+     * Overloaded == operator for the GrowthLaw class, custom laws are equal if they are copies of the same law or
+     * are made from the same object (see the constructor)
+     * @param g1 first instance of GrowthLaw class
+     * @param g2 second instance of GrowthLaw class
+     * @return whether the laws are equal
+     */
+    friend bool operator == (const GrowthLaw& g1, const GrowthLaw& g2) {
+        if (g1.m_kind != g2.m_kind) { return false; }
+        if (g1.m_identity != g2.m_identity) { return false; }
+        if (g1.m_rate != g2.m_rate or g1.m_capacity != g2.m_capacity) { return false; }
+        return g1.m_times == g2.m_times and g1.m_factors == g2.m_factors;
+    }
+
+    /**
+     * Overloaded != operator for the GrowthLaw class
+     * @param g1 first instance of GrowthLaw class
+     * @param g2 second instance of GrowthLaw class
+     * @return whether the laws are not equal
+     */
+    friend bool operator != (const GrowthLaw& g1, const GrowthLaw& g2) {
+        return !(g1 == g2);
+    }
+};
+
+/**
+ * GrowthClock class - the distinct growth laws of a domain, referenced by handles. Each law is evaluated at most
+ * once for each distinct time, e.g. once for all the voxels updated at the same time by a tau-leaping step, or
+ * for both voxels of a diffusion event.
+ */
+class GrowthClock {
+protected:
+    /** Distinct growth laws */
+    std::vector<GrowthLaw> m_laws;
+
+    /** Handles of the laws by their hashes, so that adding a law does not compare it with every other law */
+    std::unordered_multimap<std::size_t, unsigned> m_handles;
+
+    /** Time at which each law was last evaluated */
+    std::vector<double> m_times;
+
+    /** Growth factor of each law at the time of its last evaluation */
+    std::vector<double> m_factors;
+
+    /** Number of times any law has been evaluated */
+    unsigned long m_num_evaluations = 0;
+
+public:
+
+    /**
+     * Adds a growth law unless an equal law has been added already
+     * @param law the growth law
+     * @return handle of the law
+     */
+    unsigned add(const GrowthLaw& law) {
+        std::size_t hash = law.hash();
+        auto range = m_handles.equal_range(hash);
+        for (auto it = range.first; it != range.second; it++) {
+            if (m_laws[it->second] == law) { return it->second; }
+        }
+        m_handles.emplace(hash, m_laws.size());
+        m_laws.push_back(law);
+        m_times.push_back(std::numeric_limits<double>::quiet_NaN());
+        m_factors.push_back(1.0);
+        return m_laws.size() - 1;
+    }
+
+    /**
+     * Returns the growth factor of a law at the given time, which is evaluated only if the time has changed
+     * @param handle handle of the law
+     * @param time time at which the law is evaluated
+     */
+    double factor(const unsigned& handle, const double& time) {
+        if (m_times[handle] != time) {
+            m_factors[handle] = m_laws[handle](time);
+            m_times[handle] = time;
+            m_num_evaluations++;
+        }
+        return m_factors[handle];
+    }
+
+    /**
+     * Returns the growth law with the given handle
+     * @param handle handle of the law
+     */
+    const GrowthLaw& get_law(const unsigned& handle) const {
+        return m_laws[handle];
+    }
+
+    /**
+     * Returns the number of distinct growth laws
+     */
+    unsigned size() const {
+        return m_laws.size();
+    }
+
+    /**
+     * Returns the number of times any law has been evaluated
+     */
+    unsigned long get_num_evaluations() const {
+        return m_num_evaluations;
+    }
+};
+
+}
+
+#endif // GROWTH_HPP
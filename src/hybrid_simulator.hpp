@@ -0,0 +1,218 @@
+
+// The partitioning of reactions into fast and slow ones follows Salis H, Kaznessis Y (2005) Accurate hybrid
+// stochastic simulation of a system of coupled chemical or biochemical reactions. J Chem Phys 122(5): 054103.
+// https://doi.org/10.1063/1.1835951
+
+#ifndef HYBRID_SIMULATOR_HPP
+#define HYBRID_SIMULATOR_HPP
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+// other header files
+#include "reaction.hpp"
+#include "simulator.hpp"
+#include "voxel.hpp"
+
+namespace StoSpa2 {
+
+/**
+ * HybridSimulator class - reactions that only change species with large numbers of molecules (fast reactions)
+ * are integrated as the chemical Langevin equation (or as ordinary differential equations), while the remaining
+ * (slow) reactions are simulated exactly with the next subvolume method. Time advances in steps of fixed size,
+ * at the start of each step the reactions are repartitioned according to the current numbers of molecules,
+ * the fast reactions are integrated over the step and then the slow reactions are simulated until the end of it.
+ */
+class HybridSimulator : public Simulator {
+protected:
+    /** Size of the steps in time */
+    double m_time_step;
+
+    /** Reactions that only change species with at least this number of molecules are fast */
+    unsigned m_threshold;
+
+    /** Whether fast reactions include noise (chemical Langevin equation) or not (reaction rate equations) */
+    bool m_langevin;
+
+    /** Reactions of each voxel (they do not change during a simulation, so they are copied once) */
+    std::vector<std::vector<StoSpa2::Reaction>> m_reactions;
+
+    /** Offset of each voxel in the domain-wide vectors of species */
+    std::vector<unsigned> m_offsets;
+
+    /** Change in the number of molecules of each species in each voxel due to fast reactions */
+    std::vector<double> m_delta;
+
+    /** Fractional part of the number of molecules of each species in each voxel carried between steps */
+    std::vector<double> m_remainder;
+
+    /**
+     * Returns whether all the species changed by a reaction have at least m_threshold molecules
+     * @param voxel_idx index of the voxel that contains the reaction
+     * @param r the reaction
+     */
+    bool is_fast(const unsigned& voxel_idx, const StoSpa2::Reaction& r) {
+        for (const auto& change : r.changes) {
+            unsigned i = change.species;
+            if (m_voxels[voxel_idx].get_molecules(i) < m_threshold) { return false; }
+            if (r.diffusion_idx >= 0 and m_voxels[r.diffusion_idx].get_molecules(i) < m_threshold) { return false; }
+        }
+        return true;
+    }
+
+    /**
+     * Repartitions the reactions, integrates the fast reactions and simulates the slow ones over a single step
+     * @param end_time time at the end of the step
+     */
+    void hybrid_step(const double& end_time) {
+        double time_step = end_time - m_time;
+        std::fill(m_delta.begin(), m_delta.end(), 0.0);
+
+        // Repartition the reactions and integrate the fast ones with the Euler-Maruyama method
+        for (unsigned k=0; k<m_voxels.size(); k++) {
+            m_voxels[k].update_properties(m_time);
+            for (unsigned j=0; j<m_reactions[k].size(); j++) {
+                const auto& r = m_reactions[k][j];
+                bool fast = is_fast(k, r);
+                m_voxels[k].set_continuous(j, fast);
+                if (!fast) { continue; }
+
+                double mean = m_voxels[k].get_propensity(j) * time_step;
+                double num_firings = mean;
+                if (m_langevin) {
+                    // The distribution is created for each draw, so that it caches no variate of another stream
+                    std::normal_distribution<double> normal(0.0, 1.0);
+                    auto stream = m_rng.stream(k);
+                    num_firings += std::sqrt(mean) * normal(stream);
+                }
+                for (const auto& change : r.changes) {
+                    m_delta[m_offsets[k] + change.species] += num_firings * change.delta;
+                    if (r.diffusion_idx >= 0) {
+                        m_delta[m_offsets[r.diffusion_idx] + change.species] -= num_firings * change.delta;
+                    }
+                }
+            }
+        }
+
+        // Apply the changes, keeping the fractional parts for the following steps and
+        // making sure that the number of molecules does not become negative
+        for (unsigned k=0; k<m_voxels.size(); k++) {
+            bool changed = false;
+            for (unsigned idx=m_offsets[k]; idx<m_offsets[k+1]; idx++) {
+                changed = changed or (m_delta[idx] != 0);
+            }
+            if (!changed) { continue; }
+
+            auto molecules = m_voxels[k].get_molecules();
+            for (unsigned i=0; i<molecules.size(); i++) {
+                unsigned idx = m_offsets[k] + i;
+                double total = m_remainder[idx] + m_delta[idx];
+                double whole = std::floor(total);
+                if (molecules[i] + whole < 0) {
+                    molecules[i] = 0;
+                    m_remainder[idx] = 0;
+                }
+                else {
+                    molecules[i] += (long) whole;
+                    m_remainder[idx] = total - whole;
+                }
+            }
+            m_voxels[k].set_molecules(std::move(molecules));
+        }
+
+        // Simulate the slow reactions exactly until the end of the step
+        initialise_next_reaction_times();
+        while (next_reaction_times.top_time() < end_time) {
+            Simulator::step();
+        }
+        m_time = end_time;
+    }
+
+public:
+
+    /**
+     * Constructor for the HybridSimulator class
+     * @param voxels vector of Voxel class instances
+     * @param time initial time
+     * @param time_step size of the steps in time
+     * @param threshold reactions that only change species with at least this number of molecules are fast
+     * @param langevin whether fast reactions include noise (chemical Langevin equation) or not
+     */
+    explicit HybridSimulator(std::vector<StoSpa2::Voxel> voxels, double time=0, double time_step=0.01,
+                             unsigned threshold=1000, bool langevin=true) : Simulator(std::move(voxels), time) {
+        if (time_step <= 0) {
+            throw std::runtime_error("HybridSimulator::HybridSimulator: time_step needs to be greater than 0.0");
+        }
+        m_time_step = time_step;
+        m_threshold = threshold;
+        m_langevin = langevin;
+
+        // Copy the reactions and lay out the species of all the voxels one after another
+        m_offsets.push_back(0);
+        for (auto& vox : m_voxels) {
+            m_reactions.push_back(vox.get_reactions());
+            m_offsets.push_back(m_offsets.back() + vox.get_molecules().size());
+        }
+        for (unsigned k=0; k<m_voxels.size(); k++) {
+            for (const auto& r : m_reactions[k]) {
+                if (r.diffusion_idx >= (int) m_voxels.size()) {
+                    throw std::runtime_error("HybridSimulator::HybridSimulator: diffusion_idx out of range");
+                }
+            }
+        }
+        m_delta.resize(m_offsets.back());
+        m_remainder.resize(m_offsets.back());
+    }
+
+    /**
+     * Returns a copy of the simulator
+     */
+    std::unique_ptr<Simulator> clone() const override {
+        return std::make_unique<HybridSimulator>(*this);
+    }
+
+    /**
+     * Returns the size of the steps in time
+     */
+    double get_time_step() {
+        return m_time_step;
+    }
+
+    /**
+     * Returns the number of fast reactions (those treated as continuous) after the last step
+     */
+    unsigned get_num_fast_reactions() {
+        unsigned num_fast = 0;
+        for (auto& vox : m_voxels) {
+            for (unsigned j=0; j<vox.get_num_reactions(); j++) {
+                num_fast += vox.is_continuous(j) ? 1 : 0;
+            }
+        }
+        return num_fast;
+    }
+
+    /**
+     * Function to make a single step of the hybrid method
+     */
+    void step() override {
+        hybrid_step(m_time + m_time_step);
+    }
+
+    /**
+     * Function to make multiple steps to reach the given point in time (without going past it)
+     * @param time_point the point in time in simulation that is reached
+     */
+    void advance(double time_point) override {
+        while (m_time < time_point) {
+            hybrid_step(std::min(m_time + m_time_step, time_point));
+        }
+    }
+};
+
+}
+
+#endif // HYBRID_SIMULATOR_HPP
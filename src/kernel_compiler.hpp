@@ -0,0 +1,313 @@
+
+#ifndef KERNEL_COMPILER_HPP
+#define KERNEL_COMPILER_HPP
+
+// stl
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// posix
+#include <dlfcn.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// other header files
+#include "reaction.hpp"
+#include "voxel.hpp"
+
+namespace StoSpa2 {
+
+/**
+ * KernelCompiler class - generates a C++ translation unit with a native function for each distinct propensity
+ * of a model (mass-action and expression reactions), compiles it into a shared library with the system compiler
+ * and loads it with dlopen. The reactions of the voxels are then set to call the compiled functions. Libraries
+ * are cached in a directory under a hash of the generated code, the compiler and the flags, so that repeated
+ * runs of the same model skip the compilation. Reactions with custom propensity functions are left unchanged.
+ */
+class KernelCompiler {
+protected:
+    /** Directory in which the generated code and the compiled libraries are kept */
+    std::string m_cache_dir;
+
+    /** Command that runs the C++ compiler */
+    std::string m_compiler;
+
+    /** Flags passed to the compiler */
+    std::string m_flags;
+
+    /** Path to the library used by the last call of compile */
+    std::string m_library_path;
+
+    /** Whether the last call of compile found the library in the cache */
+    bool m_cached = false;
+
+    /**
+     * Returns the 64-bit FNV-1a hash of the given text as a hexadecimal string, which is the same across runs
+     * @param text the text to be hashed
+     */
+    static std::string hash(const std::string& text) {
+        std::uint64_t h = 14695981039346656037ULL;
+        for (const auto& c : text) {
+            h ^= (unsigned char) c;
+            h *= 1099511628211ULL;
+        }
+        char buffer[17];
+        std::snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long) h);
+        return buffer;
+    }
+
+    /**
+     * Returns whether a file exists
+     * @param path path to the file
+     */
+    static bool exists(const std::string& path) {
+        struct stat info;
+        return stat(path.c_str(), &info) == 0;
+    }
+
+    /**
+     * Returns the value of an environment variable, or the given default if it is not set
+     */
+    static std::string environment(const char* name, const std::string& default_value) {
+        const char* value = std::getenv(name);
+        return (value and *value) ? std::string(value) : default_value;
+    }
+
+    /**
+     * Returns the default directory for the compiled libraries, which is private to the user: STOSPA_KERNEL_CACHE,
+     * or stospa/kernels in XDG_CACHE_HOME or in ~/.cache, or a directory with the user id in TMPDIR
+     */
+    static std::string default_cache_dir() {
+        std::string cache_home = environment("XDG_CACHE_HOME", "");
+        if (cache_home.empty() and !environment("HOME", "").empty()) {
+            cache_home = environment("HOME", "") + "/.cache";
+        }
+        std::string directory = cache_home.empty()
+                                ? environment("TMPDIR", "/tmp") + "/stospa_kernels_" + std::to_string(geteuid())
+                                : cache_home + "/stospa/kernels";
+        return environment("STOSPA_KERNEL_CACHE", directory);
+    }
+
+    /**
+     * Checks that a string passed to the shell only contains characters that the shell does not interpret
+     * @param text the string
+     * @param name name of the string in the error message
+     */
+    static void check_shell_word(const std::string& text, const std::string& name) {
+        for (const auto& c : text) {
+            if (!std::isalnum((unsigned char) c) and std::string(" _-+=./,:@%").find(c) == std::string::npos) {
+                std::string m = "KernelCompiler::KernelCompiler: " + name + " contains a character that the shell ";
+                m += "would interpret (" + std::string(1, c) + ")";
+                throw std::runtime_error(m);
+            }
+        }
+    }
+
+    /**
+     * Checks that a file or directory is owned by the user and cannot be written by anybody else, so that no
+     * other user can plant a library that this process loads
+     * @param path path to the file or directory
+     */
+    static void check_private(const std::string& path) {
+        struct stat info;
+        if (lstat(path.c_str(), &info) != 0) {
+            throw std::runtime_error("KernelCompiler::compile: cannot access " + path);
+        }
+        if (S_ISLNK(info.st_mode) or info.st_uid != geteuid() or (info.st_mode & (S_IWGRP | S_IWOTH))) {
+            std::string m = "KernelCompiler::compile: " + path + " needs to be owned by the user and not be ";
+            m += "writable by the group or others";
+            throw std::runtime_error(m);
+        }
+    }
+
+    /**
+     * Creates a directory and its missing parents, which are accessible by the user only
+     * @param path path to the directory
+     */
+    static void make_directories(const std::string& path) {
+        for (std::size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+            std::string prefix = path.substr(0, pos);
+            if (!prefix.empty() and mkdir(prefix.c_str(), 0700) != 0 and errno != EEXIST) {
+                throw std::runtime_error("KernelCompiler::compile: cannot create " + prefix);
+            }
+            if (pos == std::string::npos) { break; }
+        }
+    }
+
+    /**
+     * Returns the body of the propensity function of each distinct propensity and the index of the function
+     * used by each reaction in each voxel (-1 for custom reactions)
+     * @param voxels vector of Voxel class instances
+     */
+    static std::pair<std::vector<std::string>, std::vector<std::vector<int>>>
+    collect(std::vector<StoSpa2::Voxel>& voxels) {
+        std::vector<std::string> bodies;
+        std::map<std::string, int> indices;
+        std::vector<std::vector<int>> functions(voxels.size());
+        for (unsigned k=0; k<voxels.size(); k++) {
+            for (const auto& r : voxels[k].get_reactions()) {
+                std::string body = r.propensity_code();
+                if (body.empty()) {
+                    functions[k].push_back(-1);
+                    continue;
+                }
+                auto it = indices.find(body);
+                if (it == indices.end()) {
+                    it = indices.emplace(body, bodies.size()).first;
+                    bodies.push_back(body);
+                }
+                functions[k].push_back(it->second);
+            }
+        }
+        return {bodies, functions};
+    }
+
+    /**
+     * Returns the C++ translation unit with a propensity function for each of the given bodies
+     * @param bodies bodies of the propensity functions
+     */
+    static std::string source(const std::vector<std::string>& bodies) {
+        std::string text = "// Propensity functions generated by StoSpa2::KernelCompiler\n";
+        text += "#include <algorithm>\n#include <cmath>\n\n";
+        for (unsigned i=0; i<bodies.size(); i++) {
+            text += "extern \"C\" double stospa_propensity_" + std::to_string(i);
+            text += "(const unsigned* x, double V) {\n" + bodies[i] + "}\n\n";
+        }
+        return text;
+    }
+
+public:
+
+    /**
+     * Constructor for the KernelCompiler class
+     * @param cache_dir directory for the compiled libraries, which needs to be owned by the user and not be
+     * writable by anybody else (see default_cache_dir if empty)
+     * @param compiler command that runs the C++ compiler (CXX or c++ if empty)
+     * @param flags flags passed to the compiler, which need to produce a shared library
+     */
+    explicit KernelCompiler(std::string cache_dir="", std::string compiler="",
+                            std::string flags="-O3 -std=c++14 -shared -fPIC") {
+        m_cache_dir = cache_dir.empty() ? default_cache_dir() : std::move(cache_dir);
+        m_compiler = compiler.empty() ? environment("CXX", "c++") : std::move(compiler);
+        m_flags = std::move(flags);
+
+        // The compiler, the flags and the paths are passed to the shell
+        check_shell_word(m_cache_dir, "cache_dir");
+        check_shell_word(m_compiler, "compiler");
+        check_shell_word(m_flags, "flags");
+    }
+
+    /**
+     * Returns the C++ translation unit with the propensity functions of a model
+     * @param voxels vector of Voxel class instances
+     */
+    std::string generate(std::vector<StoSpa2::Voxel> voxels) {
+        return source(collect(voxels).first);
+    }
+
+    /**
+     * Compiles (or loads from the cache) the propensity functions of a model and returns the voxels with
+     * their reactions set to call these functions
+     * @param voxels vector of Voxel class instances
+     */
+    std::vector<StoSpa2::Voxel> compile(std::vector<StoSpa2::Voxel> voxels) {
+        auto collected = collect(voxels);
+        const auto& functions = collected.second;
+        std::string code = source(collected.first);
+        std::string name = m_cache_dir + "/stospa_" + hash(m_compiler + "\n" + m_flags + "\n" + code);
+        m_library_path = name + ".so";
+        make_directories(m_cache_dir);
+        check_private(m_cache_dir);
+        m_cached = exists(m_library_path);
+
+        if (!m_cached) {
+            // Write and compile into temporary files and rename them, so that concurrent runs neither overwrite
+            // each other's code nor load a partial library
+            std::string suffix = "." + std::to_string(getpid());
+            std::string code_path = name + ".cpp" + suffix;
+            std::ofstream handle(code_path);
+            handle << code;
+            handle.close();
+            if (!handle) {
+                std::remove(code_path.c_str());
+                throw std::runtime_error("KernelCompiler::compile: cannot write " + code_path);
+            }
+
+            std::string temporary = name + ".so" + suffix;
+            std::string command = m_compiler + " " + m_flags + " -x c++ -o '" + temporary + "' '" + code_path + "'";
+            bool compiled = std::system(command.c_str()) == 0
+                            and std::rename(temporary.c_str(), m_library_path.c_str()) == 0;
+            std::rename(code_path.c_str(), (name + ".cpp").c_str());
+            if (!compiled) {
+                std::remove(temporary.c_str());
+                throw std::runtime_error("KernelCompiler::compile: compilation failed: " + command);
+            }
+        }
+        check_private(m_library_path);
+
+        void* handle = dlopen(m_library_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) {
+            throw std::runtime_error("KernelCompiler::compile: cannot load " + m_library_path + ": " + dlerror());
+        }
+        std::shared_ptr<void> library(handle, [](void* h) { dlclose(h); });
+
+        std::vector<propensity_kernel> kernels(collected.first.size());
+        for (unsigned i=0; i<kernels.size(); i++) {
+            std::string symbol = "stospa_propensity_" + std::to_string(i);
+            kernels[i] = reinterpret_cast<propensity_kernel>(dlsym(handle, symbol.c_str()));
+            if (!kernels[i]) {
+                throw std::runtime_error("KernelCompiler::compile: cannot find " + symbol + " in " + m_library_path);
+            }
+        }
+
+        // Re-add the reactions of each voxel, so that the cached propensities are evaluated by the kernels,
+        // equal reactions in different voxels keep sharing a single definition
+        StoSpa2::ReactionTable table;
+        for (unsigned k=0; k<voxels.size(); k++) {
+            auto reactions = voxels[k].get_reactions();
+            voxels[k].clear_reactions();
+            for (unsigned j=0; j<reactions.size(); j++) {
+                if (functions[k][j] >= 0) {
+                    reactions[j].set_kernel(kernels[functions[k][j]], library);
+                }
+                voxels[k].add_reaction(table.share(reactions[j]));
+            }
+        }
+        return voxels;
+    }
+
+    /**
+     * Returns the directory in which the compiled libraries are kept
+     */
+    std::string get_cache_dir() {
+        return m_cache_dir;
+    }
+
+    /**
+     * Returns the path to the library used by the last call of compile
+     */
+    std::string get_library_path() {
+        return m_library_path;
+    }
+
+    /**
+     * Returns whether the last call of compile found the library in the cache (and skipped the compilation)
+     */
+    bool was_cached() {
+        return m_cached;
+    }
+};
+
+}
+
+#endif // KERNEL_COMPILER_HPP
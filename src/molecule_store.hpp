@@ -0,0 +1,320 @@
+#ifndef MOLECULE_STORE_HPP
+#define MOLECULE_STORE_HPP
+
+// stl
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace StoSpa2 {
+
+/**
+ * Layouts of the domain-wide molecule store: voxel-major keeps all the species of a voxel next to each other,
+ * species-major keeps a single species of all the voxels next to each other
+ */
+enum class StoreLayout { voxel_major, species_major };
+
+/**
+ * MoleculeCounts class - number of molecules of each species of a single voxel. The counts are either owned
+ * by the instance or are a view into a MoleculeStore, where consecutive species are a given stride apart.
+ * A copy always owns its counts, so copies of voxels never alias the store of a simulation.
+ */
+class MoleculeCounts {
+protected:
+    /** Counts owned by the instance (empty for a view) */
+    std::vector<unsigned> m_owned;
+
+    /** Pointer to the count of the first species */
+    unsigned* m_data;
+
+    /** Number of species */
+    std::size_t m_size;
+
+    /** Distance between the counts of consecutive species */
+    std::size_t m_stride;
+
+public:
+
+    /**
+     * Constructor for the MoleculeCounts class, the counts are owned by the instance
+     * @param counts number of molecules of each species
+     */
+    explicit MoleculeCounts(std::vector<unsigned> counts={}) :
+        m_owned(std::move(counts)), m_data(m_owned.data()), m_size(m_owned.size()), m_stride(1) {}
+
+    /**
+     * Copy constructor for the MoleculeCounts class, the copy owns its counts
+     * @param c the counts to be copied
+     */
+    MoleculeCounts(const MoleculeCounts& c) : MoleculeCounts(c.to_vector()) {}
+
+    /**
+     * Move constructor for the MoleculeCounts class, a view stays a view into the same store
+     * @param c the counts to be moved
+     */
+    MoleculeCounts(MoleculeCounts&& c) noexcept :
+        m_owned(std::move(c.m_owned)), m_data(c.m_data), m_size(c.m_size), m_stride(c.m_stride) {
+        c.m_data = c.m_owned.data();
+        c.m_size = 0;
+    }
+
+    /**
+     * Copy assignment for the MoleculeCounts class, the instance then owns a copy of the counts
+     * @param c the counts to be copied
+     */
+    MoleculeCounts& operator = (const MoleculeCounts& c) {
+        if (this != &c) {
+            m_owned = c.to_vector();
+            m_data = m_owned.data();
+            m_size = m_owned.size();
+            m_stride = 1;
+        }
+        return *this;
+    }
+
+    /**
+     * Move assignment for the MoleculeCounts class
+     * @param c the counts to be moved
+     */
+    MoleculeCounts& operator = (MoleculeCounts&& c) noexcept {
+        if (this != &c) {
+            m_owned = std::move(c.m_owned);
+            m_data = c.m_data;
+            m_size = c.m_size;
+            m_stride = c.m_stride;
+            c.m_data = c.m_owned.data();
+            c.m_size = 0;
+        }
+        return *this;
+    }
+
+    /**
+     * Copies the counts into the given memory and makes the instance a view into it
+     * @param data pointer to the count of the first species
+     * @param stride distance between the counts of consecutive species
+     */
+    void bind(unsigned* data, std::size_t stride) {
+        for (std::size_t i=0; i<m_size; i++) {
+            data[i * stride] = m_data[i * m_stride];
+        }
+        m_owned.clear();
+        m_owned.shrink_to_fit();
+        m_data = data;
+        m_stride = stride;
+    }
+
+    /**
+     * Returns the number of molecules of a species
+     * @param species index of the species
+     */
+    unsigned& operator [] (const std::size_t& species) {
+        return m_data[species * m_stride];
+    }
+
+    /**
+     * Returns the number of molecules of a species
+     * @param species index of the species
+     */
+    const unsigned& operator [] (const std::size_t& species) const {
+        return m_data[species * m_stride];
+    }
+
+    /**
+     * Returns the number of species
+     */
+    std::size_t size() const {
+        return m_size;
+    }
+
+    /**
+     * Returns the pointer to the count of the first species
+     */
+    const unsigned* data() const {
+        return m_data;
+    }
+
+    /**
+     * Returns the distance between the counts of consecutive species
+     */
+    std::size_t stride() const {
+        return m_stride;
+    }
+
+    /**
+     * Returns whether the counts of a voxel are a view into a MoleculeStore
+     */
+    bool is_view() const {
+        return m_data != m_owned.data();
+    }
+
+    /**
+     * Replaces the number of molecules of all species (in place, so a view keeps writing into its store)
+     * @param counts number of molecules of each species
+     */
+    void assign(const std::vector<unsigned>& counts) {
+        for (std::size_t i=0; i<m_size; i++) {
+            m_data[i * m_stride] = counts[i];
+        }
+    }
+
+    /**
+     * Copies the counts into the given vector, which is resized to the number of species
+     * @param counts vector that receives the counts
+     */
+    void gather(std::vector<unsigned>& counts) const {
+        counts.resize(m_size);
+        for (std::size_t i=0; i<m_size; i++) {
+            counts[i] = m_data[i * m_stride];
+        }
+    }
+
+    /**
+     * Returns the counts as a vector
+     */
+    std::vector<unsigned> to_vector() const {
+        std::vector<unsigned> counts;
+        gather(counts);
+        return counts;
+    }
+
+    /**
+     * Overloaded == operator for the MoleculeCounts class
+     * @param c1 first instance of MoleculeCounts class
+     * @param c2 second instance of MoleculeCounts class
+     * @return whether the counts are equal
+     */
+    friend bool operator == (const MoleculeCounts& c1, const MoleculeCounts& c2) {
+        if (c1.m_size != c2.m_size) { return false; }
+        for (std::size_t i=0; i<c1.m_size; i++) {
+            if (c1[i] != c2[i]) { return false; }
+        }
+        return true;
+    }
+
+    /**
+     * Overloaded != operator for the MoleculeCounts class
+     * @param c1 first instance of MoleculeCounts class
+     * @param c2 second instance of MoleculeCounts class
+     * @return whether the counts are not equal
+     */
+    friend bool operator != (const MoleculeCounts& c1, const MoleculeCounts& c2) {
+        return !(c1 == c2);
+    }
+};
+
+/**
+ * MoleculeStore class - a single contiguous buffer with the number of molecules of all the species in all the
+ * voxels of a domain. The voxels of a simulation hold views into the store (see MoleculeCounts), so the whole
+ * state can be traversed, saved and exported without gathering it from the voxels.
+ */
+class MoleculeStore {
+protected:
+    /** Layout of the buffer */
+    StoreLayout m_layout;
+
+    /** Number of molecules of all the species in all the voxels */
+    std::vector<unsigned> m_counts;
+
+    /** Index of the count of the first species of each voxel (voxel-major) and the size of the buffer */
+    std::vector<std::size_t> m_offsets;
+
+    /** Number of species in every voxel (species-major only) */
+    std::size_t m_num_species = 0;
+
+public:
+
+    /**
+     * Constructor for the MoleculeStore class
+     * @param num_species number of species in each voxel
+     * @param layout layout of the buffer (species-major needs the same number of species in every voxel)
+     */
+    explicit MoleculeStore(const std::vector<std::size_t>& num_species={},
+                           StoreLayout layout=StoreLayout::voxel_major) : m_layout(layout) {
+        m_offsets.push_back(0);
+        for (const auto& n : num_species) {
+            m_offsets.push_back(m_offsets.back() + n);
+        }
+        if (layout == StoreLayout::species_major and !num_species.empty()) {
+            m_num_species = num_species.front();
+            for (const auto& n : num_species) {
+                if (n != m_num_species) {
+                    std::string m = "MoleculeStore::MoleculeStore: the species-major layout needs the same "
+                                    "number of species in every voxel";
+                    throw std::runtime_error(m);
+                }
+            }
+        }
+        m_counts.assign(m_offsets.back(), 0);
+    }
+
+    /**
+     * Makes the given counts of a voxel a view into the store, copying them into the store
+     * @param voxel_idx index of the voxel
+     * @param counts the counts of the voxel
+     */
+    void bind(const std::size_t& voxel_idx, MoleculeCounts& counts) {
+        if (m_layout == StoreLayout::voxel_major) {
+            counts.bind(m_counts.data() + m_offsets[voxel_idx], 1);
+        }
+        else {
+            counts.bind(m_counts.data() + voxel_idx, get_num_voxels());
+        }
+    }
+
+    /**
+     * Returns the number of molecules of a species in a voxel
+     * @param voxel_idx index of the voxel
+     * @param species index of the species
+     */
+    unsigned& at(const std::size_t& voxel_idx, const std::size_t& species) {
+        if (m_layout == StoreLayout::voxel_major) {
+            return m_counts[m_offsets[voxel_idx] + species];
+        }
+        return m_counts[species * get_num_voxels() + voxel_idx];
+    }
+
+    /**
+     * Returns the buffer with the number of molecules of all the species in all the voxels in the layout of
+     * the store (no copy is made)
+     */
+    const std::vector<unsigned>& data() const {
+        return m_counts;
+    }
+
+    /**
+     * Returns the number of molecules contained in each voxel as a single vector (voxel-major)
+     */
+    std::vector<unsigned> to_vector() const {
+        if (m_layout == StoreLayout::voxel_major) {
+            return m_counts;
+        }
+        std::size_t num_voxels = get_num_voxels();
+        std::vector<unsigned> output(m_counts.size());
+        for (std::size_t k=0; k<num_voxels; k++) {
+            for (std::size_t i=0; i<m_num_species; i++) {
+                output[k * m_num_species + i] = m_counts[i * num_voxels + k];
+            }
+        }
+        return output;
+    }
+
+    /**
+     * Returns the layout of the buffer
+     */
+    StoreLayout get_layout() const {
+        return m_layout;
+    }
+
+    /**
+     * Returns the number of voxels
+     */
+    std::size_t get_num_voxels() const {
+        return m_offsets.size() - 1;
+    }
+};
+
+}
+
+#endif // MOLECULE_STORE_HPP
@@ -0,0 +1,204 @@
+
+#ifndef NETWORK_HPP
+#define NETWORK_HPP
+
+// stl
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace StoSpa2 {
+
+/**
+ * Reactants struct - indices of the species of the reactants of a mass-action reaction known at compile time,
+ * repeated for multiple molecules of the same species, e.g. Reactants<0, 0, 1>
+ */
+template<unsigned... Indices>
+struct Reactants {};
+
+/**
+ * Stoichiometry struct - change in the number of molecules of each species known at compile time,
+ * e.g. Stoichiometry<1, -1>
+ */
+template<int... Changes>
+struct Stoichiometry {};
+
+template<typename R, typename S>
+struct MassAction;
+
+/**
+ * MassAction struct - mass-action reaction known at compile time. The propensity (without the rate) is the
+ * number of distinct combinations of reactant molecules divided by the voxel size raised to the order minus one,
+ * the same as for Reaction::mass_action.
+ */
+template<unsigned... Indices, int... Changes>
+struct MassAction<Reactants<Indices...>, Stoichiometry<Changes...>> {
+    /** Number of reactant molecules */
+    static constexpr unsigned order = sizeof...(Indices);
+
+    /** Number of species in the stoichiometry */
+    static constexpr unsigned num_species = sizeof...(Changes);
+
+    /**
+     * Returns the change in the number of molecules of each species
+     */
+    static constexpr std::array<int, num_species> stoichiometry() {
+        return {{Changes...}};
+    }
+
+    /**
+     * Returns whether all the reactants are among the given number of species
+     * @param n number of species
+     */
+    static constexpr bool valid_reactants(unsigned n) {
+        const unsigned reactants[] = {Indices..., 0};
+        for (unsigned p=0; p<order; p++) {
+            if (reactants[p] >= n) { return false; }
+        }
+        return true;
+    }
+
+    /**
+     * Returns the propensity (without the rate) given the number of molecules and voxel size
+     * @param num_molecules number of molecules of each species
+     * @param voxel_size length / area / volume of a voxel
+     */
+    template<typename Count, std::size_t N>
+    static double propensity(const std::array<Count, N>& num_molecules, const double& voxel_size) {
+        static_assert(N == num_species, "MassAction::propensity: wrong number of species");
+        static_assert(valid_reactants(N), "MassAction::propensity: reactant out of range");
+
+        // The arrays are known at compile time, so the loops below are unrolled by the compiler
+        const unsigned reactants[] = {Indices..., 0};
+        double propensity = 1.0;
+        for (unsigned p=0; p<order; p++) {
+            unsigned repeats = 0;
+            for (unsigned q=0; q<p; q++) {
+                repeats += (reactants[q] == reactants[p]) ? 1 : 0;
+            }
+            propensity *= (double) num_molecules[reactants[p]] - repeats;
+        }
+        if (order == 0) {
+            return voxel_size;
+        }
+        for (unsigned p=1; p<order; p++) {
+            propensity /= voxel_size;
+        }
+        return propensity;
+    }
+};
+
+template<unsigned... Indices, int... Changes>
+constexpr unsigned MassAction<Reactants<Indices...>, Stoichiometry<Changes...>>::order;
+
+template<unsigned... Indices, int... Changes>
+constexpr unsigned MassAction<Reactants<Indices...>, Stoichiometry<Changes...>>::num_species;
+
+/**
+ * BasicNetwork struct - reaction network with a fixed number of species and mass-action reactions known at compile
+ * time, where the number of molecules of each species is held in the given unsigned integer type (e.g. uint8_t for
+ * voxels with few molecules, uint64_t for huge populations). The number of molecules is held in a std::array and
+ * all the propensities and stoichiometry updates are evaluated without any allocation or indirect calls.
+ */
+template<typename Count, unsigned NumSpecies, typename... Reactions>
+struct BasicNetwork {
+    static_assert(std::is_integral<Count>::value and std::is_unsigned<Count>::value,
+                  "BasicNetwork: the count type needs to be an unsigned integer type");
+
+    /** Number of species */
+    static constexpr unsigned num_species = NumSpecies;
+
+    /** Number of reactions */
+    static constexpr unsigned num_reactions = sizeof...(Reactions);
+
+    /** Type of the number of molecules of a single species */
+    typedef Count CountType;
+
+    /** Number of molecules of each species */
+    typedef std::array<Count, NumSpecies> Molecules;
+
+    /** Propensity of each reaction */
+    typedef std::array<double, sizeof...(Reactions)> Propensities;
+
+    /**
+     * Evaluates the propensities (without the rates) of all the reactions
+     * @param num_molecules number of molecules of each species
+     * @param voxel_size length / area / volume of a voxel
+     * @param propensities output propensity of each reaction
+     */
+    static void propensities(const Molecules& num_molecules, const double& voxel_size, Propensities& propensities) {
+        propensities_impl(num_molecules, voxel_size, propensities, std::index_sequence_for<Reactions...>());
+    }
+
+    /**
+     * Applies the stoichiometry of the reaction with the given index, throws an exception (leaving the number of
+     * molecules unchanged) if a number of molecules would not fit into the count type or would become negative
+     * @param reaction_idx index of the reaction
+     * @param num_molecules number of molecules of each species, which are updated in place
+     */
+    static void apply(const unsigned& reaction_idx, Molecules& num_molecules) {
+        static const std::array<std::array<int, NumSpecies>, sizeof...(Reactions)> table = {{
+            Reactions::stoichiometry()...
+        }};
+        const auto& changes = table[reaction_idx];
+        for (unsigned i=0; i<NumSpecies; i++) {
+            check_change(i, num_molecules[i], changes[i], "BasicNetwork::apply");
+        }
+        for (unsigned i=0; i<NumSpecies; i++) {
+            num_molecules[i] = (Count) (num_molecules[i] + changes[i]);
+        }
+    }
+
+    /**
+     * Throws an exception if the number of molecules of a species would not fit into the count type after the
+     * given change or would become negative
+     * @param species index of the species
+     * @param count number of molecules of the species
+     * @param delta change in the number of molecules
+     * @param method name of the method that reports the error
+     */
+    static void check_change(const unsigned& species, const Count& count, const int& delta, const char* method) {
+        if (delta > 0 and (std::uint64_t) delta > (std::uint64_t) (std::numeric_limits<Count>::max() - count)) {
+            throw std::runtime_error(std::string(method) + ": number of molecules of species "
+                                     + std::to_string(species) + " would exceed the largest value of the "
+                                     + std::to_string(8 * sizeof(Count)) + "-bit count type");
+        }
+        if (delta < 0 and (std::uint64_t) count < (std::uint64_t) -(std::int64_t) delta) {
+            throw std::runtime_error(std::string(method) + ": number of molecules of species "
+                                     + std::to_string(species) + " would become negative");
+        }
+    }
+
+protected:
+    /**
+     * Evaluates the propensities of all the reactions, Is are the indices of the reactions
+     */
+    template<std::size_t... Is>
+    static void propensities_impl(const Molecules& num_molecules, const double& voxel_size,
+                                  Propensities& propensities, std::index_sequence<Is...>) {
+        // Expands to a single assignment for each reaction
+        int expand[] = {0, (propensities[Is] = Reactions::propensity(num_molecules, voxel_size), 0)...};
+        (void) expand;
+    }
+};
+
+template<typename Count, unsigned NumSpecies, typename... Reactions>
+constexpr unsigned BasicNetwork<Count, NumSpecies, Reactions...>::num_species;
+
+template<typename Count, unsigned NumSpecies, typename... Reactions>
+constexpr unsigned BasicNetwork<Count, NumSpecies, Reactions...>::num_reactions;
+
+/**
+ * Network - reaction network known at compile time with 32-bit numbers of molecules (see BasicNetwork),
+ * e.g. Network<2, MassAction<Reactants<0>, Stoichiometry<-1, 0>>, ...>
+ */
+template<unsigned NumSpecies, typename... Reactions>
+using Network = BasicNetwork<unsigned, NumSpecies, Reactions...>;
+
+}
+
+#endif // NETWORK_HPP
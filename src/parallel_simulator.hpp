@@ -0,0 +1,668 @@
+// The windows of optimistic execution with rollback follow the ideas of Jefferson DR (1985) Virtual time. ACM Trans
+// Program Lang Syst 7(3): 404-425. https://doi.org/10.1145/3916.3988 and of the waveform relaxation of
+// Lelarasmee E, Ruehli AE, Sangiovanni-Vincentelli AL (1982) The waveform relaxation method for time-domain analysis
+// of large scale integrated circuits. IEEE Trans CAD 1(3): 131-145. https://doi.org/10.1109/TCAD.1982.1270004
+
+#ifndef PARALLEL_SIMULATOR_HPP
+#define PARALLEL_SIMULATOR_HPP
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// other header files
+#include "event_queue.hpp"
+#include "growth.hpp"
+#include "random.hpp"
+#include "reaction.hpp"
+#include "simulator.hpp"
+#include "voxel.hpp"
+
+namespace StoSpa2 {
+
+/**
+ * ThreadBarrier class - blocks threads until all of them have arrived, and combines a value and flags that each
+ * of them passes, so that all the threads take the same decision after the barrier
+ */
+class ThreadBarrier {
+protected:
+    /** Mutex that guards the members */
+    std::mutex m_mutex;
+
+    /** Condition on which the threads wait for the last one to arrive */
+    std::condition_variable m_condition;
+
+    /** Number of threads */
+    unsigned m_num_threads;
+
+    /** Number of threads that have arrived */
+    unsigned m_num_arrived = 0;
+
+    /** Number of times that all the threads have arrived */
+    unsigned long m_generation = 0;
+
+    /** Smallest value and union of the flags passed by the threads that have arrived */
+    double m_min = std::numeric_limits<double>::infinity();
+    unsigned m_flags = 0;
+
+    /** Smallest value and union of the flags of the last time that all the threads have arrived */
+    std::pair<double, unsigned> m_result;
+
+public:
+
+    /**
+     * Constructor for the ThreadBarrier class
+     * @param num_threads number of threads
+     */
+    explicit ThreadBarrier(unsigned num_threads) : m_num_threads(num_threads) {}
+
+    /**
+     * Waits until all the threads have arrived
+     * @param value value to be combined with the values of the other threads
+     * @param flags flags to be combined with the flags of the other threads
+     * @return smallest value and union of the flags passed by all the threads
+     */
+    std::pair<double, unsigned> wait(const double& value, const unsigned& flags) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_min = std::min(m_min, value);
+        m_flags |= flags;
+        if (++m_num_arrived == m_num_threads) {
+            m_result = {m_min, m_flags};
+            m_min = std::numeric_limits<double>::infinity();
+            m_flags = 0;
+            m_num_arrived = 0;
+            m_generation++;
+            m_condition.notify_all();
+        }
+        else {
+            auto generation = m_generation;
+            m_condition.wait(lock, [this, &generation]() { return m_generation != generation; });
+        }
+        return m_result;
+    }
+};
+
+/**
+ * ParallelSimulator class - runs a single simulation of the next subvolume method on many threads. The voxels are
+ * partitioned into subdomains of contiguous indices (i.e. slabs of a domain whose voxels are numbered row by row),
+ * each simulated by one thread with its own event queue and Philox random streams. Diffusion events that cross
+ * the boundary of a subdomain are passed as messages through mailboxes that each have a single writer and are
+ * read only after all the threads have synchronised, so no locks are needed.
+ *
+ * Since exponential waiting times give no lookahead, the threads execute windows of time optimistically: each
+ * subdomain first simulates a window with the messages that it knows of, and then, whenever the messages sent to
+ * it by the other subdomains differ, it rolls back the voxels that it has changed to the start of the window and
+ * simulates it again. The messages before the first difference are correct after each round, so the rounds
+ * converge to the events of the serial simulation. Every voxel draws from its own Philox stream, so the events,
+ * and hence the number of molecules, are exactly those of a Simulator with the same seed and the Philox streams,
+ * whatever the number of threads, the length of the windows or the order in which the threads run.
+ */
+class ParallelSimulator : public Simulator {
+protected:
+    /** Diffusion event that moves molecules into a voxel of another subdomain */
+    struct Message {
+        /** Time of the event */
+        double time;
+
+        /** Index of the voxel where the event happened */
+        unsigned source;
+
+        /** Index of the voxel that the molecules move into */
+        unsigned target;
+
+        /** Changes in the number of molecules of the source voxel (the target changes by their negative) */
+        const std::vector<StoSpa2::SpeciesChange>* changes;
+
+        /**
+         * Messages are executed in the order in which the serial simulation would execute their events
+         */
+        friend bool operator < (const Message& m1, const Message& m2) {
+            return m1.time != m2.time ? m1.time < m2.time : m1.source < m2.source;
+        }
+
+        friend bool operator == (const Message& m1, const Message& m2) {
+            return m1.time == m2.time and m1.source == m2.source and m1.target == m2.target
+                   and m1.changes == m2.changes;
+        }
+
+        friend bool operator != (const Message& m1, const Message& m2) {
+            return !(m1 == m2);
+        }
+    };
+
+    /** Voxels simulated by one thread together with the state that the thread needs */
+    struct Subdomain {
+        /** Index of the first voxel */
+        unsigned first;
+
+        /** Index past the last voxel */
+        unsigned last;
+
+        /** Growth laws of the voxels, which are evaluated by this thread only */
+        std::shared_ptr<StoSpa2::GrowthClock> growth_clock;
+
+        /** Times of the next events of the voxels, indexed from the first voxel */
+        StoSpa2::EventQueue queue;
+
+        /** Philox streams of the voxels */
+        StoSpa2::RandomStreams rng;
+
+        /** Uniform distribution */
+        std::uniform_real_distribution<double> uniform;
+
+        /** Messages from the other subdomains with which the current window has been simulated */
+        std::vector<Message> inbox;
+
+        /** Messages from the other subdomains gathered after the last round */
+        std::vector<Message> pending;
+
+        /** Messages to each other subdomain sent in the current window */
+        std::vector<std::vector<Message>> outboxes;
+
+        /** Position of each voxel in the journal plus one, zero if it has not changed in the current window */
+        std::vector<unsigned> slots;
+
+        /** Voxels that have changed in the current window, indexed from the first voxel */
+        std::vector<unsigned> touched;
+
+        /** State, time of the next event and counter of the random stream of each changed voxel at the start
+         * of the window (the memory is reused from window to window) */
+        std::vector<StoSpa2::Voxel::State> states;
+        std::vector<double> times;
+        std::vector<std::uint64_t> counters;
+
+        /** Number of times that the subdomain has been rolled back */
+        unsigned long num_rollbacks = 0;
+    };
+
+    /** Number of threads, i.e. of subdomains unless there are fewer voxels */
+    unsigned m_num_threads;
+
+    /** Length of the windows of time, which is adapted to the number of rounds that they need */
+    double m_window = 0;
+
+    /** Average number of events in a subdomain during the first window */
+    double m_events_per_window = 100.0;
+
+    /** Index of the first voxel of each subdomain, followed by the number of voxels */
+    std::vector<unsigned> m_bounds;
+
+    /** Subdomains */
+    std::vector<Subdomain> m_subdomains;
+
+    /** Number of windows simulated */
+    unsigned long m_num_windows = 0;
+
+    /** Number of rounds simulated, i.e. simulations of windows with the messages known so far */
+    unsigned long m_num_rounds = 0;
+
+    /**
+     * Partitions the voxels into subdomains, one for each thread, and gives each subdomain its own growth clock
+     */
+    void partition() {
+        unsigned num_voxels = m_voxels.size();
+        unsigned num_subdomains = std::min(m_num_threads, num_voxels);
+        m_bounds.clear();
+        m_subdomains.clear();
+        m_subdomains.resize(num_subdomains);
+        for (unsigned s=0; s<num_subdomains; s++) {
+            auto& sub = m_subdomains[s];
+            sub.first = (std::uint64_t) s * num_voxels / num_subdomains;
+            sub.last = (std::uint64_t) (s + 1) * num_voxels / num_subdomains;
+            sub.growth_clock = std::make_shared<StoSpa2::GrowthClock>();
+            for (unsigned k=sub.first; k<sub.last; k++) {
+                m_voxels[k].bind_growth(sub.growth_clock);
+            }
+            sub.queue = StoSpa2::EventQueue(next_reaction_times.get_type());
+            sub.uniform = m_uniform;
+            sub.outboxes.resize(num_subdomains);
+            sub.slots.assign(sub.last - sub.first, 0);
+            m_bounds.push_back(sub.first);
+        }
+        m_bounds.push_back(num_voxels);
+    }
+
+    /**
+     * Returns the index of the subdomain that contains the voxel with the given index
+     * @param index index of the voxel
+     */
+    unsigned owner(const unsigned& index) {
+        return std::upper_bound(m_bounds.begin(), m_bounds.end(), index) - m_bounds.begin() - 1;
+    }
+
+    /**
+     * Returns a random number from the uniform distribution on [0, 1) drawn from the stream of a voxel
+     * @param sub the subdomain that contains the voxel
+     * @param index index of the voxel
+     */
+    double uniform(Subdomain& sub, const unsigned& index) {
+        auto stream = sub.rng.stream(index);
+        return sub.uniform(stream);
+    }
+
+    /**
+     * Returns a random number from the exponential distribution drawn from the stream of a voxel
+     * @param sub the subdomain that contains the voxel
+     * @param propensity the total propensity
+     * @param index index of the voxel
+     */
+    double exponential(Subdomain& sub, const double& propensity, const unsigned& index) {
+        return (-1.0/propensity) * log(uniform(sub, index));
+    }
+
+    /**
+     * Returns a new time of the next event in a voxel, in the same way as Simulator::next_event_time
+     * @param sub the subdomain that contains the voxel
+     * @param index index of the voxel
+     * @param time current time of the voxel
+     */
+    double next_event_time(Subdomain& sub, const unsigned& index, const double& time) {
+        auto& vox = m_voxels[index];
+        double new_time = vox.get_integrated_hazard() ? vox.integrated_event_time(-log(uniform(sub, index)))
+                                                      : time + exponential(sub, vox.get_total_propensity(), index);
+        return std::min(new_time, vox.get_bound_end());
+    }
+
+    /**
+     * Saves the state of a voxel the first time it changes in the current window
+     * @param sub the subdomain that contains the voxel
+     * @param index index of the voxel
+     */
+    void save(Subdomain& sub, const unsigned& index) {
+        unsigned k = index - sub.first;
+        if (sub.slots[k] != 0) { return; }
+
+        unsigned slot = sub.touched.size();
+        if (slot == sub.states.size()) {
+            sub.states.emplace_back();
+            sub.times.push_back(0);
+            sub.counters.push_back(0);
+        }
+        m_voxels[index].save_state(sub.states[slot]);
+        sub.times[slot] = sub.queue.get_time(k);
+        sub.counters[slot] = sub.rng.get_counter(index);
+        sub.touched.push_back(k);
+        sub.slots[k] = slot + 1;
+    }
+
+    /**
+     * Forgets the saved states of the voxels, which starts a new window
+     * @param sub the subdomain
+     */
+    void commit(Subdomain& sub) {
+        for (const auto& k : sub.touched) {
+            sub.slots[k] = 0;
+        }
+        sub.touched.clear();
+    }
+
+    /**
+     * Returns the voxels that have changed in the current window to their state at its start
+     * @param sub the subdomain
+     */
+    void rollback(Subdomain& sub) {
+        for (unsigned slot=0; slot<sub.touched.size(); slot++) {
+            unsigned k = sub.touched[slot];
+            m_voxels[sub.first + k].restore_state(sub.states[slot]);
+            sub.queue.update(k, sub.times[slot]);
+            sub.rng.set_counter(sub.first + k, sub.counters[slot]);
+        }
+        commit(sub);
+        sub.num_rollbacks++;
+    }
+
+    /**
+     * Moves the molecules of a diffusion event into the target voxel, in the same way as Simulator::step
+     * @param sub the subdomain that contains the target voxel
+     * @param m the diffusion event
+     */
+    void receive(Subdomain& sub, const Message& m) {
+        save(sub, m.target);
+        m_voxels[m.target].update_properties(m.time);
+        m_voxels[m.target].subtract_changes(*m.changes);
+        sub.queue.update(m.target - sub.first, next_event_time(sub, m.target, m.time));
+    }
+
+    /**
+     * Executes the next event of a voxel, in the same way as Simulator::step
+     * @param sub the subdomain that contains the voxel
+     * @param index index of the voxel
+     * @param time time of the event
+     */
+    void fire(Subdomain& sub, const unsigned& index, const double& time) {
+        auto& vox = m_voxels[index];
+        save(sub, index);
+        vox.update_properties(time);
+
+        // At the end of the look-ahead window or at a change of a scheduled rate only a new time is needed
+        if (time >= vox.get_bound_end()) {
+            sub.queue.update(index - sub.first, next_event_time(sub, index, time));
+            return;
+        }
+
+        auto draw = [this, &sub, index]() { return uniform(sub, index); };
+        auto& r = vox.pick_reaction(uniform(sub, index), draw);
+        vox.add_changes(r.changes);
+        sub.queue.update(index - sub.first, next_event_time(sub, index, time));
+
+        if (r.diffusion_idx >= 0) {
+            Message m = {time, index, (unsigned) r.diffusion_idx, &r.changes};
+            if (m.target >= sub.first and m.target < sub.last) {
+                receive(sub, m);
+            }
+            else {
+                sub.outboxes[owner(m.target)].push_back(m);
+            }
+        }
+    }
+
+    /**
+     * Executes the events of a subdomain and the messages in its inbox in the order of their times, until the
+     * end of the window
+     * @param sub the subdomain
+     * @param window_end time at which the window ends
+     */
+    void execute(Subdomain& sub, const double& window_end) {
+        for (auto& outbox : sub.outboxes) {
+            outbox.clear();
+        }
+
+        unsigned next_message = 0;
+        while (true) {
+            double time = sub.queue.top_time();
+            unsigned index = sub.queue.empty() ? sub.last : sub.first + sub.queue.top_index();
+            if (next_message < sub.inbox.size() and (sub.inbox[next_message] < Message{time, index, 0, nullptr})) {
+                receive(sub, sub.inbox[next_message++]);
+            }
+            else if (time < window_end) {
+                fire(sub, index, time);
+            }
+            else {
+                break;
+            }
+        }
+    }
+
+    /**
+     * Gathers the messages sent to a subdomain by the other subdomains in the current window
+     * @param s index of the subdomain
+     * @return whether they differ from the messages with which the window has been simulated
+     */
+    bool gather(const unsigned& s) {
+        auto& pending = m_subdomains[s].pending;
+        pending.clear();
+        for (auto& sub : m_subdomains) {
+            pending.insert(pending.end(), sub.outboxes[s].begin(), sub.outboxes[s].end());
+        }
+        std::sort(pending.begin(), pending.end());
+        return pending != m_subdomains[s].inbox;
+    }
+
+    /**
+     * Simulates a subdomain until the given time in windows, in step with the threads of the other subdomains
+     * @param s index of the subdomain
+     * @param time_point the point in time that is reached
+     * @param barrier barrier shared by the threads of all the subdomains
+     * @param window length of the first window, which is then adapted
+     * @return length of the window after the last one
+     */
+    double simulate(const unsigned& s, const double& time_point, ThreadBarrier& barrier, double window) {
+        // Flags that the threads pass to the barrier
+        const unsigned redo = 1, failure = 2;
+
+        auto& sub = m_subdomains[s];
+        std::exception_ptr error;
+        auto run = [&error](auto&& f) {
+            if (error) { return; }
+            try {
+                f();
+            }
+            catch (...) {
+                error = std::current_exception();
+            }
+        };
+
+        while (true) {
+            // Each window starts at the earliest next event in the whole domain, so that none is empty
+            auto start = barrier.wait(sub.queue.top_time(), error ? failure : 0);
+            if ((start.second & failure) or start.first >= time_point) { break; }
+            double window_end = std::min(start.first + window, time_point);
+            if (!(window_end > start.first)) { window_end = std::nextafter(start.first, inf); }
+
+            run([&]() {
+                commit(sub);
+                sub.inbox.clear();
+                execute(sub, window_end);
+            });
+
+            // Rounds until no subdomain receives different messages, all the threads take the same decisions
+            unsigned num_rounds = 1;
+            while (true) {
+                // The outboxes are read once all the threads have written them
+                barrier.wait(0, 0);
+                bool changed = false;
+                run([&]() { changed = gather(s); });
+                auto round = barrier.wait(0, (changed ? redo : 0) | (error ? failure : 0));
+                if (!(round.second & redo) or (round.second & failure)) { break; }
+
+                if (changed) {
+                    run([&]() {
+                        rollback(sub);
+                        sub.inbox.swap(sub.pending);
+                        execute(sub, window_end);
+                    });
+                }
+                num_rounds++;
+            }
+
+            if (s == 0) {
+                m_num_windows++;
+                m_num_rounds += num_rounds;
+            }
+
+            // Windows that converge at once grow, and windows that need many rounds shrink
+            if (num_rounds <= 2) { window *= 1.5; }
+            else if (num_rounds > 3) { window *= 0.5; }
+        }
+
+        commit(sub);
+        if (error) { std::rethrow_exception(error); }
+        return window;
+    }
+
+public:
+
+    /**
+     * Constructor for the ParallelSimulator class, which uses the Philox random streams (see
+     * Simulator::set_rng_type)
+     * @param voxels vector of Voxel class instances
+     * @param time initial time
+     * @param num_threads number of threads, zero uses the number of hardware threads
+     * @param queue_type data structure used to hold the times of the next reactions
+     * @param layout layout of the domain-wide molecule store
+     */
+    explicit ParallelSimulator(std::vector<StoSpa2::Voxel> voxels, double time=0, unsigned num_threads=0,
+                               QueueType queue_type=QueueType::binary_heap,
+                               StoreLayout layout=StoreLayout::voxel_major) :
+        Simulator(std::move(voxels), time, queue_type, layout) {
+        set_rng_type(RngType::philox);
+        set_num_threads(num_threads);
+    }
+
+    /**
+     * Copy constructor for the ParallelSimulator class, the voxels of the copy use its own growth clocks
+     * @param s the simulator to be copied
+     */
+    ParallelSimulator(const ParallelSimulator& s) :
+        Simulator(s), m_num_threads(s.m_num_threads), m_window(s.m_window),
+        m_events_per_window(s.m_events_per_window), m_num_windows(s.m_num_windows), m_num_rounds(s.m_num_rounds) {
+        partition();
+    }
+
+    /**
+     * Returns a copy of the simulator
+     */
+    std::unique_ptr<Simulator> clone() const override {
+        return std::make_unique<ParallelSimulator>(*this);
+    }
+
+    /**
+     * Sets the number of threads and partitions the voxels into a subdomain for each of them
+     * @param num_threads number of threads, zero uses the number of hardware threads
+     */
+    void set_num_threads(unsigned num_threads) {
+        m_num_threads = num_threads > 0 ? num_threads : std::max(std::thread::hardware_concurrency(), 1u);
+        partition();
+    }
+
+    /**
+     * Returns the number of threads
+     */
+    unsigned get_num_threads() {
+        return m_num_threads;
+    }
+
+    /**
+     * Returns the number of subdomains, i.e. the number of threads unless there are fewer voxels
+     */
+    unsigned get_num_subdomains() {
+        return m_subdomains.size();
+    }
+
+    /**
+     * Sets the length of the next window of time, which is then adapted to the number of rounds that the windows
+     * need. Zero chooses it from the total propensity, such that each subdomain has a number of events on average.
+     * The length of the windows does not change the results, only how fast they are computed.
+     * @param window length of the next window
+     * @param events_per_window average number of events in a subdomain used to choose the length
+     */
+    void set_window(double window, double events_per_window=100.0) {
+        if (window < 0 or events_per_window <= 0) {
+            std::string m = "ParallelSimulator::set_window: window needs to be greater than or equal to 0.0 and ";
+            m += "events_per_window greater than 0.0";
+            throw std::runtime_error(m);
+        }
+        m_window = window;
+        m_events_per_window = events_per_window;
+    }
+
+    /**
+     * Returns the length of the next window of time (zero if it has not been chosen yet)
+     */
+    double get_window() {
+        return m_window;
+    }
+
+    /**
+     * Returns the number of windows of time simulated
+     */
+    unsigned long get_num_windows() {
+        return m_num_windows;
+    }
+
+    /**
+     * Returns the number of rounds simulated, i.e. simulations of a window with the messages known so far, which
+     * is at least the number of windows
+     */
+    unsigned long get_num_rounds() {
+        return m_num_rounds;
+    }
+
+    /**
+     * Returns the number of times that each subdomain has been rolled back to the start of a window
+     */
+    std::vector<unsigned long> get_num_rollbacks() {
+        std::vector<unsigned long> output;
+        for (auto& sub : m_subdomains) {
+            output.push_back(sub.num_rollbacks);
+        }
+        return output;
+    }
+
+    /**
+     * Executes all the events before the given point in time on the threads of the subdomains, and sets the time
+     * to it. If an event throws an exception, then the exception is rethrown once all the threads have stopped,
+     * and the simulation is left part of the way through a window.
+     * @param time_point the point in time in simulation that is reached
+     */
+    void advance(double time_point) override {
+        if (m_time >= time_point) { return; }
+        if (m_rng.get_type() != RngType::philox) {
+            std::string m = "ParallelSimulator::advance: the Philox random streams are needed, since the random ";
+            m += "numbers of each voxel need to be independent of the order in which the voxels draw them";
+            throw std::runtime_error(m);
+        }
+
+        // The first window has the given number of events on average
+        if (m_window == 0) {
+            double total = 0;
+            for (auto& vox : m_voxels) {
+                total += vox.get_total_propensity(false);
+            }
+            m_window = total > 0 ? m_events_per_window * m_subdomains.size() / total : inf;
+        }
+
+        // Each subdomain takes its part of the event queue and of the random streams
+        for (auto& sub : m_subdomains) {
+            std::vector<double> times(sub.last - sub.first);
+            for (unsigned k=sub.first; k<sub.last; k++) {
+                times[k - sub.first] = next_reaction_times.get_time(k);
+            }
+            sub.queue.reset(std::move(times));
+            sub.rng = m_rng.slice(sub.first, sub.last - sub.first);
+        }
+
+        // The calling thread simulates the first subdomain
+        ThreadBarrier barrier(m_subdomains.size());
+        std::vector<std::exception_ptr> errors(m_subdomains.size());
+        std::vector<std::thread> threads;
+        double window = m_window;
+        auto worker = [this, &time_point, &barrier, &errors, &window](const unsigned& s) {
+            try {
+                double next_window = simulate(s, time_point, barrier, window);
+                if (s == 0) { m_window = next_window; }
+            }
+            catch (...) {
+                errors[s] = std::current_exception();
+            }
+        };
+        for (unsigned s=1; s<m_subdomains.size(); s++) {
+            threads.emplace_back(worker, s);
+        }
+        if (!m_subdomains.empty()) { worker(0); }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        // The event queue and the random streams are put back together
+        std::vector<double> times(m_voxels.size());
+        for (auto& sub : m_subdomains) {
+            for (unsigned k=sub.first; k<sub.last; k++) {
+                times[k] = sub.queue.get_time(k - sub.first);
+            }
+            m_rng.merge(sub.rng);
+        }
+        next_reaction_times.reset(std::move(times));
+
+        for (auto& error : errors) {
+            if (error) { std::rethrow_exception(error); }
+        }
+        m_time = time_point;
+    }
+};
+
+}
+
+#endif // PARALLEL_SIMULATOR_HPP
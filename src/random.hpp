@@ -0,0 +1,255 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+// stl
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace StoSpa2 {
+
+/**
+ * Generators of random numbers: a single Mersenne twister shared by all the voxels, or a counter-based Philox
+ * stream for each voxel keyed by the seed and the index of the replica, whose state is a single counter
+ */
+enum class RngType { mt19937, philox };
+
+/**
+ * Mixes a seed and the index of a replica into a new seed (splitmix64)
+ * @param seed the seed
+ * @param replica index of the replica
+ */
+inline unsigned mix_seed(unsigned seed, unsigned replica) {
+    std::uint64_t z = ((std::uint64_t) seed << 32 | replica) + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return (unsigned) (z ^ (z >> 31));
+}
+
+/**
+ * Returns the block of four random numbers of the Philox4x32-10 generator (Salmon JK, Moraes MA, Dror RO,
+ * Shaw DE (2011) Parallel random numbers: as easy as 1, 2, 3. SC '11) for the given counter and key
+ * @param counter the counter
+ * @param key the key
+ */
+inline std::array<std::uint32_t, 4> philox4x32(std::array<std::uint32_t, 4> counter,
+                                               std::array<std::uint32_t, 2> key) {
+    for (unsigned round=0; round<10; round++) {
+        if (round > 0) {
+            key[0] += 0x9e3779b9u;
+            key[1] += 0xbb67ae85u;
+        }
+        std::uint64_t p0 = (std::uint64_t) 0xd2511f53u * counter[0];
+        std::uint64_t p1 = (std::uint64_t) 0xcd9e8d57u * counter[2];
+        counter = {{(std::uint32_t) (p1 >> 32) ^ counter[1] ^ key[0], (std::uint32_t) p1,
+                    (std::uint32_t) (p0 >> 32) ^ counter[3] ^ key[1], (std::uint32_t) p0}};
+    }
+    return counter;
+}
+
+/**
+ * RandomStreams class - the random numbers of the voxels of a simulation. With the Mersenne twister all the
+ * voxels draw from one sequence, so the numbers depend on the order of the draws. With Philox the numbers of
+ * each voxel are a separate stream keyed by (seed, replica, voxel), so they do not depend on the order in which
+ * voxels draw them (e.g. on the number of threads), and the state of each stream is the number of values drawn.
+ */
+class RandomStreams {
+protected:
+    /** Type of the generator */
+    RngType m_type = RngType::mt19937;
+
+    /** Mersenne twister shared by all the voxels (none for the Philox streams, so that copies are cheap) */
+    std::vector<std::mt19937> m_mt;
+
+    /** Key of the Philox streams, i.e. the seed and the index of the replica */
+    std::array<std::uint32_t, 2> m_key = {{0, 0}};
+
+    /** Number of values drawn from the Philox stream of each voxel */
+    std::vector<std::uint64_t> m_counters;
+
+    /** Index of the voxel of the first stream, which is not zero for a slice of the streams (see slice) */
+    std::uint32_t m_first = 0;
+
+    /** Stream and index of the last block of four values computed, which the next draws usually reuse */
+    std::uint32_t m_block_stream = 0;
+    std::uint64_t m_block_index = ~0ULL;
+
+    /** Last block of four values computed */
+    std::array<std::uint32_t, 4> m_block = {{0, 0, 0, 0}};
+
+public:
+
+    /**
+     * Stream class - a uniform random bit generator that draws from the stream of a single voxel
+     */
+    class Stream {
+    protected:
+        /** The random streams of the simulation */
+        RandomStreams* m_streams;
+
+        /** Index of the voxel */
+        unsigned m_index;
+
+    public:
+        /** Type of the generated values */
+        typedef std::uint32_t result_type;
+
+        /**
+         * Constructor for the Stream class
+         * @param streams the random streams of the simulation
+         * @param index index of the voxel
+         */
+        Stream(RandomStreams& streams, unsigned index) : m_streams(&streams), m_index(index) {}
+
+        /** Smallest generated value */
+        static constexpr result_type min() { return 0; }
+
+        /** Largest generated value */
+        static constexpr result_type max() { return 0xffffffffu; }
+
+        /**
+         * Returns the next value of the stream
+         */
+        result_type operator () () {
+            return m_streams->next(m_index);
+        }
+    };
+
+    /**
+     * Seeds the streams
+     * @param type type of the generator
+     * @param seed the seed
+     * @param replica index of the replica, which the seed of the Mersenne twister is mixed with unless it is zero
+     * @param num_streams number of voxels
+     */
+    void seed(RngType type, unsigned seed, unsigned replica, std::size_t num_streams) {
+        m_type = type;
+        if (type == RngType::mt19937) {
+            m_mt.assign(1, std::mt19937(replica == 0 ? seed : mix_seed(seed, replica)));
+            m_counters.clear();
+        }
+        else {
+            m_mt.clear();
+            m_key = {{seed, replica}};
+            m_counters.assign(num_streams, 0);
+        }
+        m_first = 0;
+        m_block_index = ~0ULL;
+    }
+
+    /**
+     * Returns the next value of the stream of the given voxel
+     * @param index index of the voxel
+     */
+    std::uint32_t next(const unsigned& index) {
+        if (m_type == RngType::mt19937) {
+            return m_mt[0]();
+        }
+        std::uint64_t count = m_counters[index - m_first]++;
+        if (index != m_block_stream or count >> 2 != m_block_index) {
+            m_block_stream = index;
+            m_block_index = count >> 2;
+            m_block = philox4x32({{(std::uint32_t) m_block_index, (std::uint32_t) (m_block_index >> 32), index, 0}},
+                                 m_key);
+        }
+        return m_block[count & 3];
+    }
+
+    /**
+     * Returns the stream of the given voxel
+     * @param index index of the voxel
+     */
+    Stream stream(const unsigned& index) {
+        return Stream(*this, index);
+    }
+
+    /**
+     * Returns the type of the generator
+     */
+    RngType get_type() const {
+        return m_type;
+    }
+
+    /**
+     * Returns the number of values drawn from the stream of each voxel, which together with the seed and the
+     * index of the replica is the whole state of the Philox streams
+     */
+    const std::vector<std::uint64_t>& get_counters() const {
+        if (m_type != RngType::philox) {
+            throw std::runtime_error("RandomStreams::get_counters: only the Philox streams have counters");
+        }
+        return m_counters;
+    }
+
+    /**
+     * Restores the state of the Philox streams saved by get_counters
+     * @param counters number of values drawn from the stream of each voxel
+     */
+    void set_counters(std::vector<std::uint64_t> counters) {
+        if (m_type != RngType::philox or counters.size() != m_counters.size()) {
+            std::string m = "RandomStreams::set_counters: one counter for each stream of the Philox streams is needed";
+            throw std::runtime_error(m);
+        }
+        m_counters = std::move(counters);
+        m_block_index = ~0ULL;
+    }
+
+    /**
+     * Returns the number of values drawn from the Philox stream of the given voxel
+     * @param index index of the voxel
+     */
+    std::uint64_t get_counter(const unsigned& index) const {
+        return m_counters[index - m_first];
+    }
+
+    /**
+     * Sets the number of values drawn from the Philox stream of the given voxel, e.g. to draw its last values
+     * again. The block of values computed last stays valid, since it only depends on the stream and its index.
+     * @param index index of the voxel
+     * @param counter number of values drawn
+     */
+    void set_counter(const unsigned& index, const std::uint64_t& counter) {
+        m_counters[index - m_first] = counter;
+    }
+
+    /**
+     * Returns the Philox streams of a contiguous range of voxels, which draw the same values for these voxels as
+     * these streams would but independently of them, e.g. in a thread that simulates only these voxels
+     * @param first index of the first voxel
+     * @param count number of voxels
+     */
+    RandomStreams slice(const unsigned& first, const unsigned& count) const {
+        if (m_type != RngType::philox or first < m_first or first + count > m_first + m_counters.size()) {
+            throw std::runtime_error("RandomStreams::slice: the range of voxels is not within the Philox streams");
+        }
+        RandomStreams output;
+        output.m_type = m_type;
+        output.m_key = m_key;
+        output.m_first = first;
+        auto begin = m_counters.begin() + (first - m_first);
+        output.m_counters.assign(begin, begin + count);
+        return output;
+    }
+
+    /**
+     * Copies the counters of a slice of these streams (see slice) back into them
+     * @param s the slice
+     */
+    void merge(const RandomStreams& s) {
+        if (m_type != RngType::philox or s.m_type != m_type or s.m_key != m_key or s.m_first < m_first
+            or s.m_first + s.m_counters.size() > m_first + m_counters.size()) {
+            throw std::runtime_error("RandomStreams::merge: the slice is not part of the Philox streams");
+        }
+        std::copy(s.m_counters.begin(), s.m_counters.end(), m_counters.begin() + (s.m_first - m_first));
+    }
+};
+
+}
+
+#endif // RANDOM_HPP
@@ -0,0 +1,299 @@
+
+#ifndef STATIC_SIMULATOR_HPP
+#define STATIC_SIMULATOR_HPP
+
+// stl
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// other header files
+#include "event_queue.hpp"
+#include "network.hpp"
+
+namespace StoSpa2 {
+
+/**
+ * StaticSimulator class - next subvolume method for a reaction network known at compile time (see Network).
+ * All the voxels have the same size and the same reactions, and molecules of each species jump to the
+ * neighbouring voxels with a given rate. The number of molecules in each voxel is held in a std::array of the
+ * count type of the network (see BasicNetwork), so stepping in time does not allocate and all the propensities
+ * are evaluated inline. A reaction or jump that would overflow the count type throws an exception.
+ */
+template<typename N>
+class StaticSimulator {
+public:
+    /** Type of the number of molecules of a single species */
+    typedef typename N::CountType CountType;
+
+    /** Number of molecules of each species */
+    typedef typename N::Molecules Molecules;
+
+protected:
+    /** State of a single voxel */
+    struct VoxelState {
+        /** Number of molecules of each species */
+        Molecules molecules;
+
+        /** Propensity of each reaction including its rate */
+        typename N::Propensities propensities;
+
+        /** Sum of all the propensities including diffusion */
+        double total_propensity;
+    };
+
+    /** Current time in a simulation */
+    double m_time;
+
+    /** Size (length / area / volume) of every voxel */
+    double m_voxel_size;
+
+    /** Rate of each reaction */
+    std::array<double, N::num_reactions> m_rates;
+
+    /** Rate at which a molecule of each species jumps to a single neighbouring voxel */
+    std::array<double, N::num_species> m_diffusion_rates;
+
+    /** State of each voxel */
+    std::vector<VoxelState> m_voxels;
+
+    /** Indices of the neighbouring voxels of each voxel */
+    std::vector<std::vector<unsigned>> m_neighbours;
+
+    /** Priority queue of times of the next reaction for each voxel */
+    StoSpa2::EventQueue next_reaction_times;
+
+    /** Seed used for generating a random number. */
+    unsigned m_seed;
+
+    /** For generating random numbers */
+    std::mt19937 m_gen;
+
+    /** Uniform distribution. */
+    std::uniform_real_distribution<double> m_uniform;
+
+    /**
+     * Function that returns a random number from the exponential distribution.
+     * @param propensity the total propensity
+     * @return a random number from exponential distribution
+     */
+    double exponential(const double& propensity) {
+        return (-1.0/propensity) * log(m_uniform(m_gen));
+    }
+
+    /**
+     * Re-evaluates all the propensities of the voxel with the given index
+     * @param index index of the voxel
+     */
+    void update_propensities(const unsigned& index) {
+        VoxelState& vox = m_voxels[index];
+        N::propensities(vox.molecules, m_voxel_size, vox.propensities);
+
+        double total = 0;
+        for (unsigned j=0; j<N::num_reactions; j++) {
+            vox.propensities[j] *= m_rates[j];
+            total += vox.propensities[j];
+        }
+        double num_neighbours = m_neighbours[index].size();
+        for (unsigned i=0; i<N::num_species; i++) {
+            total += m_diffusion_rates[i] * vox.molecules[i] * num_neighbours;
+        }
+        vox.total_propensity = total;
+    }
+
+    /**
+     * Initialiases all the times until next reactions in all the voxels
+     */
+    void initialise_next_reaction_times() {
+        std::vector<double> times(m_voxels.size());
+        for (unsigned k=0; k<m_voxels.size(); k++) {
+            times[k] = m_time + exponential(m_voxels[k].total_propensity);
+        }
+        next_reaction_times.reset(std::move(times));
+    }
+
+    /**
+     * Updates the time until the next reaction for a voxel with the given index
+     * @param index the index of the voxel where time until the next reaction is to be updated
+     */
+    void update_next_reaction_time(const unsigned& index) {
+        next_reaction_times.update(index, m_time + exponential(m_voxels[index].total_propensity));
+    }
+
+public:
+
+    /**
+     * Constructor for the StaticSimulator class
+     * @param molecules number of molecules of each species in each voxel
+     * @param voxel_size size (length / area / volume) of every voxel
+     * @param rates rate of each reaction
+     * @param diffusion_rates rate at which a molecule of each species jumps to a single neighbouring voxel
+     * @param neighbours indices of the neighbouring voxels of each voxel (a line of voxels if empty)
+     * @param time initial time
+     * @param queue_type data structure used to hold the times of the next reactions
+     */
+    StaticSimulator(const std::vector<Molecules>& molecules, double voxel_size,
+                    std::array<double, N::num_reactions> rates, std::array<double, N::num_species> diffusion_rates,
+                    std::vector<std::vector<unsigned>> neighbours={}, double time=0,
+                    QueueType queue_type=QueueType::binary_heap) : next_reaction_times(queue_type) {
+        if (voxel_size <= 0) {
+            throw std::runtime_error("StaticSimulator::StaticSimulator: voxel_size needs to be greater than 0.0");
+        }
+
+        // For generating random numbers from the uniform dist
+        std::random_device rd;
+        m_seed = rd();
+        m_gen = std::mt19937(m_seed);
+        m_uniform = std::uniform_real_distribution<double>(0.0, 1.0);
+
+        m_time = time;
+        m_voxel_size = voxel_size;
+        m_rates = rates;
+        m_diffusion_rates = diffusion_rates;
+
+        // By default molecules jump between consecutive voxels of a line
+        if (neighbours.empty()) {
+            neighbours.resize(molecules.size());
+            for (unsigned k=0; k+1<molecules.size(); k++) {
+                neighbours[k].push_back(k+1);
+                neighbours[k+1].push_back(k);
+            }
+        }
+        if (neighbours.size() != molecules.size()) {
+            throw std::runtime_error("StaticSimulator::StaticSimulator: neighbours need to be given for each voxel");
+        }
+        for (const auto& voxel_neighbours : neighbours) {
+            for (const auto& idx : voxel_neighbours) {
+                if (idx >= molecules.size()) {
+                    throw std::runtime_error("StaticSimulator::StaticSimulator: neighbour index out of range");
+                }
+            }
+        }
+        m_neighbours = std::move(neighbours);
+
+        m_voxels.resize(molecules.size());
+        for (unsigned k=0; k<m_voxels.size(); k++) {
+            m_voxels[k].molecules = molecules[k];
+            update_propensities(k);
+        }
+        initialise_next_reaction_times();
+    }
+
+    /**
+     * Sets the seed in the random number generator
+     * @param seed the value of the seed
+     */
+    void set_seed(unsigned seed) {
+        m_seed = seed;
+        m_gen = std::mt19937(m_seed);
+        initialise_next_reaction_times();
+    }
+
+    /**
+     * Returns the number used to generate the random numbers
+     */
+    unsigned get_seed() {
+        return m_seed;
+    }
+
+    /**
+     * Returns the current time in the simulation
+     */
+    double get_time() {
+        return m_time;
+    }
+
+    /**
+     * Returns the number of voxels
+     */
+    unsigned get_num_voxels() {
+        return m_voxels.size();
+    }
+
+    /**
+     * Returns the number of molecules of each species in the voxel with the given index
+     * @param index index of the voxel
+     */
+    Molecules get_molecules(const unsigned& index) {
+        return m_voxels[index].molecules;
+    }
+
+    /**
+     * Returns the number of molecules contained in each voxel as a single vector
+     */
+    std::vector<CountType> get_molecules() {
+        std::vector<CountType> output;
+        output.reserve(m_voxels.size() * N::num_species);
+        for (const auto& vox : m_voxels) {
+            output.insert(output.end(), vox.molecules.begin(), vox.molecules.end());
+        }
+        return output;
+    }
+
+    /**
+     * Function to make a single step in the SSA
+     */
+    void step() {
+        m_time = next_reaction_times.top_time();
+        if (std::isinf(m_time)) { return; }
+        unsigned voxel_idx = next_reaction_times.top_index();
+        VoxelState& vox = m_voxels[voxel_idx];
+
+        // Pick a reaction within the voxel, the unlikely case of rounding errors is attributed to the last reaction
+        double r = m_uniform(m_gen) * vox.total_propensity;
+        for (unsigned j=0; j<N::num_reactions; j++) {
+            if (r < vox.propensities[j]) {
+                N::apply(j, vox.molecules);
+                update_propensities(voxel_idx);
+                update_next_reaction_time(voxel_idx);
+                return;
+            }
+            r -= vox.propensities[j];
+        }
+
+        // Otherwise a molecule jumps to one of the neighbouring voxels
+        const auto& neighbours = m_neighbours[voxel_idx];
+        unsigned species = N::num_species - 1;
+        for (unsigned i=0; i<N::num_species; i++) {
+            double diffusion = m_diffusion_rates[i] * vox.molecules[i] * neighbours.size();
+            if (r < diffusion) {
+                species = i;
+                break;
+            }
+            r -= diffusion;
+        }
+        if (vox.molecules[species] == 0 or neighbours.empty()) {
+            update_next_reaction_time(voxel_idx);
+            return;
+        }
+        auto n = (std::size_t) (m_uniform(m_gen) * neighbours.size());
+        unsigned target = neighbours[std::min(n, neighbours.size() - 1)];
+
+        N::check_change(species, m_voxels[target].molecules[species], 1, "StaticSimulator::step");
+        vox.molecules[species] -= 1;
+        m_voxels[target].molecules[species] += 1;
+        update_propensities(voxel_idx);
+        update_propensities(target);
+        update_next_reaction_time(voxel_idx);
+        update_next_reaction_time(target);
+    }
+
+    /**
+     * Function to make multiple steps to reach the given point in time
+     * @param time_point the point in time in simulation that is reached
+     */
+    void advance(double time_point) {
+        while (m_time < time_point) {
+            step();
+        }
+    }
+};
+
+}
+
+#endif // STATIC_SIMULATOR_HPP
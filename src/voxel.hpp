@@ -7,17 +7,37 @@
 #define VOXEL_HPP
 
 // stl
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <memory>
 #include <vector>
 #include <iostream>
 
 // other header files
+#include "composition_rejection.hpp"
+#include "growth.hpp"
+#include "molecule_store.hpp"
 #include "reaction.hpp"
+#include "sum_tree.hpp"
 
 // Typedef for the growth function
 typedef std::function<double (const double&)> g_f;
 
 namespace StoSpa2 {
 
+/**
+ * Methods of picking the next reaction within a voxel. The direct method is a linear scan over
+ * the propensities, which is the fastest for a handful of reactions. The sum tree method picks a reaction
+ * and updates a propensity in O(log R), which pays off for voxels with many reactions. The composition-rejection
+ * method picks a reaction in constant expected time, which pays off for voxels with many reactions whose
+ * propensities span many orders of magnitude.
+ */
+enum class SelectionMethod { direct, sum_tree, composition_rejection };
+
+class BatchPropensities;
+
 /**
  * Voxel class - represents a voxel (or compartment, i.e. a subinterval or subarea of a domain)
  * in stochastic modelling. A voxel in stochastic modelling contains some number of molecules of
@@ -32,27 +52,575 @@ protected:
     /** Total propensity for all the reactions within a voxel */
     double a_0;
 
-    /** Vector of the number of molecules */
-    std::vector<unsigned> m_molecules;
+    /** Number of molecules of each species, a view into the MoleculeStore of a simulation */
+    StoSpa2::MoleculeCounts m_molecules;
 
     /** Vector of reactions within a voxel */
     std::vector<StoSpa2::Reaction> m_reactions;
 
+    /** Cached propensities of the reactions ordered as in m_reactions, to be scaled by their ScalingClass */
+    std::vector<double> m_propensities;
+
+    /** Sum of the propensities at the current size of the voxel */
+    double m_propensity_sum = 0;
+
+    /** Dependency graph - for each species the indices of the reactions whose propensities depend on it */
+    std::vector<std::vector<unsigned>> m_dependency_graph;
+
+    /** Marks used to avoid re-evaluating a propensity more than once per update */
+    std::vector<unsigned> m_marks;
+
+    /** Current value of the mark */
+    unsigned m_mark = 0;
+
+    /** Whether a reaction is treated as continuous, i.e. excluded from the total propensity and never picked */
+    std::vector<bool> m_continuous;
+
+    /** Number of reactions treated as continuous */
+    unsigned m_num_continuous = 0;
+
+    /** Whether changes in the number of molecules are checked for numbers that are negative or too large */
+    bool m_check_counts = false;
+
+    /** Method used to pick the next reaction */
+    SelectionMethod m_selection_method = SelectionMethod::direct;
+
+    /**
+     * Reactions whose propensities growth scales by the same power of the voxel size factor, e.g. diffusion or
+     * mass-action reactions of the same order. Their cached propensities are kept at the initial size of the
+     * voxel, so that a change in size only changes the scale of the class and not the cached propensities.
+     */
+    struct ScalingClass {
+        /** Power of the voxel size factor, from -4 to 1 */
+        int power;
+
+        /** Whether the propensities depend on the voxel size in an unknown way and are cached at the current size */
+        bool size_dependent;
+
+        /** Indices of the reactions in the class */
+        std::vector<unsigned> reactions;
+
+        /** Factor by which growth currently scales the cached propensities */
+        double scale;
+
+        /** Sum of the cached propensities */
+        double sum;
+
+        /** Sum tree over the cached propensities (only used by the sum tree selection method) */
+        StoSpa2::SumTree sum_tree;
+
+        /** Bins of the cached propensities (only used by the composition-rejection selection method) */
+        StoSpa2::CompositionRejection bins;
+    };
+
+    /** Scaling classes that contain any reactions, all the reactions of a static voxel are in a single class */
+    std::vector<ScalingClass> m_classes;
+
+    /** Index in m_classes of the class of each reaction */
+    std::vector<unsigned> m_class_of;
+
+    /** Index of each reaction within its class */
+    std::vector<unsigned> m_class_position;
+
+    /** Reactions whose propensities are out of date after update_time (see refresh_propensities) */
+    std::vector<unsigned> m_stale;
+
     /** Container for an extrande reaction if needed */
     std::vector<StoSpa2::Reaction> m_extrande_reaction;
 
-    /** Ratio of the upper bound for total propensity and the total propensity */
-    double m_extrande_ratio;
+    /** Ratio of the upper bound for total propensity and the total propensity (one for static voxels) */
+    double m_extrande_ratio = 1.0;
 
     /** Initial voxel size */
     double m_initial_voxel_size;
 
-    /** Function for how voxel size changes */
-    std::vector<std::function<double (const double&)>> m_growth_func;
+    /** Laws of how the voxel size changes (one for each spatial dimension) */
+    std::vector<StoSpa2::GrowthLaw> m_growth_func;
+
+    /** Growth clock of a simulation that evaluates the laws shared by many voxels (nullptr if not bound) */
+    std::shared_ptr<StoSpa2::GrowthClock> m_growth_clock;
+
+    /** Handles of the growth laws in the growth clock */
+    std::vector<unsigned> m_growth_handles;
 
     /** Whether the voxel is growing or not */
     bool m_growing;
 
+    /** Factor by which growth scales the rates of the diffusion reactions, applied when propensities are evaluated */
+    double m_diffusion_factor = 1.0;
+
+    /** Length of the look-ahead window over which the extrande bound is computed (0 uses m_extrande_ratio) */
+    double m_look_ahead = 0;
+
+    /** Time of the last update of the properties of a growing voxel */
+    double m_time = 0;
+
+    /** Time until which the current upper bound for the total propensity is valid */
+    double m_bound_end = std::numeric_limits<double>::infinity();
+
+    /** Piecewise-constant rate of a reaction, which is rates[k] from times[k] until the next time */
+    struct RateSchedule {
+        /** Index of the reaction */
+        unsigned reaction;
+
+        /** Increasing times at which the rate changes */
+        std::vector<double> times;
+
+        /** Rate from each time on */
+        std::vector<double> rates;
+    };
+
+    /** Scheduled rates of reactions */
+    std::vector<RateSchedule> m_schedules;
+
+    /** Whether the next event time is sampled by inverting the integrated total propensity instead of extrande */
+    bool m_integrated = false;
+
+    /** Combined growth law used to integrate the total propensity (constant, exponential or linear) */
+    GrowthKind m_hazard_growth = GrowthKind::constant;
+
+    /** Growth rate of the combined growth law (the sum of the rates of exponential laws) */
+    double m_hazard_rate = 0;
+
+    /** Number of linear laws, whose product is the voxel size factor */
+    int m_hazard_power = 0;
+
+    /** Number of picked reactions that are not the extrande reaction */
+    unsigned long m_num_accepted = 0;
+
+    /** Number of picked extrande reactions, i.e. events rejected by thinning */
+    unsigned long m_num_rejected = 0;
+
+    /** Whether the extrande ratio is tuned online */
+    bool m_tune_ratio = false;
+
+    /** Fraction of rejected events that the tuning of the extrande ratio aims for */
+    double m_target_rejection = 0.1;
+
+    /** Largest extrande ratio that the tuning may set */
+    double m_max_ratio = 10.0;
+
+    /** Largest observed growth of the total propensity between the times of a bound and of the next pick */
+    double m_max_growth = 1.0;
+
+    /** Re-evaluates the cached propensities of many voxels at once */
+    friend class BatchPropensities;
+
+    /**
+     * Returns the factor by which growth scales the rate of the given reaction
+     * @param r a reaction of the voxel
+     */
+    double rate_factor(const StoSpa2::Reaction& r) const {
+        return r.diffusion_idx >= 0 ? m_diffusion_factor : 1.0;
+    }
+
+    /**
+     * Evaluates the propensity of a reaction to be cached, at the initial size of the voxel unless its class
+     * depends on the size in an unknown way, in which case the growth of the voxel is included
+     * @param reaction_idx index of the reaction
+     */
+    double evaluate_propensity(const unsigned& reaction_idx) {
+        auto& r = m_reactions[reaction_idx];
+        if (!m_classes[m_class_of[reaction_idx]].size_dependent) {
+            return r.get_propensity(m_molecules, m_initial_voxel_size);
+        }
+        return rate_factor(r) * r.get_propensity(m_molecules, m_voxel_size);
+    }
+
+    /**
+     * Adds a reaction to its scaling class, creating the class if it does not exist yet. Mass-action propensities
+     * of order k scale with the voxel size to the power 1-k and diffusion with the diffusion factor, the other
+     * reactions of a growing voxel depend on the size in an unknown way.
+     * @param reaction_idx index of the reaction
+     */
+    void add_to_class(const unsigned& reaction_idx) {
+        const auto& r = m_reactions[reaction_idx];
+        int power = 0;
+        bool size_dependent = false;
+        if (m_growing) {
+            switch (r.get_definition().kind) {
+                case ReactionKind::zeroth_order:
+                    power = 1;
+                    break;
+                case ReactionKind::first_order:
+                    power = 0;
+                    break;
+                case ReactionKind::second_order:
+                    power = -1;
+                    break;
+                case ReactionKind::third_order:
+                    power = -2;
+                    break;
+                default:
+                    size_dependent = true;
+            }
+            if (!size_dependent and r.diffusion_idx >= 0) { power -= m_growth_func.size() == 1 ? 2 : 1; }
+        }
+
+        unsigned c = 0;
+        while (c < m_classes.size() and (m_classes[c].power != power or
+                                         m_classes[c].size_dependent != size_dependent)) {
+            c++;
+        }
+        if (c == m_classes.size()) {
+            double factor = m_voxel_size / m_initial_voxel_size;
+            m_classes.push_back({power, size_dependent, {}, size_dependent ? 1.0 : std::pow(factor, power), 0.0,
+                                 StoSpa2::SumTree(), StoSpa2::CompositionRejection()});
+        }
+        m_class_of.push_back(c);
+        m_class_position.push_back(m_classes[c].reactions.size());
+        m_classes[c].reactions.push_back(reaction_idx);
+    }
+
+    /**
+     * Re-evaluates the propensities of all the reactions and their sum
+     */
+    void update_propensities() {
+        for (unsigned i=0; i<m_reactions.size(); i++) {
+            m_propensities[i] = evaluate_propensity(i);
+        }
+        m_stale.clear();
+        reset_selection();
+        sum_propensities();
+    }
+
+    /**
+     * Re-evaluates the propensities of the reactions that depend on the species changed by the given vector
+     * @param stoichiometry_vec vector by which the number of molecules has changed
+     */
+    void update_propensities(const std::vector<int>& stoichiometry_vec) {
+        // Start a new round of marks, resetting them all if the counter wraps around
+        if (++m_mark == 0) {
+            std::fill(m_marks.begin(), m_marks.end(), 0);
+            m_mark = 1;
+        }
+
+        for (unsigned i=0; i<stoichiometry_vec.size(); i++) {
+            if (stoichiometry_vec[i] == 0) { continue; }
+            for (const auto& reaction_idx : m_dependency_graph[i]) {
+                if (m_marks[reaction_idx] != m_mark) {
+                    m_marks[reaction_idx] = m_mark;
+                    m_propensities[reaction_idx] = evaluate_propensity(reaction_idx);
+                    update_selection(reaction_idx);
+                }
+            }
+        }
+        sum_propensities();
+    }
+
+    /**
+     * Re-evaluates the propensities of the reactions that depend on the species in the given sparse changes
+     * @param changes changes in the number of molecules of the species that have changed
+     */
+    void update_propensities(const std::vector<StoSpa2::SpeciesChange>& changes) {
+        if (++m_mark == 0) {
+            std::fill(m_marks.begin(), m_marks.end(), 0);
+            m_mark = 1;
+        }
+
+        for (const auto& change : changes) {
+            for (const auto& reaction_idx : m_dependency_graph[change.species]) {
+                if (m_marks[reaction_idx] != m_mark) {
+                    m_marks[reaction_idx] = m_mark;
+                    m_propensities[reaction_idx] = evaluate_propensity(reaction_idx);
+                    update_selection(reaction_idx);
+                }
+            }
+        }
+        sum_propensities();
+    }
+
+    /**
+     * Throws an exception if the given change would make the number of molecules of a species negative or larger
+     * than the largest unsigned integer
+     * @param species index of the species
+     * @param delta change in the number of molecules
+     * @param method name of the method that reports the wrong number
+     */
+    void check_count(const unsigned& species, const int& delta, const char* method) {
+        if (delta < 0 and m_molecules[species] < (unsigned) -delta) {
+            throw std::runtime_error(std::string(method) + ": number of molecules of species "
+                                     + std::to_string(species) + " would become negative");
+        }
+        if (delta > 0 and m_molecules[species] > std::numeric_limits<unsigned>::max() - (unsigned) delta) {
+            throw std::runtime_error(std::string(method) + ": number of molecules of species "
+                                     + std::to_string(species) + " would exceed the largest unsigned integer");
+        }
+    }
+
+    /**
+     * Returns the cached propensity of a reaction as seen by the selection methods (zero for continuous reactions)
+     * @param reaction_idx index of the reaction
+     */
+    double exact_propensity(const unsigned& reaction_idx) const {
+        return (m_num_continuous > 0 and m_continuous[reaction_idx]) ? 0.0 : m_propensities[reaction_idx];
+    }
+
+    /**
+     * Rebuilds the structures used by the selection method from all the cached propensities
+     */
+    void reset_selection() {
+        if (m_selection_method == SelectionMethod::direct) { return; }
+
+        std::vector<double> propensities;
+        for (auto& c : m_classes) {
+            propensities.resize(c.reactions.size());
+            for (unsigned i=0; i<c.reactions.size(); i++) {
+                propensities[i] = exact_propensity(c.reactions[i]);
+            }
+            if (m_selection_method == SelectionMethod::sum_tree) {
+                c.sum_tree.reset(propensities);
+            }
+            else if (m_selection_method == SelectionMethod::composition_rejection) {
+                c.bins.reset(propensities);
+            }
+        }
+    }
+
+    /**
+     * Passes a single cached propensity to the structure used by the selection method
+     * @param reaction_idx index of the reaction whose propensity has changed
+     */
+    void update_selection(const unsigned& reaction_idx) {
+        auto& c = m_classes[m_class_of[reaction_idx]];
+        if (m_selection_method == SelectionMethod::sum_tree) {
+            c.sum_tree.update(m_class_position[reaction_idx], exact_propensity(reaction_idx));
+        }
+        else if (m_selection_method == SelectionMethod::composition_rejection) {
+            c.bins.update(m_class_position[reaction_idx], exact_propensity(reaction_idx));
+        }
+    }
+
+    /**
+     * Checks that the current total propensity does not exceed the upper bound used by the extrande method
+     */
+    void check_extrande_bound() {
+        // Check that current total propensity is not higher than previously calculated one
+        // (important for growing voxels)
+        if ((m_extrande_reaction.size() == 1) and (a_0 - m_propensity_sum < 0)) {
+            std::string m = m_look_ahead > 0
+                ? "Voxel::pick_reaction: the growth is not monotone over the look-ahead window ("
+                  + std::to_string(m_look_ahead) + ") "
+                : "Voxel::pick_reaction: extrande ratio (" + std::to_string(m_extrande_ratio) + ") is too low ";
+            m += "resulting in total propensity at current time (" + std::to_string(m_propensity_sum) + ") ";
+            m += "to be greater than at previous time (" + std::to_string(a_0) + ")";
+            throw std::runtime_error(m);
+        }
+    }
+
+    /**
+     * Counts a picked reaction as an accepted or rejected (extrande) event and tunes the extrande ratio if needed.
+     * The tuning multiplies the ratio by exp(gain * target) after an accepted event and by
+     * exp(-gain * (1 - target)) after a rejected one, which on average leaves it unchanged when the fraction of
+     * rejected events equals the target. The ratio is kept at least twice as far above one as the largest
+     * observed growth of the total propensity, so that the bound stays valid.
+     * @param reaction_idx index of the picked reaction
+     */
+    void record_pick(const unsigned& reaction_idx) {
+        bool rejected = reaction_idx >= m_reactions.size();
+        rejected ? m_num_rejected++ : m_num_accepted++;
+        if (!m_tune_ratio or m_integrated or m_extrande_reaction.empty() or m_look_ahead > 0 or a_0 <= 0) { return; }
+
+        const double gain = 0.01;
+        m_max_growth = std::max(m_max_growth, m_extrande_ratio * m_propensity_sum / a_0);
+        double ratio = m_extrande_ratio * std::exp(rejected ? -gain * (1 - m_target_rejection)
+                                                            : gain * m_target_rejection);
+        double min_ratio = 1.0 + 2.0 * (m_max_growth - 1.0);
+        m_extrande_ratio = std::min(std::max(ratio, min_ratio), std::max(m_max_ratio, min_ratio));
+    }
+
+    /**
+     * Returns an upper bound for the total propensity over the look-ahead window starting at the time of the
+     * last update. The number of molecules does not change until the next event in the voxel, so only the
+     * growth changes the propensities, by the power of the voxel size factor of their scaling class. The extremes
+     * of the growth over the window are exact for the built-in growth laws, custom growth functions are assumed
+     * to be monotone over the window (see GrowthLaw::range). The propensities of reactions that depend on the
+     * voxel size in an unknown way are bounded using the extrande ratio.
+     */
+    double look_ahead_bound() {
+        double min_factor = 1.0;
+        double max_factor = 1.0;
+        for (const auto& growth_func : m_growth_func) {
+            auto range = growth_func.range(m_time, m_time + m_look_ahead);
+            min_factor *= range.first;
+            max_factor *= range.second;
+        }
+
+        double bound = 0;
+        for (const auto& c : m_classes) {
+            if (c.sum <= 0) { continue; }
+            double scale = c.size_dependent ? std::max(m_extrande_ratio, 1.0)
+                                            : std::max(std::pow(c.power > 0 ? max_factor : min_factor, c.power),
+                                                       c.scale);
+            bound += scale * c.sum;
+        }
+
+        // A small margin keeps the bound valid despite the rounding of the propensities
+        return (1.0 + 1e-12) * bound;
+    }
+
+    /**
+     * Returns the total propensity at the current time grouped by the power of the voxel size factor that it
+     * scales with while the number of molecules does not change, from the power -4 to the power 1
+     */
+    std::array<double, 6> hazard_terms() {
+        std::array<double, 6> terms = {{0, 0, 0, 0, 0, 0}};
+        for (const auto& c : m_classes) {
+            if (c.sum <= 0) { continue; }
+            if (c.size_dependent) {
+                std::string m = "Voxel::integrated_event_time: the propensities of custom and expression "
+                                "reactions of a growing voxel cannot be integrated, use extrande instead";
+                throw std::runtime_error(m);
+            }
+            terms[c.power + 4] += c.sum * c.scale;
+        }
+        return terms;
+    }
+
+    /**
+     * Returns the voxel size factor relative to the current time after the given interval, raised to the given
+     * power, or its integral over the interval
+     * @param power power of the voxel size factor
+     * @param interval interval of time from the current time
+     * @param integrate whether the integral over the interval is returned
+     */
+    double size_factor(const int& power, const double& interval, bool integrate) const {
+        if (m_hazard_growth == GrowthKind::exponential and power != 0 and m_hazard_rate != 0) {
+            double c = power * m_hazard_rate;
+            return integrate ? std::expm1(c * interval) / c : std::exp(c * interval);
+        }
+        if (m_hazard_growth == GrowthKind::linear and power != 0 and m_hazard_rate != 0) {
+            // The linear laws 1 + rate * t relative to the current time are 1 + rho * interval
+            double rho = m_hazard_rate / (1.0 + m_hazard_rate * m_time);
+            int n = power * m_hazard_power;
+            if (!integrate) { return std::pow(1.0 + rho * interval, n); }
+            if (n == -1) { return std::log1p(rho * interval) / rho; }
+            return (std::pow(1.0 + rho * interval, n + 1) - 1.0) / (rho * (n + 1));
+        }
+        return integrate ? interval : 1.0;
+    }
+
+    /**
+     * Updates the rates of the reactions with a schedule to their values at the current time, the reactions
+     * whose rate has changed are left out of date
+     */
+    void apply_schedules() {
+        for (const auto& schedule : m_schedules) {
+            auto it = std::upper_bound(schedule.times.begin(), schedule.times.end(), m_time);
+            if (it == schedule.times.begin()) { continue; }
+            double rate = schedule.rates[it - schedule.times.begin() - 1];
+            auto& r = m_reactions[schedule.reaction];
+            if (r.get_rate() != rate) {
+                r.set_rate(rate);
+                m_stale.push_back(schedule.reaction);
+            }
+        }
+    }
+
+    /**
+     * Returns the first time after the current time at which a scheduled rate changes
+     */
+    double next_rate_change() const {
+        double next = std::numeric_limits<double>::infinity();
+        for (const auto& schedule : m_schedules) {
+            auto it = std::upper_bound(schedule.times.begin(), schedule.times.end(), m_time);
+            if (it != schedule.times.end()) { next = std::min(next, *it); }
+        }
+        return next;
+    }
+
+    /**
+     * Returns the reaction with the given index, indices past the last reaction refer to the extrande reaction
+     * @param reaction_idx index of the reaction
+     * @return reference to the reaction
+     */
+    StoSpa2::Reaction& reaction_at(const unsigned& reaction_idx) {
+        // Return the correct reference to a reaction, if index is greater than size of reactions vector,
+        // then it must be either extrande reaction (none -> None) or something went wrong
+        if (reaction_idx < m_reactions.size()) {
+            return m_reactions[reaction_idx];
+        }
+        else if ((reaction_idx >= m_reactions.size()) and (m_extrande_reaction.size() == 1)) {
+            return m_extrande_reaction[0];
+        }
+        else {
+            throw std::runtime_error("Voxel::pick_reaction: Wrong reaction index!");
+        }
+    }
+
+    /**
+     * Sums the cached propensities of each scaling class and the scaled sums (no propensity function is evaluated)
+     */
+    void sum_propensities() {
+        for (auto& c : m_classes) {
+            if (m_selection_method == SelectionMethod::sum_tree) {
+                c.sum = c.sum_tree.total();
+            }
+            else if (m_selection_method == SelectionMethod::composition_rejection) {
+                c.sum = c.bins.total();
+            }
+            else {
+                c.sum = 0;
+                for (const auto& reaction_idx : c.reactions) {
+                    c.sum += exact_propensity(reaction_idx);
+                }
+            }
+        }
+        scale_propensities();
+    }
+
+    /**
+     * Sums the scaled sums of the scaling classes, which is all that a change in the size of the voxel needs
+     */
+    void scale_propensities() {
+        double total = 0;
+        for (const auto& c : m_classes) {
+            total += c.sum * c.scale;
+        }
+        m_propensity_sum = total;
+    }
+
+    /**
+     * Picks the scaling class in which a number below the total propensity falls, only the propensities of the
+     * picked class need to be scaled
+     * @param random_num number in the interval [0, m_propensity_sum), which is replaced by the corresponding
+     * number in the interval [0, sum) of the cached propensities of the class
+     * @return index of the class
+     */
+    unsigned pick_class(double& random_num) const {
+        unsigned picked = 0;
+        double cumulative = 0;
+        for (unsigned c=0; c<m_classes.size(); c++) {
+            double part = m_classes[c].sum * m_classes[c].scale;
+            if (part <= 0) { continue; }
+            picked = c;
+            if (random_num < cumulative + part) { break; }
+            cumulative += part;
+        }
+        random_num = (random_num - cumulative) / m_classes[picked].scale;
+        return picked;
+    }
+
+    /**
+     * Re-evaluates the propensities left out of date by update_time and their sum
+     */
+    void update_stale_propensities() {
+        if (++m_mark == 0) {
+            std::fill(m_marks.begin(), m_marks.end(), 0);
+            m_mark = 1;
+        }
+
+        for (const auto& reaction_idx : m_stale) {
+            if (m_marks[reaction_idx] != m_mark) {
+                m_marks[reaction_idx] = m_mark;
+                m_propensities[reaction_idx] = evaluate_propensity(reaction_idx);
+                update_selection(reaction_idx);
+            }
+        }
+        m_stale.clear();
+        sum_propensities();
+    }
+
 public:
 
     /**
@@ -64,12 +632,12 @@ public:
         // We define the appropriate member variables
         m_voxel_size = voxel_size;
         m_initial_voxel_size = voxel_size;
-        m_molecules = std::move(initial_num);
+        m_molecules = StoSpa2::MoleculeCounts(std::move(initial_num));
+        m_dependency_graph.resize(m_molecules.size());
 
         // Since no growth function is given the voxel is assumed to be of static size
         m_growing = false;
-        auto one = [](const double& time) { return 1.0; };
-        m_growth_func.emplace_back(one);
+        m_growth_func.push_back(StoSpa2::GrowthLaw::constant());
     }
 
     /**
@@ -79,37 +647,46 @@ public:
      * @param growth lambda function that describes how a voxel grows
      * @param extrande_ratio ratio between upper bound for total propensity and total propensity
      */
-    Voxel(std::vector<unsigned> initial_num,  double voxel_size, g_f growth, double extrande_ratio=2.0) {
-        // We define the appropriate member variables
-        m_voxel_size = voxel_size;
-        m_initial_voxel_size = voxel_size;
-        m_molecules = std::move(initial_num);
+    Voxel(std::vector<unsigned> initial_num,  double voxel_size, g_f growth, double extrande_ratio=2.0) :
+        Voxel(std::move(initial_num), voxel_size, StoSpa2::GrowthLaw(std::move(growth)), extrande_ratio) {}
 
-        // Since growth function (argument growth) is given, the voxel size is changing,
-        // hence we set the member variables associated with voxel growth
-        m_growing = true;
-        m_growth_func.emplace_back(std::move(growth));
+    /**
+     * Constructor for the Voxel class
+     * @param initial_num vector of the number of molecules initially for all species
+     * @param voxel_size intial size of the voxel
+     * @param growth vector of lambda functions that describe how a voxel grows (one for each spatial dimension)
+     * @param extrande_ratio ratio between upper bound for total propensity and total propensity
+     */
+    Voxel(std::vector<unsigned> initial_num,  double voxel_size, std::vector<g_f> growth, double extrande_ratio=2.0) :
+        Voxel(std::move(initial_num), voxel_size,
+              std::vector<StoSpa2::GrowthLaw>(growth.begin(), growth.end()), extrande_ratio) {}
 
-        // Since the size of the voxel is changing, we need to use the extrande method in the stochastic simulations
-        if (extrande_ratio < 1.0) {
-            throw std::runtime_error("Voxel::Voxel: extrande_ratio needs to greater than 1.0");
-        }
-        m_extrande_ratio = extrande_ratio;
-        add_extrande();
-    }
+    /**
+     * Constructor for the Voxel class
+     * @param initial_num vector of the number of molecules initially for all species
+     * @param voxel_size intial size of the voxel
+     * @param growth law that describes how a voxel grows (e.g. GrowthLaw::exponential)
+     * @param extrande_ratio ratio between upper bound for total propensity and total propensity
+     */
+    Voxel(std::vector<unsigned> initial_num,  double voxel_size, StoSpa2::GrowthLaw growth,
+          double extrande_ratio=2.0) :
+        Voxel(std::move(initial_num), voxel_size, std::vector<StoSpa2::GrowthLaw>({std::move(growth)}),
+              extrande_ratio) {}
 
     /**
      * Constructor for the Voxel class
      * @param initial_num vector of the number of molecules initially for all species
      * @param voxel_size intial size of the voxel
-     * @param growth vector of lambda functions that describe how a voxel grows (one for each spatial dimension)
+     * @param growth vector of laws that describe how a voxel grows (one for each spatial dimension)
      * @param extrande_ratio ratio between upper bound for total propensity and total propensity
      */
-    Voxel(std::vector<unsigned> initial_num,  double voxel_size, std::vector<g_f> growth, double extrande_ratio=2.0) {
+    Voxel(std::vector<unsigned> initial_num,  double voxel_size, std::vector<StoSpa2::GrowthLaw> growth,
+          double extrande_ratio=2.0) {
         // We define the appropriate member variables
         m_voxel_size = voxel_size;
         m_initial_voxel_size = voxel_size;
-        m_molecules = std::move(initial_num);
+        m_molecules = StoSpa2::MoleculeCounts(std::move(initial_num));
+        m_dependency_graph.resize(m_molecules.size());
 
         // Since growth function (argument growth) is given, the voxel size is changing,
         // hence we set the member variables associated with voxel growth
@@ -129,7 +706,44 @@ public:
      * @return copy of m_molecules member variable
      */
     std::vector<unsigned> get_molecules() {
-        return m_molecules;
+        return m_molecules.to_vector();
+    }
+
+    /**
+     * Returns number of molecules of a single species present in a voxel
+     * @param species index of the species
+     * @return copy of the element of m_molecules member variable
+     */
+    unsigned get_molecules(const unsigned& species) {
+        return m_molecules[species];
+    }
+
+    /**
+     * Returns the number of species in the voxel
+     */
+    unsigned get_num_species() {
+        return m_molecules.size();
+    }
+
+    /**
+     * Replaces the number of molecules of all species and re-evaluates all the propensities
+     * @param molecules vector of the number of molecules for all species
+     */
+    void set_molecules(std::vector<unsigned> molecules) {
+        if (molecules.size() != m_molecules.size()) {
+            throw std::runtime_error("Voxel::set_molecules: molecules.size() != m_molecules.size()");
+        }
+        m_molecules.assign(molecules);
+        update_propensities();
+    }
+
+    /**
+     * Moves the number of molecules into a domain-wide store, after which the voxel reads and writes them there
+     * @param store the molecule store of a simulation
+     * @param voxel_idx index of the voxel in the store
+     */
+    void bind_molecules(StoSpa2::MoleculeStore& store, const unsigned& voxel_idx) {
+        store.bind(voxel_idx, m_molecules);
     }
 
     /**
@@ -157,38 +771,398 @@ public:
     }
 
     /**
-     * Updates any properties that need to updated due to growth of the voxel
+     * Returns the factor by which growth currently scales the rates of the diffusion reactions
+     * @return copy of m_diffusion_factor member variable
+     */
+    double get_diffusion_factor() {
+        return m_diffusion_factor;
+    }
+
+    /**
+     * Updates any properties that need to updated due to growth of the voxel and the scheduled rates of
+     * reactions. The other rates of the reactions are left unchanged, the growth of the voxel only rescales the
+     * sums of the scaling classes and is applied to single propensities when they are needed.
      * @param time current time of the simulation
      */
     void update_properties(const double& time) {
+        if (update_time(time)) { refresh_propensities(); }
+    }
+
+    /**
+     * Updates the size of the voxel and the scheduled rates like update_properties, but leaves the propensities
+     * that need to be re-evaluated (those with a changed rate and those that depend on the voxel size in an
+     * unknown way) to the caller, e.g. to re-evaluate those of many voxels at once (see
+     * Simulator::refresh_propensities)
+     * @param time current time of the simulation
+     * @return whether any propensities need to be re-evaluated
+     */
+    bool update_time(const double& time) {
+        m_time = time;
+        if (!m_schedules.empty()) { apply_schedules(); }
+
         // If the voxel is growing, then we need to update some properties
         if (m_growing) {
             // For growth in each dimension, multiply together the factors
             // to get how much the length / area has increased
             double new_factor = 1.0;
-            for (auto& growth_func : m_growth_func) {
-                new_factor *= growth_func(time);
+            if (m_growth_clock) {
+                for (const auto& handle : m_growth_handles) {
+                    new_factor *= m_growth_clock->factor(handle, time);
+                }
+            }
+            else {
+                for (auto& growth_func : m_growth_func) {
+                    new_factor *= growth_func(time);
+                }
+            }
+            double voxel_size = new_factor * m_initial_voxel_size;
+            if (voxel_size != m_voxel_size) {
+                m_voxel_size = voxel_size;
+
+                // Diffusion slows down as the distance between the centres of neighbouring voxels increases
+                m_diffusion_factor = 1.0 / (m_growth_func.size() == 1 ? new_factor * new_factor : new_factor);
+
+                // Only the scales of the classes change, unless some propensities depend on the size otherwise
+                for (auto& c : m_classes) {
+                    if (c.size_dependent) {
+                        m_stale.insert(m_stale.end(), c.reactions.begin(), c.reactions.end());
+                    }
+                    else {
+                        c.scale = std::pow(new_factor, c.power);
+                    }
+                }
+                scale_propensities();
+            }
+        }
+        return !m_stale.empty();
+    }
+
+    /**
+     * Re-evaluates the propensities left out of date by update_time and their sum
+     */
+    void refresh_propensities() {
+        update_stale_propensities();
+    }
+
+    /**
+     * Registers the growth laws of a growing voxel with the growth clock of a simulation, after which the voxel
+     * refers to them by handle and equal laws of different voxels are evaluated once for each distinct time
+     * @param clock the growth clock of a simulation
+     */
+    void bind_growth(std::shared_ptr<StoSpa2::GrowthClock> clock) {
+        if (!m_growing) { return; }
+        m_growth_handles.clear();
+        for (const auto& growth_func : m_growth_func) {
+            m_growth_handles.push_back(clock->add(growth_func));
+        }
+        m_growth_clock = std::move(clock);
+    }
+
+    /**
+     * Sets whether the extrande ratio of a growing voxel is tuned online to keep the fraction of rejected
+     * (extrande) events near the target (see record_pick). Tuning only applies without a look-ahead window.
+     * @param tune whether to tune the extrande ratio
+     * @param target_rejection fraction of rejected events to aim for
+     * @param max_ratio largest extrande ratio that the tuning may set
+     */
+    void set_ratio_tuning(bool tune, double target_rejection=0.1, double max_ratio=10.0) {
+        if (target_rejection <= 0 or target_rejection >= 1) {
+            throw std::runtime_error("Voxel::set_ratio_tuning: target_rejection needs to be between 0.0 and 1.0");
+        }
+        if (max_ratio < 1) {
+            throw std::runtime_error("Voxel::set_ratio_tuning: max_ratio needs to be greater than 1.0");
+        }
+        m_tune_ratio = tune;
+        m_target_rejection = target_rejection;
+        m_max_ratio = max_ratio;
+    }
+
+    /**
+     * Returns whether the extrande ratio is tuned online
+     * @return copy of m_tune_ratio member variable
+     */
+    bool get_ratio_tuning() {
+        return m_tune_ratio;
+    }
+
+    /**
+     * Returns the number of picked reactions that are not the extrande reaction
+     * @return copy of m_num_accepted member variable
+     */
+    unsigned long get_num_accepted() {
+        return m_num_accepted;
+    }
+
+    /**
+     * Returns the number of picked extrande reactions, i.e. events rejected by thinning
+     * @return copy of m_num_rejected member variable
+     */
+    unsigned long get_num_rejected() {
+        return m_num_rejected;
+    }
+
+    /**
+     * Resets the numbers of accepted and rejected events
+     */
+    void reset_extrande_statistics() {
+        m_num_accepted = 0;
+        m_num_rejected = 0;
+    }
+
+    /**
+     * State of a voxel that changes as it is simulated (see save_state)
+     */
+    struct State {
+        /** Number of molecules of each species */
+        std::vector<unsigned> molecules;
+
+        /** Rates of the reactions with a schedule */
+        std::vector<double> rates;
+
+        /** Cached propensities of the reactions */
+        std::vector<double> propensities;
+
+        /** Scaling classes of the reactions with their scales, sums and structures used by the selection method */
+        std::vector<ScalingClass> classes;
+
+        /** Scalar members of the voxel with the same names */
+        double propensity_sum, a_0, voxel_size, diffusion_factor, time, bound_end, extrande_ratio, max_growth;
+
+        /** Numbers of accepted and rejected events */
+        unsigned long num_accepted, num_rejected;
+    };
+
+    /**
+     * Saves the state of the voxel that changes as it is simulated, so that restore_state can undo events
+     * exactly, i.e. including the rounding of the propensities that are updated incrementally
+     * @param state the saved state, whose memory is reused
+     */
+    void save_state(State& state) {
+        state.molecules.resize(m_molecules.size());
+        for (unsigned i=0; i<m_molecules.size(); i++) {
+            state.molecules[i] = m_molecules[i];
+        }
+        state.rates.clear();
+        for (const auto& schedule : m_schedules) {
+            state.rates.push_back(m_reactions[schedule.reaction].get_rate());
+        }
+        state.propensities = m_propensities;
+        state.classes = m_classes;
+        state.propensity_sum = m_propensity_sum;
+        state.a_0 = a_0;
+        state.voxel_size = m_voxel_size;
+        state.diffusion_factor = m_diffusion_factor;
+        state.time = m_time;
+        state.bound_end = m_bound_end;
+        state.extrande_ratio = m_extrande_ratio;
+        state.max_growth = m_max_growth;
+        state.num_accepted = m_num_accepted;
+        state.num_rejected = m_num_rejected;
+    }
+
+    /**
+     * Restores a state saved by save_state, the reactions and settings of the voxel need to be the same
+     * @param state the saved state
+     */
+    void restore_state(const State& state) {
+        for (unsigned i=0; i<m_molecules.size(); i++) {
+            m_molecules[i] = state.molecules[i];
+        }
+        for (unsigned i=0; i<m_schedules.size(); i++) {
+            m_reactions[m_schedules[i].reaction].set_rate(state.rates[i]);
+        }
+        m_propensities = state.propensities;
+        m_classes = state.classes;
+        m_propensity_sum = state.propensity_sum;
+        a_0 = state.a_0;
+        m_voxel_size = state.voxel_size;
+        m_diffusion_factor = state.diffusion_factor;
+        m_time = state.time;
+        m_bound_end = state.bound_end;
+        m_extrande_ratio = state.extrande_ratio;
+        m_max_growth = state.max_growth;
+        m_num_accepted = state.num_accepted;
+        m_num_rejected = state.num_rejected;
+    }
+
+    /**
+     * Sets the length of the look-ahead window over which the upper bound for the total propensity of a growing
+     * voxel is computed from its growth (see look_ahead_bound). A bound is valid until the end of its window,
+     * after which a new one is computed. Zero uses the extrande ratio instead.
+     * @param look_ahead length of the look-ahead window
+     */
+    void set_look_ahead(double look_ahead) {
+        if (look_ahead < 0) {
+            throw std::runtime_error("Voxel::set_look_ahead: look_ahead needs to be greater than or equal to 0.0");
+        }
+        m_look_ahead = look_ahead;
+        m_bound_end = std::numeric_limits<double>::infinity();
+    }
+
+    /**
+     * Sets whether the time of the next event is sampled by inverting the integrated total propensity of the
+     * voxel, which is exact and rejects no events, instead of by extrande. The growth laws of a growing voxel need
+     * to be constant, exponential or linear with the same rate, and its reactions need to be mass-action.
+     * @param integrated whether to integrate the total propensity
+     */
+    void set_integrated_hazard(bool integrated) {
+        m_integrated = integrated;
+        if (!integrated) { return; }
+
+        GrowthKind growth = GrowthKind::constant;
+        double rate = 0;
+        int power = 0;
+        for (const auto& growth_func : m_growth_func) {
+            GrowthKind kind = growth_func.get_kind();
+            if (kind == GrowthKind::constant) { continue; }
+            bool same = growth == GrowthKind::constant or (kind == growth and (kind == GrowthKind::exponential or
+                                                                               growth_func.get_rate() == rate));
+            if (!same or (kind != GrowthKind::exponential and kind != GrowthKind::linear)) {
+                m_integrated = false;
+                std::string m = "Voxel::set_integrated_hazard: growth laws need to be constant, exponential or "
+                                "linear with the same rate to be integrated";
+                throw std::runtime_error(m);
+            }
+            growth = kind;
+            rate = kind == GrowthKind::exponential ? rate + growth_func.get_rate() : growth_func.get_rate();
+            power++;
+        }
+        m_hazard_growth = growth;
+        m_hazard_rate = rate;
+        m_hazard_power = power;
+    }
+
+    /**
+     * Returns whether the time of the next event is sampled by inverting the integrated total propensity
+     * @return copy of m_integrated member variable
+     */
+    bool get_integrated_hazard() {
+        return m_integrated;
+    }
+
+    /**
+     * Returns the time at which the total propensity integrated from the current time reaches the given value,
+     * or infinity if it does not before the end of the current bound (see get_bound_end). A unit exponential
+     * random number gives the time of the next event.
+     * @param hazard value of the integrated total propensity
+     */
+    double integrated_event_time(const double& hazard) {
+        double total = get_total_propensity();
+        const double inf = std::numeric_limits<double>::infinity();
+        if (total <= 0) { return inf; }
+        if (!m_growing or m_hazard_growth == GrowthKind::constant) { return m_time + hazard / total; }
+
+        // A shrinking voxel is integrated until its size would become zero
+        std::array<double, 6> terms = hazard_terms();
+        double limit = m_bound_end - m_time;
+        if (m_hazard_growth == GrowthKind::linear and m_hazard_rate < 0) {
+            limit = std::min(limit, -(1.0 + m_hazard_rate * m_time) / m_hazard_rate);
+        }
+        auto integral = [this, &terms](const double& interval, bool integrate) {
+            double value = 0;
+            for (int p=0; p<6; p++) {
+                if (terms[p] > 0) { value += terms[p] * size_factor(p - 4, interval, integrate); }
             }
-            m_voxel_size = new_factor * m_initial_voxel_size;
+            return value;
+        };
 
-            // Then need to update the rate of diffusion of molecules
-            double diff_factor = 1.0 / (m_growth_func.size() == 1 ? new_factor * new_factor : new_factor);
+        // Bracket the time by doubling the interval, then refine it by Newton steps kept inside the bracket
+        double lower = 0;
+        double upper = std::min(hazard / total, limit);
+        for (unsigned n=0; integral(upper, true) < hazard; n++) {
+            if (upper >= limit or n == 2000) { return inf; }
+            lower = upper;
+            upper = std::min(2 * upper, limit);
+        }
+        double interval = upper;
+        for (unsigned n=0; n<100; n++) {
+            double residual = integral(interval, true) - hazard;
+            if (residual == 0) { break; }
+            (residual < 0 ? lower : upper) = interval;
+            double next = interval - residual / integral(interval, false);
+            if (!(next > lower and next < upper)) { next = 0.5 * (lower + upper); }
+            bool converged = std::abs(next - interval) <= 1e-15 * interval;
+            interval = next;
+            if (converged) { break; }
+        }
+        return m_time + interval;
+    }
 
-            for (auto& reaction : m_reactions) {
-                reaction.update_properties(diff_factor);
+    /**
+     * Sets a piecewise-constant rate of a reaction, which is rates[k] from times[k] until the next time and is
+     * left unchanged before the first time. The time of the next event in the voxel is not past the next change.
+     * @param reaction_idx index of the reaction
+     * @param times increasing times at which the rate changes
+     * @param rates non-negative rate from each time on
+     */
+    void set_rate_schedule(unsigned reaction_idx, std::vector<double> times, std::vector<double> rates) {
+        if (reaction_idx >= m_reactions.size()) {
+            throw std::runtime_error("Voxel::set_rate_schedule: reaction_idx is out of range");
+        }
+        if (times.empty() or times.size() != rates.size()) {
+            std::string m = "Voxel::set_rate_schedule: times and rates need to be non-empty and of the same size";
+            throw std::runtime_error(m);
+        }
+        for (std::size_t i=1; i<times.size(); i++) {
+            if (times[i] <= times[i-1]) {
+                throw std::runtime_error("Voxel::set_rate_schedule: times need to be increasing");
             }
         }
+        for (const auto& rate : rates) {
+            if (!(rate >= 0)) {
+                throw std::runtime_error("Voxel::set_rate_schedule: rates need to be non-negative");
+            }
+        }
+        m_schedules.push_back({reaction_idx, std::move(times), std::move(rates)});
+    }
+
+    /**
+     * Returns the length of the look-ahead window used for the extrande bound
+     * @return copy of m_look_ahead member variable
+     */
+    double get_look_ahead() {
+        return m_look_ahead;
+    }
+
+    /**
+     * Returns the time until which the upper bound for the total propensity is valid, the time of the next event
+     * in the voxel is not to be past it
+     * @return copy of m_bound_end member variable
+     */
+    double get_bound_end() {
+        return m_bound_end;
     }
 
     /**
      * Adds a reaction (none -> none) that is essential in the extrande method
      */
     void add_extrande() {
-        // Define the lambda function that will be the propensity function for for the extrande reaction
+        // Define the lambda function that will be the propensity function for for the extrande reaction,
+        // a single extrande reaction is copied to all the voxels so that they share its definition
         auto constant_func = [](const std::vector<unsigned>& mols, const double& area) { return 1.0; };
+        static const StoSpa2::Reaction extrande(0.0, constant_func, {0});
         // Then if the container for the extrande reaction is empty add the extrande reaction
         if (m_extrande_reaction.empty()) {
-            m_extrande_reaction.emplace_back(StoSpa2::Reaction(0.0, constant_func, {0}));
+            m_extrande_reaction.push_back(extrande);
+        }
+    }
+
+    /**
+     * Replaces the reactions of the voxel with copies that use the definitions interned in the given table,
+     * so that equal reactions in different voxels share a single definition
+     * @param table the table of reaction definitions
+     */
+    void share_reactions(StoSpa2::ReactionTable& table) {
+        std::vector<StoSpa2::Reaction> reactions;
+        reactions.reserve(m_reactions.size());
+        for (const auto& r : m_reactions) {
+            reactions.push_back(table.share(r));
+        }
+        m_reactions.swap(reactions);
+
+        if (!m_extrande_reaction.empty()) {
+            std::vector<StoSpa2::Reaction> extrande = {table.share(m_extrande_reaction.front())};
+            m_extrande_reaction.swap(extrande);
         }
     }
 
@@ -202,10 +1176,38 @@ public:
             throw std::runtime_error(m);
         }
 
+        // Check that the species on which the propensity depends exist
+        for (const auto& species : r.get_dependencies()) {
+            if (species >= m_molecules.size()) {
+                std::string m = "Voxel::add_reaction: r.get_dependencies() contains a species index out of range";
+                throw std::runtime_error(m);
+            }
+        }
+
         // If the reaction rate is greater than zero add it to the vector of reactions
         // Reactions with zero rate are not added for efficiency purposes
         if (r.get_rate() > 0) {
+            unsigned reaction_idx = m_reactions.size();
             m_reactions.push_back(r);
+            add_to_class(reaction_idx);
+            m_propensities.push_back(evaluate_propensity(reaction_idx));
+            m_marks.push_back(0);
+            m_continuous.push_back(false);
+            reset_selection();
+            sum_propensities();
+
+            // Add the reaction to the dependency graph, if the species on which it depends are
+            // not given, it is assumed to depend on all of them
+            if (r.has_dependencies()) {
+                for (const auto& species : r.get_dependencies()) {
+                    m_dependency_graph[species].push_back(reaction_idx);
+                }
+            }
+            else {
+                for (auto& reactions : m_dependency_graph) {
+                    reactions.push_back(reaction_idx);
+                }
+            }
         }
     }
 
@@ -217,29 +1219,101 @@ public:
         return m_reactions;
     }
 
+    /**
+     * Returns the number of reactions within a voxel
+     */
+    unsigned get_num_reactions() {
+        return m_reactions.size();
+    }
+
+    /**
+     * Sets whether a reaction is treated as continuous. A continuous reaction is excluded from the total
+     * propensity and is never picked, but its propensity is still kept up to date, so that it can be
+     * integrated outside of the voxel (e.g. by the HybridSimulator).
+     * @param reaction_idx index of the reaction in the vector of reactions
+     * @param continuous whether the reaction is treated as continuous
+     */
+    void set_continuous(const unsigned& reaction_idx, bool continuous) {
+        if (m_continuous[reaction_idx] == continuous) { return; }
+        m_continuous[reaction_idx] = continuous;
+        m_num_continuous += continuous ? 1 : -1;
+        update_selection(reaction_idx);
+        sum_propensities();
+    }
+
+    /**
+     * Returns whether a reaction is treated as continuous
+     * @param reaction_idx index of the reaction in the vector of reactions
+     */
+    bool is_continuous(const unsigned& reaction_idx) {
+        return m_continuous[reaction_idx];
+    }
+
+    /**
+     * Returns the current propensity of a reaction
+     * @param reaction_idx index of the reaction in the vector of reactions
+     * @return the cached propensity scaled to the current size of the voxel
+     */
+    double get_propensity(const unsigned& reaction_idx) {
+        return m_propensities[reaction_idx] * m_classes[m_class_of[reaction_idx]].scale;
+    }
+
     /**
      * Clears the vector of Reaction objects
      */
     void clear_reactions() {
         m_reactions.clear();
+        m_propensities.clear();
+        for (auto& reactions : m_dependency_graph) {
+            reactions.clear();
+        }
+        m_marks.clear();
+        m_continuous.clear();
+        m_num_continuous = 0;
+        m_classes.clear();
+        m_class_of.clear();
+        m_class_position.clear();
+        m_stale.clear();
+        m_propensity_sum = 0;
+    }
+
+    /**
+     * Sets the method used to pick the next reaction
+     * @param method method used to pick the next reaction
+     */
+    void set_selection_method(SelectionMethod method) {
+        m_selection_method = method;
+        reset_selection();
+        sum_propensities();
     }
 
     /**
-     * Returns the current total propensity
+     * Returns the method used to pick the next reaction
+     * @return copy of m_selection_method member variable
+     */
+    SelectionMethod get_selection_method() {
+        return m_selection_method;
+    }
+
+    /**
+     * Returns the current total propensity, which is kept up to date as the number of molecules changes
      * @param update determines whether member variable a_0 is updated
      */
     double get_total_propensity(bool update=true) {
-        // First loop over all the reactions to get the maximum
-        double total = 0;
-        for (auto& reaction : m_reactions) {
-            total += reaction.get_propensity(m_molecules, m_voxel_size);
-        }
+        double total = m_propensity_sum;
 
         // If a_0 does not need to be updated, then return the total propensity calculated thus far
         if (!update) { return total; }
 
         // If extrande method is used, then multiply the total propensity by the member variable m_extrande_ratio
-        if (m_extrande_reaction.size() == 1) {
+        // or bound it over the look-ahead window, a bound is valid until the next change of a scheduled rate
+        m_bound_end = m_schedules.empty() ? std::numeric_limits<double>::infinity() : next_rate_change();
+        bool extrande = m_extrande_reaction.size() == 1 and !m_integrated;
+        if (extrande and m_look_ahead > 0) {
+            total = look_ahead_bound();
+            m_bound_end = std::min(m_bound_end, m_time + m_look_ahead);
+        }
+        else if (extrande) {
             total = m_extrande_ratio * total;
         }
 
@@ -250,52 +1324,86 @@ public:
     }
 
     /**
-     * Picks a reaction from the vector of reactions (m_reactions) and returns a reference to this reaction
+     * Picks a reaction from the vector of reactions (m_reactions) and returns a reference to this reaction.
+     * The composition-rejection method needs further random numbers, which are passed to the other overload.
      * @param random_num a random number generated from a unfiform distribution
      * @return reference to the reaction that has been chosen
      */
     StoSpa2::Reaction& pick_reaction(double random_num) {
-        // Scale the randomly chose number to the total propensity
-        double r_a_0 = random_num * a_0;
-
-        // Check that current total propensity is not higher than previously calculated one
-        // (important for growing voxels)
-        if ((m_extrande_reaction.size() == 1) and (a_0 - get_total_propensity(false) < 0)) {
-            std::string m = "Voxel::pick_reaction: extrande ratio (" + std::to_string(m_extrande_ratio) + ") is too low ";
-            m += "resulting in total propensity at current time (" + std::to_string(get_total_propensity(false)) + ") ";
-            m += "to be greater than at previous time (" + std::to_string(a_0) + ")";
+        if (m_selection_method == SelectionMethod::composition_rejection) {
+            std::string m = "Voxel::pick_reaction: the composition-rejection method needs a generator of further ";
+            m += "random numbers";
             throw std::runtime_error(m);
         }
 
+        // Scale the randomly chose number to the total propensity, which is exact at the time of the event when
+        // it is integrated
+        if (m_integrated) { a_0 = m_propensity_sum; }
+        double r_a_0 = random_num * a_0;
+
+        check_extrande_bound();
+
         // Initialise some values imprtant for the loop below
         unsigned reaction_idx = 0;
-        double lower_bound = 0;
-
-        // Loop over all the reactions
-        for (auto& reaction : m_reactions) {
-            double propensity = reaction.get_propensity(m_molecules, m_voxel_size);
-            // If the randomly chosen value is in the current interval, then break the loop,
-            // otherwise move to the next interval
-            if (r_a_0 > lower_bound and r_a_0 < lower_bound + propensity) {
-                break;
-            }
-            else {
-                reaction_idx += 1;
-                lower_bound += propensity;
-            }
-        }
 
-        // Return the correct reference to a reaction, if index is greater than size of reactions vector,
-        // then it must be either extrande reaction (none -> None) or something went wrong
-        if (reaction_idx < m_reactions.size()) {
-            return m_reactions[reaction_idx];
+        if (r_a_0 >= m_propensity_sum) {
+            // Anything beyond the total propensity is the extrande reaction
+            reaction_idx = m_reactions.size();
         }
-        else if ((reaction_idx >= m_reactions.size()) and (m_extrande_reaction.size() == 1)) {
-            return m_extrande_reaction[0];
+        else if (m_selection_method == SelectionMethod::sum_tree) {
+            // Descend the sum tree of the class in which the randomly chosen value is
+            const auto& c = m_classes[pick_class(r_a_0)];
+            reaction_idx = c.reactions[c.sum_tree.search(r_a_0)];
         }
         else {
-            throw std::runtime_error("Voxel::pick_reaction: Wrong reaction index!");
+            // Loop over the cached propensities of the class, if the randomly chosen value is in the current
+            // interval, then break the loop, otherwise move to the next interval
+            const auto& c = m_classes[pick_class(r_a_0)];
+            double upper_bound = 0;
+            for (const auto& j : c.reactions) {
+                double propensity = exact_propensity(j);
+                if (propensity <= 0) { continue; }
+                reaction_idx = j;
+                upper_bound += propensity;
+                if (r_a_0 < upper_bound) {
+                    break;
+                }
+            }
         }
+
+        record_pick(reaction_idx);
+        return reaction_at(reaction_idx);
+    }
+
+    /**
+     * Picks a reaction from the vector of reactions (m_reactions) and returns a reference to this reaction
+     * @param random_num a random number generated from a unfiform distribution
+     * @param uniform callable returning further random numbers from the uniform distribution on [0, 1)
+     * @return reference to the reaction that has been chosen
+     */
+    template<typename UniformGenerator>
+    StoSpa2::Reaction& pick_reaction(double random_num, UniformGenerator&& uniform) {
+        if (m_selection_method != SelectionMethod::composition_rejection) {
+            return pick_reaction(random_num);
+        }
+
+        // Scale the randomly chose number to the total propensity, which is exact at the time of the event when
+        // it is integrated
+        if (m_integrated) { a_0 = m_propensity_sum; }
+        double r_a_0 = random_num * a_0;
+
+        check_extrande_bound();
+
+        // Pick a bin of the class and a reaction within it, anything beyond the total propensity is the extrande
+        // reaction
+        unsigned reaction_idx = m_reactions.size();
+        if (r_a_0 < m_propensity_sum) {
+            const auto& c = m_classes[pick_class(r_a_0)];
+            reaction_idx = c.reactions[c.bins.pick(r_a_0, uniform)];
+        }
+
+        record_pick(reaction_idx);
+        return reaction_at(reaction_idx);
     }
 
     /**
@@ -303,12 +1411,15 @@ public:
      * @param stoichiometry_vec vector to be added to m_molecules
      */
     void add_vector(const std::vector<int>& stoichiometry_vec) {
-        for (unsigned i=0; i<stoichiometry_vec.size(); i++) {
-            // Need to be really careful here with not subtracting from zero
-            if (m_molecules[i] + stoichiometry_vec[i] >= 0) {
-                m_molecules[i] += stoichiometry_vec[i];
+        if (m_check_counts) {
+            for (unsigned i=0; i<stoichiometry_vec.size(); i++) {
+                check_count(i, stoichiometry_vec[i], "Voxel::add_vector");
             }
         }
+        for (unsigned i=0; i<stoichiometry_vec.size(); i++) {
+            m_molecules[i] += stoichiometry_vec[i];
+        }
+        update_propensities(stoichiometry_vec);
     }
 
     /**
@@ -316,12 +1427,65 @@ public:
      * @param stoichiometry_vec vector that is subtracted from m_molecules
      */
     void subtract_vector(const std::vector<int>& stoichiometry_vec) {
+        if (m_check_counts) {
+            for (unsigned i=0; i<stoichiometry_vec.size(); i++) {
+                check_count(i, -stoichiometry_vec[i], "Voxel::subtract_vector");
+            }
+        }
         for (unsigned i=0; i<stoichiometry_vec.size(); i++) {
-            // Need to be really careful here with not subtracting from zero
-            if (m_molecules[i] - stoichiometry_vec[i] >= 0) {
-                m_molecules[i] -= stoichiometry_vec[i];
+            m_molecules[i] -= stoichiometry_vec[i];
+        }
+        update_propensities(stoichiometry_vec);
+    }
+
+    /**
+     * Adds the given sparse changes to the m_molecules member variable, only the species that change are updated
+     * @param changes changes in the number of molecules (e.g. Reaction::changes)
+     */
+    void add_changes(const std::vector<StoSpa2::SpeciesChange>& changes) {
+        if (m_check_counts) {
+            for (const auto& change : changes) {
+                check_count(change.species, change.delta, "Voxel::add_changes");
+            }
+        }
+        for (const auto& change : changes) {
+            m_molecules[change.species] += change.delta;
+        }
+        update_propensities(changes);
+    }
+
+    /**
+     * Subtracts the given sparse changes from the m_molecules member variable, only the species that change are
+     * updated
+     * @param changes changes in the number of molecules (e.g. Reaction::changes)
+     */
+    void subtract_changes(const std::vector<StoSpa2::SpeciesChange>& changes) {
+        if (m_check_counts) {
+            for (const auto& change : changes) {
+                check_count(change.species, -change.delta, "Voxel::subtract_changes");
             }
         }
+        for (const auto& change : changes) {
+            m_molecules[change.species] -= change.delta;
+        }
+        update_propensities(changes);
+    }
+
+    /**
+     * Sets whether changes in the number of molecules are checked. Unchecked changes that would make a number
+     * of molecules negative or larger than the largest unsigned integer wrap around, checked changes throw an
+     * exception and leave the molecules unchanged.
+     * @param check whether to check the numbers of molecules
+     */
+    void set_check_counts(bool check) {
+        m_check_counts = check;
+    }
+
+    /**
+     * Returns whether changes in the number of molecules are checked
+     */
+    bool get_check_counts() {
+        return m_check_counts;
     }
 
 
@@ -333,8 +1497,8 @@ public:
      */
     friend std::ostream& operator << (std::ostream& os, const Voxel& v) {
         os << "Voxel object: molecules =";
-        for (const auto& mol : v.m_molecules) {
-            os << " " << mol;
+        for (unsigned i=0; i<v.m_molecules.size(); i++) {
+            os << " " << v.m_molecules[i];
         }
         os << "; voxel_size = " << v.m_voxel_size;
         os << "; growing = " << (v.m_growing ? "true" : "false");
@@ -0,0 +1,85 @@
+// catch2 includes
+#include "catch.hpp"
+
+// stl
+#include <random>
+
+// StoSpa2 includes
+#include "batch_propensity.hpp"
+#include "simulator.hpp"
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing BatchPropensities class") {
+    std::mt19937 gen(153);
+    std::uniform_int_distribution<unsigned> counts(0, 50);
+
+    // Reactions of all orders in each voxel, diffusion to the right is missing in the last voxel
+    std::vector<ss::Voxel> voxels;
+    for (unsigned k=0; k<19; k++) {
+        ss::Voxel v({counts(gen), counts(gen), counts(gen)}, 0.5 + 0.1 * k);
+        v.add_reaction(ss::Reaction::mass_action(1.5, {}, {1, 0, 0}));
+        v.add_reaction(ss::Reaction::mass_action(0.5, {2, 1, 1}, {0, -2, -1}));
+        v.add_reaction(ss::Reaction::mass_action(2.0, {0, 0}, {-2, 1, 0}));
+        v.add_reaction(ss::Reaction::from_expression(0.1, "A*C/V", {"A", "B", "C"}, {-1, 0, 0}));
+        if (k < 18) {
+            v.add_reaction(ss::Reaction::mass_action(3.0, {1}, {0, -1, 0}, k+1));
+        }
+        voxels.push_back(v);
+    }
+
+    SECTION("Testing mass_action_batch") {
+        std::vector<unsigned> x0 = {4, 0, 7, 1, 9, 3, 2, 8, 5, 6, 4000000000u};
+        std::vector<unsigned> x1 = {2, 1, 1, 0, 3, 3, 9, 8, 7, 6, 5};
+        std::vector<double> sizes(x0.size(), 2.0);
+        std::vector<double> output(x0.size());
+        ss::mass_action_batch<2>({{x0.data(), x1.data(), nullptr}}, {{0.0, 0.0, 0.0}}, sizes.data(), x0.size(),
+                                 output.data());
+        for (unsigned t=0; t<x0.size(); t++) {
+            REQUIRE(output[t] == x0[t] * (x1[t] - 0.0) / 2.0);
+        }
+        ss::mass_action_batch<3>({{x0.data(), x0.data(), x0.data()}}, {{0.0, 1.0, 2.0}}, sizes.data(), x0.size(),
+                                 output.data());
+        for (unsigned t=0; t<x0.size(); t++) {
+            REQUIRE(output[t] == x0[t] * (x0[t] - 1.0) * (x0[t] - 2.0) / 4.0);
+        }
+
+        // Counts of consecutive voxels a fixed number of species apart are read in place
+        std::vector<unsigned> x01;
+        for (unsigned t=0; t<x0.size(); t++) {
+            x01.push_back(x0[t]);
+            x01.push_back(x1[t]);
+        }
+        ss::mass_action_batch<2>({{x01.data(), x01.data() + 1, nullptr}}, {{0.0, 0.0, 0.0}}, sizes.data(),
+                                 x0.size(), output.data(), 2);
+        for (unsigned t=0; t<x0.size(); t++) {
+            REQUIRE(output[t] == x0[t] * (x1[t] - 0.0) / 2.0);
+        }
+    }
+
+    SECTION("Testing batch evaluation") {
+        // The propensities evaluated at once are the same as the ones evaluated for each voxel, also when a
+        // voxel with another number of species makes the other voxels gather their counts
+        std::vector<ss::Voxel> mixed(voxels);
+        mixed[5] = ss::Voxel({3, 4, 5, 6}, 1.0);
+        mixed[5].add_reaction(ss::Reaction::mass_action(2.0, {0, 0}, {-2, 1, 0, 0}));
+        for (auto layout : {ss::StoreLayout::voxel_major, ss::StoreLayout::species_major}) {
+            for (bool is_mixed : {false, true}) {
+                // A species-major store needs the same number of species in every voxel
+                if (is_mixed and layout == ss::StoreLayout::species_major) { continue; }
+                ss::Simulator s(is_mixed ? mixed : voxels, 0, ss::QueueType::binary_heap, layout);
+                s.set_seed(153);
+                s.advance(0.5);
+                auto before = s.get_voxels();
+                s.refresh_propensities();
+                auto after = s.get_voxels();
+                for (unsigned k=0; k<after.size(); k++) {
+                    REQUIRE(after[k].get_total_propensity() == before[k].get_total_propensity());
+                    for (unsigned j=0; j<after[k].get_num_reactions(); j++) {
+                        REQUIRE(after[k].get_propensity(j) == before[k].get_propensity(j));
+                    }
+                }
+            }
+        }
+    }
+}
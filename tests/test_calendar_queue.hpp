@@ -0,0 +1,99 @@
+// catch2 includes
+#include "catch.hpp"
+
+// stl
+#include <random>
+
+// StoSpa2 includes
+#include "calendar_queue.hpp"
+#include "event_queue.hpp"
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing CalendarQueue class") {
+    double inf = std::numeric_limits<double>::infinity();
+    ss::CalendarQueue q({3.0, inf, 1.0, inf, 2.0});
+
+    SECTION("Testing Constructor") {
+        REQUIRE(q.size() == 5);
+        REQUIRE(q.top_index() == 2);
+        REQUIRE(q.top_time() == 1.0);
+        REQUIRE(q.get_time(1) == inf);
+        REQUIRE_THROWS(ss::CalendarQueue().top_index());
+    }
+
+    SECTION("Testing member functions") {
+        // Moving the earliest event to a later time
+        q.update(2, 5.0);
+        REQUIRE(q.top_index() == 4);
+        REQUIRE(q.top_time() == 2.0);
+
+        // Infinite times are kept and can become finite again
+        q.update(3, 0.5);
+        REQUIRE(q.top_index() == 3);
+        q.update(3, inf);
+        q.update(4, inf);
+        q.update(0, inf);
+        q.update(2, inf);
+        REQUIRE(q.top_time() == inf);
+        q.update(1, 7.0);
+        REQUIRE(q.top_index() == 1);
+
+        // Ties are broken by the voxel index
+        q.update(0, 7.0);
+        REQUIRE(q.top_index() == 0);
+        q.update(0, 8.0);
+        REQUIRE(q.top_index() == 1);
+
+        // Events far beyond a year of the calendar are found as well
+        q.update(1, 1e6);
+        q.update(0, 1e6 + 1);
+        REQUIRE(q.top_index() == 1);
+    }
+
+    SECTION("Testing against IndexedPriorityQueue") {
+        // Same sequence of operations as in the next subvolume method
+        std::mt19937 gen(153);
+        std::exponential_distribution<double> exponential(1.0);
+        std::uniform_int_distribution<unsigned> voxel(0, 999);
+
+        std::vector<double> times(1000);
+        for (auto& time : times) {
+            time = exponential(gen);
+        }
+        ss::CalendarQueue calendar(times);
+        ss::IndexedPriorityQueue heap(times);
+
+        for (unsigned i=0; i<20000; i++) {
+            REQUIRE(calendar.top_index() == heap.top_index());
+            REQUIRE(calendar.top_time() == heap.top_time());
+            double now = heap.top_time();
+            unsigned idx = heap.top_index();
+            double time = (i % 7 == 0) ? inf : now + exponential(gen);
+            calendar.update(idx, time);
+            heap.update(idx, time);
+
+            unsigned neighbour = voxel(gen);
+            calendar.update(neighbour, now + exponential(gen) * 0.01);
+            heap.update(neighbour, calendar.get_time(neighbour));
+        }
+    }
+}
+
+TEST_CASE("Testing EventQueue class") {
+    ss::EventQueue heap;
+    ss::EventQueue calendar(ss::QueueType::calendar);
+    REQUIRE(heap.get_type() == ss::QueueType::binary_heap);
+    REQUIRE(calendar.get_type() == ss::QueueType::calendar);
+
+    for (auto* q : {&heap, &calendar}) {
+        REQUIRE(q->empty());
+        q->reset({3.0, 1.0, 2.0});
+        REQUIRE(q->size() == 3);
+        REQUIRE(q->top_index() == 1);
+        q->update(1, 4.0);
+        REQUIRE(q->top_index() == 2);
+        REQUIRE(q->top_time() == 2.0);
+        REQUIRE(q->get_time(1) == 4.0);
+    }
+}
@@ -0,0 +1,66 @@
+
+// catch2 includes
+#include "catch.hpp"
+
+// StoSpa2 includes
+#include "composition_rejection.hpp"
+
+// stl
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing CompositionRejection class") {
+    ss::CompositionRejection cr({1.0, 0.0, 3.0, 1000.0, 0.001});
+
+    std::mt19937 gen(153);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    auto uniform = [&gen, &dist]() { return dist(gen); };
+
+    SECTION("Testing Constructor") {
+        REQUIRE(cr.size() == 5);
+        REQUIRE(cr.total() == Approx(1004.001));
+    }
+
+    SECTION("Testing member functions") {
+        // Reactions are picked with probability proportional to their propensities
+        cr.update(3, 4.0);
+        REQUIRE(cr.total() == Approx(8.001));
+
+        std::vector<unsigned> counts(5, 0);
+        unsigned num_samples = 100000;
+        for (unsigned i=0; i<num_samples; i++) {
+            counts[cr.pick(uniform() * cr.total(), uniform)] += 1;
+        }
+        REQUIRE(counts[1] == 0);
+        REQUIRE(counts[0] / (double) num_samples == Approx(1.0 / 8.001).epsilon(0.05));
+        REQUIRE(counts[2] / (double) num_samples == Approx(3.0 / 8.001).epsilon(0.05));
+        REQUIRE(counts[3] / (double) num_samples == Approx(4.0 / 8.001).epsilon(0.05));
+
+        // Propensities that drop to zero are never picked
+        cr.update(3, 0.0);
+        cr.update(1, 2.5);
+        REQUIRE(cr.total() == Approx(6.501));
+        for (unsigned i=0; i<1000; i++) {
+            REQUIRE(cr.pick(uniform() * cr.total(), uniform) != 3);
+        }
+    }
+
+    SECTION("Testing rounding errors") {
+        // The sums of the bins are recomputed from time to time, so that many updates do not make them drift
+        std::vector<double> values(8, 1.0);
+        ss::CompositionRejection drift(values);
+        for (unsigned n=0; n<1000000; n++) {
+            unsigned i = n % values.size();
+            values[i] = 1.0 + uniform() * (1.0 - 1e-12);
+            drift.update(i, values[i]);
+        }
+        double exact = 0;
+        for (const auto& value : values) {
+            exact += value;
+        }
+        REQUIRE(std::abs(drift.total() - exact) <= 1e-14 * exact);
+    }
+}
@@ -0,0 +1,102 @@
+// catch2 includes
+#include "catch.hpp"
+
+// StoSpa2 includes
+#include "ensemble.hpp"
+#include "tau_leap_simulator.hpp"
+
+// stl
+#include <map>
+#include <utility>
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing Ensemble class") {
+    ss::Voxel v({100}, 1.0);
+    v.add_reaction(ss::Reaction::mass_action(0.1, {0}, {-1}));
+    v.add_reaction(ss::Reaction::mass_action(10.0, {}, {1}));
+    ss::Ensemble e({v}, 20, 153, 4);
+
+    SECTION("Testing Constructor") {
+        REQUIRE(e.get_num_replicas() == 20);
+        REQUIRE(e.get_seed() == 153);
+        REQUIRE(e.get_num_threads() == 4);
+        e.set_num_threads(0);
+        REQUIRE(e.get_num_threads() >= 1);
+    }
+
+    SECTION("Testing deterministic seeds") {
+        // Each replica is the same as a simulation with the seed of the replica, whatever the number of threads
+        auto output = e.run(5.0);
+        REQUIRE(output.size() == 20);
+        for (unsigned r=0; r<20; r++) {
+            ss::Simulator s({v});
+            s.set_seed(ss::Ensemble::replica_seed(153, r));
+            s.advance(5.0);
+            REQUIRE(output[r] == s.get_molecules());
+        }
+        e.set_num_threads(1);
+        REQUIRE(e.run(5.0) == output);
+
+        // Replicas and master seeds give different seeds
+        REQUIRE(ss::Ensemble::replica_seed(153, 0) != ss::Ensemble::replica_seed(153, 1));
+        REQUIRE(ss::Ensemble::replica_seed(153, 0) != ss::Ensemble::replica_seed(154, 0));
+        REQUIRE(output[0] != output[1]);
+    }
+
+    SECTION("Testing Philox streams") {
+        // The replicas of a prototype with Philox streams are keyed by the master seed and their index
+        ss::Simulator prototype({v, v});
+        prototype.set_rng_type(ss::RngType::philox);
+        ss::Ensemble philox(prototype, 8, 153, 4);
+        auto output = philox.run(5.0);
+        for (unsigned r=0; r<8; r++) {
+            ss::Simulator s({v, v});
+            s.set_rng_type(ss::RngType::philox);
+            s.set_seed(153, r);
+            REQUIRE(s.get_replica() == r);
+            s.advance(5.0);
+            REQUIRE(output[r] == s.get_molecules());
+        }
+        philox.set_num_threads(1);
+        REQUIRE(philox.run(5.0) == output);
+        REQUIRE(output != e.run(5.0));
+    }
+
+    SECTION("Testing derived simulators") {
+        // The replicas of a tau-leaping prototype are tau-leaping simulations
+        ss::TauLeapSimulator prototype({v});
+        ss::Ensemble leaping(prototype, 4, 153, 2);
+        auto output = leaping.run(5.0);
+        for (unsigned r=0; r<4; r++) {
+            ss::TauLeapSimulator s({v});
+            s.set_seed(153, r);
+            s.advance(5.0);
+            REQUIRE(output[r] == s.get_molecules());
+        }
+        REQUIRE(output != e.run(5.0));
+    }
+
+    SECTION("Testing streamed results") {
+        std::map<std::pair<unsigned, double>, std::vector<unsigned>> streamed;
+        e.run({1.0, 5.0}, [&streamed](const unsigned& replica, const double& time, const std::vector<unsigned>& mols) {
+            streamed[std::make_pair(replica, time)] = mols;
+        });
+        REQUIRE(streamed.size() == 40);
+        auto output = e.run(5.0);
+        for (unsigned r=0; r<20; r++) {
+            REQUIRE(streamed[std::make_pair(r, 5.0)] == output[r]);
+        }
+    }
+
+    SECTION("Testing exceptions") {
+        // An underflow in any replica is rethrown by the calling thread
+        ss::Voxel u({0}, 1.0);
+        u.add_reaction(ss::Reaction(1.0, [](const std::vector<unsigned>& mols, const double& area) { return 1.0; },
+                                    {-1}));
+        ss::Simulator prototype({u});
+        prototype.set_check_counts(true);
+        ss::Ensemble failing(prototype, 8, 153, 4);
+        REQUIRE_THROWS(failing.run(1.0));
+    }
+}
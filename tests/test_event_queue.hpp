@@ -0,0 +1,44 @@
+
+// catch2 includes
+#include "catch.hpp"
+
+// StoSpa2 includes
+#include "event_queue.hpp"
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing IndexedPriorityQueue class") {
+    double inf = std::numeric_limits<double>::infinity();
+    ss::IndexedPriorityQueue q({3.0, inf, 1.0, inf, 2.0});
+
+    SECTION("Testing Constructor") {
+        REQUIRE(q.size() == 5);
+        REQUIRE(q.top_index() == 2);
+        REQUIRE(q.top_time() == 1.0);
+        REQUIRE(q.get_time(1) == inf);
+    }
+
+    SECTION("Testing member functions") {
+        // Moving the earliest event to a later time
+        q.update(2, 5.0);
+        REQUIRE(q.top_index() == 4);
+        REQUIRE(q.top_time() == 2.0);
+
+        // Infinite times are kept and can become finite again
+        q.update(3, 0.5);
+        REQUIRE(q.top_index() == 3);
+        q.update(3, inf);
+        q.update(4, inf);
+        q.update(0, inf);
+        q.update(2, inf);
+        REQUIRE(q.top_time() == inf);
+        q.update(1, 7.0);
+        REQUIRE(q.top_index() == 1);
+
+        // Ties are broken by the voxel index
+        q.update(0, 7.0);
+        REQUIRE(q.top_index() == 0);
+        q.update(0, 8.0);
+        REQUIRE(q.top_index() == 1);
+    }
+}
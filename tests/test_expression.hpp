@@ -0,0 +1,55 @@
+// catch2 includes
+#include "catch.hpp"
+
+// StoSpa2 includes
+#include "expression.hpp"
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing Expression class") {
+    std::vector<unsigned> mols({3, 5, 7});
+    double area = 0.5;
+
+    SECTION("Testing Constructor") {
+        ss::Expression e("A*(A-1)*B/V^2", {"A", "B", "C"});
+        REQUIRE(e.get_text() == "A*(A-1)*B/V^2");
+        REQUIRE(e.get_species() == std::vector<unsigned>({0, 1}));
+        REQUIRE(e.evaluate(mols, area) == Approx(3.0 * 2.0 * 5.0 / (area * area)));
+
+        REQUIRE(ss::Expression().evaluate(mols, area) == 0.0);
+
+        // Errors are reported when the expression is compiled
+        REQUIRE_THROWS(ss::Expression("A*", {"A"}));
+        REQUIRE_THROWS(ss::Expression("A*D", {"A"}));
+        REQUIRE_THROWS(ss::Expression("(A", {"A"}));
+        REQUIRE_THROWS(ss::Expression("A)", {"A"}));
+        REQUIRE_THROWS(ss::Expression("foo(A)", {"A"}));
+        REQUIRE_THROWS(ss::Expression("min(A)", {"A"}));
+        REQUIRE_THROWS(ss::Expression("V", {"V"}));
+    }
+
+    SECTION("Testing operators and functions") {
+        std::vector<std::string> species({"A", "B", "C"});
+        REQUIRE(ss::Expression("A + B - C", species).evaluate(mols, area) == Approx(1.0));
+        REQUIRE(ss::Expression("-A * 2 / B", species).evaluate(mols, area) == Approx(-1.2));
+        REQUIRE(ss::Expression("2^3^2", species).evaluate(mols, area) == Approx(512.0));
+        REQUIRE(ss::Expression("A^-1 + B^0.5", species).evaluate(mols, area) == Approx(1.0/3 + std::sqrt(5.0)));
+        REQUIRE(ss::Expression("2^A", species).evaluate(mols, area) == Approx(8.0));
+        REQUIRE(ss::Expression("1/V", species).evaluate(mols, area) == Approx(2.0));
+        REQUIRE(ss::Expression("exp(log(A)) + sqrt(4)", species).evaluate(mols, area) == Approx(5.0));
+        REQUIRE(ss::Expression("min(A, B) * max(B, C)", species).evaluate(mols, area) == Approx(21.0));
+        REQUIRE(ss::Expression("10 * C^2 / (1e2 + C^2)", species).evaluate(mols, area) == Approx(490.0 / 149.0));
+    }
+
+    SECTION("Testing compilation") {
+        // Constant subexpressions are folded into a single instruction
+        ss::Expression e("2 * (3 + 4) ^ 2", {});
+        REQUIRE(e.get_num_instructions() == 1);
+        REQUIRE(e.evaluate(mols, area) == Approx(98.0));
+
+        // Operations with constants do not need extra registers
+        ss::Expression e2("A*(A-1)/V", {"A"});
+        REQUIRE(e2.get_num_registers() == 2);
+        REQUIRE(e2.evaluate(mols, area) == Approx(12.0));
+    }
+}
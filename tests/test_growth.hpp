@@ -0,0 +1,111 @@
+// catch2 includes
+#include "catch.hpp"
+
+// StoSpa2 includes
+#include "growth.hpp"
+#include "voxel.hpp"
+
+// stl
+#include <cmath>
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing GrowthLaw class") {
+
+    SECTION("Testing closed-form laws") {
+        REQUIRE(ss::GrowthLaw::constant()(3.0) == 1.0);
+        REQUIRE(ss::GrowthLaw::exponential(0.2)(3.0) == std::exp(0.2 * 3.0));
+        REQUIRE(ss::GrowthLaw::linear(0.5)(3.0) == 2.5);
+        auto logistic = ss::GrowthLaw::logistic(1.0, 4.0);
+        REQUIRE(logistic(0.0) == 1.0);
+        REQUIRE(logistic(50.0) == Approx(4.0));
+        REQUIRE(logistic.get_kind() == ss::GrowthKind::logistic);
+        REQUIRE_THROWS(ss::GrowthLaw::logistic(1.0, 0.0));
+
+        // Custom laws call the given function
+        ss::GrowthLaw custom([](const double& t) { return 1.0 + t * t; });
+        REQUIRE(custom(2.0) == 5.0);
+        REQUIRE(custom.get_kind() == ss::GrowthKind::custom);
+    }
+
+    SECTION("Testing piecewise and tabulated laws") {
+        auto piecewise = ss::GrowthLaw::piecewise({0.0, 1.0, 3.0}, {1.0, 3.0, 2.0});
+        REQUIRE(piecewise(-1.0) == 1.0);
+        REQUIRE(piecewise(0.5) == 2.0);
+        REQUIRE(piecewise(2.0) == 2.5);
+        REQUIRE(piecewise(5.0) == 2.0);
+        REQUIRE_THROWS(ss::GrowthLaw::piecewise({0.0, 0.0}, {1.0, 2.0}));
+        REQUIRE_THROWS(ss::GrowthLaw::piecewise({0.0}, {1.0, 2.0}));
+
+        // A tabulated law interpolates the samples of the function
+        auto func = [](const double& t) { return std::exp(0.2 * t); };
+        auto tabulated = ss::GrowthLaw::tabulated(func, 0.0, 10.0, 1001);
+        REQUIRE(tabulated(0.0) == 1.0);
+        REQUIRE(tabulated(10.0) == func(10.0));
+        for (double t=0.0; t<10.0; t+=0.37) {
+            REQUIRE(tabulated(t) == Approx(func(t)).epsilon(1e-5));
+        }
+        REQUIRE(tabulated(20.0) == func(10.0));
+        REQUIRE_THROWS(ss::GrowthLaw::tabulated(func, 0.0, 10.0, 1));
+    }
+
+    SECTION("Testing ranges") {
+        auto range = ss::GrowthLaw::exponential(-0.5).range(0.0, 2.0);
+        REQUIRE(range.first == std::exp(-1.0));
+        REQUIRE(range.second == 1.0);
+
+        // Points inside the interval are extremes of piecewise laws
+        range = ss::GrowthLaw::piecewise({0.0, 1.0, 3.0}, {1.0, 3.0, 2.0}).range(0.5, 2.0);
+        REQUIRE(range.first == 2.0);
+        REQUIRE(range.second == 3.0);
+    }
+
+    SECTION("Testing growth clock") {
+        // Equal laws get the same handle, custom laws are equal only if they are copies of each other or are made
+        // from the same object
+        ss::GrowthClock clock;
+        ss::GrowthLaw custom([](const double& t) { return 1.0 + t; });
+        REQUIRE(clock.add(ss::GrowthLaw::exponential(0.2)) == 0);
+        REQUIRE(clock.add(ss::GrowthLaw::exponential(0.2)) == 0);
+        REQUIRE(clock.add(custom) == 1);
+        REQUIRE(clock.add(ss::GrowthLaw(custom)) == 1);
+        REQUIRE(clock.add(ss::GrowthLaw([](const double& t) { return 1.0 + t; })) == 2);
+        REQUIRE(clock.size() == 3);
+        REQUIRE(clock.get_law(1) == custom);
+
+        // Laws made separately from the same object are equal
+        auto func = [](const double& t) { return 2.0 + t; };
+        REQUIRE(clock.add(ss::GrowthLaw(func, &func)) == 3);
+        REQUIRE(clock.add(ss::GrowthLaw(func, &func)) == 3);
+        REQUIRE(ss::GrowthLaw(func, &func).hash() == ss::GrowthLaw(func, &func).hash());
+
+        // Many distinct laws are told apart by their hashes
+        for (unsigned i=0; i<10000; i++) {
+            clock.add(ss::GrowthLaw::linear(i));
+        }
+        REQUIRE(clock.add(ss::GrowthLaw::linear(5000)) == 5004);
+        REQUIRE(clock.size() == 10004);
+
+        // A law is evaluated again only when the time changes
+        REQUIRE(clock.factor(1, 2.0) == 3.0);
+        REQUIRE(clock.factor(1, 2.0) == 3.0);
+        REQUIRE(clock.get_num_evaluations() == 1);
+        REQUIRE(clock.factor(1, 3.0) == 4.0);
+        REQUIRE(clock.get_num_evaluations() == 2);
+    }
+
+    SECTION("Testing growing voxels") {
+        // A voxel grows the same with a built-in law as with the equivalent function
+        ss::Voxel v1({10}, 1.0, ss::GrowthLaw::exponential(0.2));
+        ss::Voxel v2({10}, 1.0, [](const double& t) { return std::exp(0.2 * t); });
+        std::vector<ss::GrowthLaw> laws = {ss::GrowthLaw::linear(1.0), ss::GrowthLaw::linear(1.0)};
+        ss::Voxel v3({10}, 1.0, laws);
+        REQUIRE(v1.is_growing());
+        v1.update_properties(2.0);
+        v2.update_properties(2.0);
+        v3.update_properties(2.0);
+        REQUIRE(v1.get_voxel_size() == v2.get_voxel_size());
+        REQUIRE(v3.get_voxel_size() == 9.0);
+        REQUIRE(v3.get_diffusion_factor() == 1.0 / 9.0);
+    }
+}
@@ -0,0 +1,84 @@
+
+// catch2 includes
+#include "catch.hpp"
+
+// StoSpa2 includes
+#include "hybrid_simulator.hpp"
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing HybridSimulator class") {
+    auto decay_a = [](const std::vector<unsigned>& mols, const double& area) { return mols[0]; };
+    auto decay_b = [](const std::vector<unsigned>& mols, const double& area) { return mols[1]; };
+    auto prod = [](const std::vector<unsigned>& mols, const double& area) { return area; };
+
+    // Species A has many molecules, while species B has only a few
+    ss::Voxel v({100000, 5}, 1.0);
+    v.add_reaction(ss::Reaction(1.0, decay_a, {-1, 0}));
+    v.add_reaction(ss::Reaction(1.0, prod, {0, 1}));
+    v.add_reaction(ss::Reaction(0.2, decay_b, {0, -1}));
+    ss::HybridSimulator s({v});
+
+    SECTION("Testing Constructor") {
+        REQUIRE(s.get_time() == 0);
+        REQUIRE(s.get_time_step() == 0.01);
+        REQUIRE_THROWS(ss::HybridSimulator({v}, 0.0, 0.0));
+    }
+
+    SECTION("Testing member functions") {
+        s.set_seed(153);
+
+        // Only the decay of species A is fast
+        s.step();
+        REQUIRE(s.get_time() == 0.01);
+        REQUIRE(s.get_num_fast_reactions() == 1);
+
+        // The mean number of molecules of A is 100000 * exp(-1) = 36788
+        s.advance(1.0);
+        REQUIRE(s.get_time() == 1.0);
+        auto vs = s.get_voxels();
+        REQUIRE(vs[0].get_molecules()[0] > 36000);
+        REQUIRE(vs[0].get_molecules()[0] < 37600);
+
+        // Once species A drops below the threshold, its decay is simulated exactly
+        s.advance(10.0);
+        REQUIRE(s.get_num_fast_reactions() == 0);
+    }
+
+    SECTION("Testing diffusion") {
+        std::vector<ss::Voxel> vs(2, ss::Voxel({20000}, 1.0));
+        vs.push_back(ss::Voxel({0}, 1.0));
+        for (unsigned i=0; i<vs.size()-1; i++) {
+            vs[i].add_reaction(ss::Reaction(1.0, decay_a, {-1}, i+1));
+            vs[i+1].add_reaction(ss::Reaction(1.0, decay_a, {-1}, i));
+        }
+        ss::HybridSimulator s2(vs, 0.0, 0.01, 1000, false);
+        s2.set_seed(153);
+        s2.advance(5.0);
+
+        // Diffusion conserves the total number of molecules (up to the fractional parts carried between steps)
+        unsigned total = 0;
+        for (const auto& mol : s2.get_molecules()) {
+            total += mol;
+        }
+        REQUIRE(total >= 39997);
+        REQUIRE(total <= 40000);
+        REQUIRE(s2.get_molecules()[2] > 1000);
+    }
+
+    SECTION("Testing Langevin noise streams") {
+        // The noise of a voxel is drawn from its own Philox stream only, so that the voxel evolves the same
+        // whatever the other voxels of the domain
+        ss::Voxel fast({100000}, 1.0);
+        fast.add_reaction(ss::Reaction(1.0, decay_a, {-1}));
+        ss::HybridSimulator single({fast});
+        ss::HybridSimulator pair({fast, fast});
+        for (auto sim : {&single, &pair}) {
+            sim->set_rng_type(ss::RngType::philox);
+            sim->set_seed(153);
+            sim->advance(0.5);
+        }
+        REQUIRE(single.get_molecules()[0] == pair.get_molecules()[0]);
+        REQUIRE(pair.get_molecules()[0] != pair.get_molecules()[1]);
+    }
+}
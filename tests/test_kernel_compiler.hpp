@@ -0,0 +1,99 @@
+// catch2 includes
+#include "catch.hpp"
+
+// stl
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// StoSpa2 includes
+#include "kernel_compiler.hpp"
+#include "simulator.hpp"
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing KernelCompiler class") {
+    auto decay = [](const std::vector<unsigned>& mols, const double& area) { return (double)mols[0]; };
+    ss::Voxel v({200, 75}, 0.025);
+    v.add_reaction(ss::Reaction::mass_action(0.02, {0}, {-1, 0}));
+    v.add_reaction(ss::Reaction::mass_action(40.0, {}, {1, 0}));
+    v.add_reaction(ss::Reaction::mass_action(6.25e-4, {0, 0, 1}, {1, -1}));
+    v.add_reaction(ss::Reaction::from_expression(120.0, "V * 100 / (100 + B^2)", {"A", "B"}, {0, 1}));
+    v.add_reaction(ss::Reaction(0.5, decay, {-1, 0}));
+    std::vector<ss::Voxel> vs({v, v});
+
+    std::string cache_dir = "/tmp/stospa_kernels_test_" + std::to_string(getpid());
+    ss::KernelCompiler compiler(cache_dir);
+
+    SECTION("Testing generated code") {
+        // Identical propensities share a single function, custom propensity functions are not compiled
+        std::string source = compiler.generate(vs);
+        REQUIRE(source.find("stospa_propensity_3") != std::string::npos);
+        REQUIRE(source.find("stospa_propensity_4") == std::string::npos);
+        REQUIRE(compiler.get_cache_dir() == cache_dir);
+    }
+
+    SECTION("Testing compilation and caching") {
+        auto compiled = compiler.compile(vs);
+        REQUIRE(!compiler.was_cached());
+
+        // The compiled propensities are the same as the original ones
+        auto reactions = compiled[0].get_reactions();
+        auto original = vs[0].get_reactions();
+        REQUIRE(reactions.size() == original.size());
+        std::vector<unsigned> mols({13, 7});
+        for (unsigned j=0; j<reactions.size(); j++) {
+            REQUIRE(reactions[j].is_compiled() == (j < 4));
+            REQUIRE(reactions[j].get_propensity(mols, 0.1) == Approx(original[j].get_propensity(mols, 0.1)));
+            REQUIRE(compiled[1].get_propensity(j) == Approx(vs[1].get_propensity(j)));
+        }
+        REQUIRE(compiled[0].get_total_propensity() == Approx(vs[0].get_total_propensity()));
+
+        // The same model is loaded from the cache and can be simulated
+        ss::KernelCompiler compiler2(cache_dir);
+        auto compiled2 = compiler2.compile(vs);
+        REQUIRE(compiler2.was_cached());
+        REQUIRE(compiler2.get_library_path() == compiler.get_library_path());
+
+        ss::Simulator s(compiled2);
+        s.set_seed(153);
+        s.advance(1.0);
+        REQUIRE(s.get_time() > 1.0);
+
+        std::remove(compiler.get_library_path().c_str());
+        std::string source = compiler.get_library_path();
+        source.replace(source.size() - 3, 3, ".cpp");
+        std::remove(source.c_str());
+        rmdir(cache_dir.c_str());
+    }
+
+    SECTION("Testing compilation errors") {
+        ss::KernelCompiler broken(cache_dir, "false");
+        REQUIRE_THROWS(broken.compile(vs));
+
+        std::string source = broken.get_library_path();
+        source.replace(source.size() - 3, 3, ".cpp");
+        std::remove(source.c_str());
+        rmdir(cache_dir.c_str());
+    }
+
+    SECTION("Testing private cache") {
+        // By default the libraries are cached in a directory of the user
+        setenv("XDG_CACHE_HOME", "/tmp/stospa_cache", 1);
+        unsetenv("STOSPA_KERNEL_CACHE");
+        REQUIRE(ss::KernelCompiler().get_cache_dir() == "/tmp/stospa_cache/stospa/kernels");
+        unsetenv("XDG_CACHE_HOME");
+
+        // A cache that others could write into is rejected before anything is loaded from it
+        mkdir(cache_dir.c_str(), 0700);
+        chmod(cache_dir.c_str(), 0777);
+        REQUIRE_THROWS(compiler.compile(vs));
+        rmdir(cache_dir.c_str());
+
+        // Strings passed to the shell cannot run other commands
+        REQUIRE_THROWS(ss::KernelCompiler(cache_dir, "c++; rm -rf ~"));
+        REQUIRE_THROWS(ss::KernelCompiler(cache_dir, "", "-O3 $(touch x)"));
+        REQUIRE_THROWS(ss::KernelCompiler(cache_dir + "'"));
+    }
+}
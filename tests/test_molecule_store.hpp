@@ -0,0 +1,53 @@
+// catch2 includes
+#include "catch.hpp"
+
+// StoSpa2 includes
+#include "molecule_store.hpp"
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing MoleculeStore class") {
+    ss::MoleculeCounts a({1, 2, 3});
+    ss::MoleculeCounts b({4, 5, 6});
+
+    SECTION("Testing MoleculeCounts") {
+        REQUIRE(a.size() == 3);
+        REQUIRE(a[1] == 2);
+        REQUIRE(!a.is_view());
+        a[1] = 7;
+        a.assign({1, 8, 3});
+        REQUIRE(a.to_vector() == std::vector<unsigned>({1, 8, 3}));
+        REQUIRE(a != b);
+        REQUIRE(a == ss::MoleculeCounts({1, 8, 3}));
+    }
+
+    SECTION("Testing voxel-major layout") {
+        ss::MoleculeStore store({3, 3});
+        store.bind(0, a);
+        store.bind(1, b);
+        REQUIRE(a.is_view());
+        REQUIRE(store.data() == std::vector<unsigned>({1, 2, 3, 4, 5, 6}));
+
+        // Views write into the store and copies own their counts
+        b[2] = 9;
+        ss::MoleculeCounts c = b;
+        c[0] = 0;
+        REQUIRE(!c.is_view());
+        REQUIRE(store.data() == std::vector<unsigned>({1, 2, 3, 4, 5, 9}));
+        REQUIRE(store.to_vector() == store.data());
+    }
+
+    SECTION("Testing species-major layout") {
+        ss::MoleculeStore store({3, 3}, ss::StoreLayout::species_major);
+        store.bind(0, a);
+        store.bind(1, b);
+        REQUIRE(a.stride() == 2);
+        REQUIRE(store.data() == std::vector<unsigned>({1, 4, 2, 5, 3, 6}));
+        REQUIRE(store.to_vector() == std::vector<unsigned>({1, 2, 3, 4, 5, 6}));
+        a[2] = 0;
+        REQUIRE(store.data()[4] == 0);
+        REQUIRE(b.to_vector() == std::vector<unsigned>({4, 5, 6}));
+
+        REQUIRE_THROWS(ss::MoleculeStore({3, 2}, ss::StoreLayout::species_major));
+    }
+}
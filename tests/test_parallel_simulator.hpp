@@ -0,0 +1,142 @@
+// catch2 includes
+#include "catch.hpp"
+
+// StoSpa2 includes
+#include "parallel_simulator.hpp"
+
+// stl
+#include <vector>
+
+namespace ss = StoSpa2;
+
+/**
+ * Returns the number of molecules of a serial simulation after all its events before the given time
+ */
+std::vector<unsigned> serial_molecules(ss::Simulator& s, double time_point) {
+    auto molecules = s.get_molecules();
+    while (s.get_time() < time_point) {
+        molecules = s.get_molecules();
+        s.step();
+    }
+    return molecules;
+}
+
+TEST_CASE("Testing ParallelSimulator class") {
+    // Molecules are produced, decay and diffuse along a line of voxels
+    std::vector<ss::Voxel> vs(24, ss::Voxel({10, 0}, 1.0));
+    for (unsigned i=0; i<vs.size(); i++) {
+        vs[i].add_reaction(ss::Reaction::mass_action(2.0, {}, {1, 0}));
+        vs[i].add_reaction(ss::Reaction::mass_action(0.1, {0, 0}, {-2, 1}));
+        vs[i].add_reaction(ss::Reaction::mass_action(0.5, {1}, {0, -1}));
+        if (i > 0) { vs[i].add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1, 0}, i - 1)); }
+        if (i + 1 < vs.size()) { vs[i].add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1, 0}, i + 1)); }
+    }
+    ss::ParallelSimulator p(vs, 0, 3);
+
+    SECTION("Testing Constructor") {
+        REQUIRE(p.get_num_threads() == 3);
+        REQUIRE(p.get_num_subdomains() == 3);
+        REQUIRE(p.get_rng_type() == ss::RngType::philox);
+        p.set_num_threads(100);
+        REQUIRE(p.get_num_subdomains() == 24);
+        p.set_num_threads(0);
+        REQUIRE(p.get_num_threads() >= 1);
+        REQUIRE_THROWS(p.set_window(-1.0));
+        REQUIRE_THROWS(p.set_window(1.0, 0.0));
+    }
+
+    SECTION("Testing exact events") {
+        // The events are those of the serial simulation with the same Philox streams, whatever the number of
+        // threads and the length of the windows
+        ss::Simulator s(vs);
+        s.set_rng_type(ss::RngType::philox);
+        s.set_seed(153);
+        auto expected = serial_molecules(s, 10.0);
+        for (unsigned num_threads : {1, 2, 3, 4, 7}) {
+            for (double window : {0.0, 0.01, 1.0}) {
+                ss::ParallelSimulator parallel(vs, 0, num_threads);
+                parallel.set_seed(153);
+                parallel.set_window(window);
+                parallel.advance(2.5);
+                REQUIRE(parallel.get_time() == 2.5);
+                parallel.advance(10.0);
+                REQUIRE(parallel.get_time() == 10.0);
+                REQUIRE(parallel.get_molecules() == expected);
+                REQUIRE(parallel.get_num_windows() > 0);
+                REQUIRE(parallel.get_num_rounds() >= parallel.get_num_windows());
+            }
+        }
+
+        // Diffusion across the boundaries of the subdomains makes them roll back
+        p.set_seed(153);
+        p.advance(10.0);
+        REQUIRE(p.get_molecules() == expected);
+        REQUIRE(p.get_num_rounds() > p.get_num_windows());
+        auto rollbacks = p.get_num_rollbacks();
+        REQUIRE(rollbacks.size() == 3);
+        REQUIRE(rollbacks[0] + rollbacks[1] + rollbacks[2] > 0);
+
+        // The serial steps continue from the parallel simulation
+        ss::Simulator s2(vs);
+        s2.set_rng_type(ss::RngType::philox);
+        s2.set_seed(153);
+        expected = serial_molecules(s2, 12.0);
+        p.advance(11.0);
+        p.step();
+        REQUIRE(p.get_time() > 11.0);
+        p.advance(12.0);
+        REQUIRE(p.get_molecules() == expected);
+    }
+
+    SECTION("Testing growing voxels and selection methods") {
+        // Growing voxels are simulated by extrande and their growth laws are evaluated by each thread separately
+        std::vector<ss::Voxel> grow;
+        for (unsigned i=0; i<12; i++) {
+            grow.emplace_back(std::vector<unsigned>({20}), 1.0, [](const double& t) { return 1.0 + 0.1 * t; });
+            grow[i].add_reaction(ss::Reaction::mass_action(5.0, {}, {1}));
+            grow[i].add_reaction(ss::Reaction::mass_action(0.2, {0}, {-1}));
+            grow[i].add_reaction(ss::Reaction::mass_action(2.0, {0}, {-1}, (i + 1) % 12));
+            grow[i].add_reaction(ss::Reaction::mass_action(2.0, {0}, {-1}, (i + 11) % 12));
+        }
+        grow[5].set_rate_schedule(0, {0.0, 2.0}, {5.0, 50.0});
+
+        for (auto method : {ss::SelectionMethod::direct, ss::SelectionMethod::sum_tree,
+                            ss::SelectionMethod::composition_rejection}) {
+            ss::Simulator s(grow);
+            s.set_rng_type(ss::RngType::philox);
+            s.set_seed(42, 3);
+            s.set_selection_method(method);
+            s.set_ratio_tuning(true);
+            auto expected = serial_molecules(s, 5.0);
+
+            ss::ParallelSimulator parallel(grow, 0, 4);
+            parallel.set_seed(42, 3);
+            parallel.set_selection_method(method);
+            parallel.set_ratio_tuning(true);
+            parallel.advance(5.0);
+            REQUIRE(parallel.get_molecules() == expected);
+            REQUIRE(parallel.get_num_growth_laws() == s.get_num_growth_laws());
+
+            // A copy continues with the same events
+            ss::ParallelSimulator copy(parallel);
+            copy.advance(8.0);
+            parallel.advance(8.0);
+            REQUIRE(copy.get_molecules() == parallel.get_molecules());
+            REQUIRE(copy.get_rng_counters() == parallel.get_rng_counters());
+        }
+    }
+
+    SECTION("Testing errors") {
+        // The Philox streams are needed
+        p.set_rng_type(ss::RngType::mt19937);
+        REQUIRE_THROWS(p.advance(1.0));
+
+        // An exception thrown by one thread stops all of them and is rethrown
+        auto always = [](const std::vector<unsigned>& mols, const double& area) { return 1.0; };
+        std::vector<ss::Voxel> underflow(vs);
+        underflow[17].add_reaction(ss::Reaction(1.0, always, {0, -1}));
+        ss::ParallelSimulator parallel(underflow, 0, 3);
+        parallel.set_check_counts(true);
+        REQUIRE_THROWS(parallel.advance(100.0));
+    }
+}
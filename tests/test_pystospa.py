@@ -1,6 +1,8 @@
 #!/usr/bin/env python
 
+import os
 import pystospa
+import tempfile
 import unittest
 
 
@@ -25,6 +27,34 @@ class TestReaction(unittest.TestCase):
         # Check that the correct propensity is returned
         self.assertEqual(r.get_propensity([10], 1.0), 1.55)
 
+        # Check that the species on which the propensity depends can be set
+        r.set_dependencies([0])
+        self.assertEqual(r.get_dependencies(), [0])
+
+    def test_mass_action(self):
+        # Create a mass-action reaction for dimerisation
+        r = pystospa.Reaction.mass_action(2.0, [1, 1], [0, -2])
+
+        # Check that the propensity is evaluated without a propensity function
+        self.assertEqual(r.get_kind(), pystospa.ReactionKind.second_order)
+        self.assertEqual(r.get_reactants(), [1, 1])
+        self.assertEqual(r.get_dependencies(), [1])
+        self.assertAlmostEqual(r.get_propensity([3, 5], 0.5), 2.0 * 5 * 4 / 0.5)
+
+    def test_expression(self):
+        # Create a reaction whose propensity is given as an expression
+        r = pystospa.Reaction.from_expression(2.0, "A*(A-1)*B/V^2", ["A", "B"], [1, -1])
+
+        # Check that the propensity is evaluated without a Python function
+        self.assertEqual(r.get_kind(), pystospa.ReactionKind.expression)
+        self.assertEqual(r.get_expression(), "A*(A-1)*B/V^2")
+        self.assertEqual(r.get_dependencies(), [0, 1])
+        self.assertAlmostEqual(r.get_propensity([3, 5], 0.5), 2.0 * 3 * 2 * 5 / 0.25)
+
+        # Check that invalid expressions are reported
+        with self.assertRaises(RuntimeError):
+            pystospa.Reaction.from_expression(2.0, "A*C", ["A", "B"], [1, -1])
+
 
 class TestVoxel(unittest.TestCase):
 
@@ -51,6 +81,98 @@ class TestVoxel(unittest.TestCase):
         self.assertEqual(rs[0].get_rate(), 1.5)
         self.assertEqual(v.get_total_propensity(), 15)
 
+    def test_check_count(self):
+
+        # A reaction that removes more molecules than there are raises an exception when checked
+        v = pystospa.Voxel([0], 1.0)
+        v.add_reaction(pystospa.Reaction(1.0, lambda x,y : 1.0, [-1]))
+        self.assertFalse(v.get_check_counts())
+        s = pystospa.Simulator([v])
+        s.set_check_counts(True)
+        self.assertRaises(RuntimeError, s.step)
+
+        # So does a reaction that adds more molecules than an unsigned integer holds
+        v = pystospa.Voxel([2**32 - 1], 1.0)
+        v.add_reaction(pystospa.Reaction(1.0, lambda x,y : 1.0, [1]))
+        v.set_check_counts(True)
+        self.assertTrue(v.get_check_counts())
+        s = pystospa.Simulator([v])
+        self.assertRaises(RuntimeError, s.step)
+
+
+    def test_growth(self):
+
+        # Growth slows down diffusion, but leaves the rates of the reactions unchanged
+        v = pystospa.Voxel([100], 1.0, lambda t : 1.0 + t)
+        v.add_reaction(pystospa.Reaction.mass_action(1.0, [0], [-1], 1))
+        s = pystospa.Simulator([v, pystospa.Voxel([0], 1.0)])
+        s.advance(0.5)
+        g = s.get_voxels()[0]
+        self.assertLess(g.get_diffusion_factor(), 1.0)
+        self.assertEqual(g.get_diffusion_factor(), 1.0 / (g.get_voxel_size() * g.get_voxel_size()))
+        self.assertEqual(g.get_reactions()[0].get_rate(), 1.0)
+
+    def test_look_ahead(self):
+
+        # Bounds over a look-ahead window are used instead of the extrande ratio
+        v = pystospa.Voxel([100], 1.0, lambda t : 1.0 + t)
+        v.add_reaction(pystospa.Reaction.mass_action(1.0, [0], [-1], 1))
+        s = pystospa.Simulator([v, pystospa.Voxel([0], 1.0)])
+        s.set_look_ahead(0.5)
+        self.assertEqual(s.get_voxels()[0].get_look_ahead(), 0.5)
+        s.advance(1.0)
+        self.assertEqual(sum(s.get_molecules()), 100)
+
+    def test_extrande_statistics(self):
+
+        # Accepted and rejected events are counted, the tuned ratio keeps the rejections near the target
+        v = pystospa.Voxel([0], 1.0, pystospa.GrowthLaw.exponential(0.1), 5.0)
+        v.add_reaction(pystospa.Reaction.mass_action(10.0, [], [1]))
+        s = pystospa.Simulator([v])
+        s.set_ratio_tuning(True, 0.2)
+        s.advance(10.0)
+        self.assertEqual(s.get_num_accepted()[0], s.get_molecules()[0])
+        self.assertGreater(s.get_num_rejected()[0], 0)
+        self.assertLess(s.get_extrande_ratios()[0], 5.0)
+        s.reset_extrande_statistics()
+        self.assertEqual(s.get_num_rejected(), [0])
+
+    def test_integrated_hazard(self):
+
+        # Event times are sampled without rejections, a scheduled input switches production on at time 1
+        v = pystospa.Voxel([0], 1.0, pystospa.GrowthLaw.exponential(0.5))
+        v.add_reaction(pystospa.Reaction.mass_action(10.0, [], [1]))
+        v.set_rate_schedule(0, [0.0, 1.0], [0.0, 10.0])
+        v.set_integrated_hazard(True)
+        self.assertTrue(v.get_integrated_hazard())
+        s = pystospa.Simulator([v])
+        s.advance(0.999)
+        self.assertEqual(s.get_molecules(), [0])
+        s.advance(2.0)
+        self.assertGreater(s.get_molecules()[0], 0)
+        self.assertEqual(s.get_num_rejected(), [0])
+
+    def test_growth_laws(self):
+
+        # Built-in growth laws give the same voxel sizes as the equivalent lambda functions
+        g = pystospa.GrowthLaw.exponential(0.2)
+        self.assertEqual(g.get_kind(), pystospa.GrowthKind.exponential)
+        t = pystospa.GrowthLaw.tabulated(lambda t : 1.0 + t, 0.0, 10.0, 11)
+        self.assertAlmostEqual(t(2.5), 3.5)
+        self.assertEqual(pystospa.GrowthLaw.piecewise([0.0, 1.0], [1.0, 2.0])(0.5), 1.5)
+        v = pystospa.Voxel([100], 1.0, g)
+        v.add_reaction(pystospa.Reaction.mass_action(1.0, [0], [-1], 1))
+        s = pystospa.Simulator([v, pystospa.Voxel([0], 1.0, [g])])
+        s.advance(1.0)
+        self.assertGreater(s.get_voxels()[0].get_voxel_size(), 1.0)
+        self.assertEqual(s.get_num_growth_laws(), 1)
+
+        # Voxels built from the same lambda function share a single law
+        f = lambda t : 1.0 + 0.1 * t
+        s = pystospa.Simulator([pystospa.Voxel([10], 1.0, f) for i in range(100)])
+        self.assertEqual(s.get_num_growth_laws(), 1)
+        s = pystospa.Simulator([pystospa.Voxel([10], 1.0, [f, f]), pystospa.Voxel([10], 1.0, pystospa.GrowthLaw(f))])
+        self.assertEqual(s.get_num_growth_laws(), 1)
 
 class TestSimulator(unittest.TestCase):
 
@@ -85,6 +207,187 @@ class TestSimulator(unittest.TestCase):
         s.advance(1.0)
         self.assertGreater(s.get_time(), 1.0)
 
+    def test_rng_types(self):
+
+        # Philox streams are keyed by the seed and the replica and count the values drawn
+        v = pystospa.Voxel([10], 1.0)
+        v.add_reaction(pystospa.Reaction.mass_action(1.5, [0], [-1]))
+        s = pystospa.Simulator([v])
+        s.set_rng_type(pystospa.RngType.philox)
+        s.set_seed(153, 2)
+        self.assertEqual(s.get_rng_type(), pystospa.RngType.philox)
+        self.assertEqual(s.get_replica(), 2)
+        self.assertEqual(s.get_rng_counters(), [2, 0])
+        s.step()
+        self.assertEqual(s.get_rng_counters(), [6, 0])
+
+    def test_queue_types(self):
+
+        # Create a Simulator object that uses a calendar queue
+        v = pystospa.Voxel([10], 1.0)
+        v.add_reaction(pystospa.Reaction(1.5, lambda x,y : x[0], [-1]))
+        s = pystospa.Simulator([v, v], 0.0, pystospa.QueueType.calendar)
+        self.assertEqual(s.get_queue_type(), pystospa.QueueType.calendar)
+
+        # Check that all the molecules decay
+        s.advance(100.0)
+        self.assertEqual(s.get_molecules(), [0, 0])
+
+    def test_store_layouts(self):
+
+        # The species-major store holds a single species of all the voxels next to each other
+        v = pystospa.Voxel([10, 0], 1.0)
+        v.add_reaction(pystospa.Reaction.mass_action(1.0, [0], [-1, 1]))
+        s = pystospa.Simulator([v, v], 0.0, pystospa.QueueType.binary_heap, pystospa.StoreLayout.species_major)
+        self.assertEqual(s.get_store_layout(), pystospa.StoreLayout.species_major)
+        self.assertEqual(s.get_molecule_store(), [10, 10, 0, 0])
+        self.assertEqual(s.get_molecules(), [10, 0, 10, 0])
+
+        # Re-evaluating all the propensities at once gives the same total propensity
+        s.refresh_propensities()
+        self.assertEqual(s.get_voxels()[1].get_total_propensity(False), 10.0)
+
+    def test_shared_reactions(self):
+
+        # The same reaction in all the voxels has a single definition
+        v = pystospa.Voxel([10], 1.0)
+        v.add_reaction(pystospa.Reaction.mass_action(1.5, [0], [-1]))
+        s = pystospa.Simulator([v, v, v])
+        self.assertEqual(s.get_num_reaction_definitions(), 1)
+        r = s.get_voxels()[0].get_reactions()[0]
+        self.assertTrue(r.shares_definition(s.get_voxels()[2].get_reactions()[0]))
+
+
+class TestTauLeapSimulator(unittest.TestCase):
+
+    def test_member_functions(self):
+
+        # Create a TauLeapSimulator object
+        v = pystospa.Voxel([10000], 1.0)
+        v.add_reaction(pystospa.Reaction(1.0, lambda x,y : x[0], [-1]))
+        s = pystospa.TauLeapSimulator([v])
+        s.set_seed(153)
+
+        # Check that getting to specific time point works
+        s.advance(1.0)
+        self.assertEqual(s.get_time(), 1.0)
+        self.assertLess(s.get_voxels()[0].get_molecules()[0], 10000)
+
+
+class TestHybridSimulator(unittest.TestCase):
+
+    def test_member_functions(self):
+
+        # Create a HybridSimulator object
+        v = pystospa.Voxel([100000], 1.0)
+        v.add_reaction(pystospa.Reaction(1.0, lambda x,y : x[0], [-1]))
+        s = pystospa.HybridSimulator([v])
+        s.set_seed(153)
+
+        # Check that the decay is integrated as continuous
+        s.step()
+        self.assertEqual(s.get_num_fast_reactions(), 1)
+
+        # Check that getting to specific time point works
+        s.advance(1.0)
+        self.assertEqual(s.get_time(), 1.0)
+        self.assertLess(s.get_voxels()[0].get_molecules()[0], 100000)
+
+
+class TestParallelSimulator(unittest.TestCase):
+
+    def test_member_functions(self):
+
+        # Create voxels on a line with diffusion between neighbours
+        vs = [pystospa.Voxel([10], 1.0) for i in range(8)]
+        for i in range(8):
+            vs[i].add_reaction(pystospa.Reaction.mass_action(1.0, [], [1]))
+            vs[i].add_reaction(pystospa.Reaction.mass_action(0.1, [0], [-1]))
+            if i > 0:
+                vs[i].add_reaction(pystospa.Reaction.mass_action(1.0, [0], [-1], i - 1))
+            if i < 7:
+                vs[i].add_reaction(pystospa.Reaction.mass_action(1.0, [0], [-1], i + 1))
+        p = pystospa.ParallelSimulator(vs, 0, 2)
+        p.set_seed(153)
+        self.assertEqual(p.get_num_subdomains(), 2)
+        self.assertEqual(p.get_rng_type(), pystospa.RngType.philox)
+
+        # Check that the events are those of a serial simulation with the Philox streams
+        p.advance(5.0)
+        self.assertEqual(p.get_time(), 5.0)
+        s = pystospa.Simulator(vs)
+        s.set_rng_type(pystospa.RngType.philox)
+        s.set_seed(153)
+        expected = s.get_molecules()
+        while s.get_time() < 5.0:
+            expected = s.get_molecules()
+            s.step()
+        self.assertEqual(p.get_molecules(), expected)
+
+    def test_run(self):
+
+        # The threads call propensities given as Python functions while the simulation runs
+        vs = [pystospa.Voxel([10], 1.0) for i in range(4)]
+        for i in range(4):
+            vs[i].add_reaction(pystospa.Reaction(0.1, lambda x,y : x[0], [-1]))
+            vs[i].add_reaction(pystospa.Reaction.mass_action(1.0, [0], [-1], (i + 1) % 4))
+        p = pystospa.ParallelSimulator(vs, 0, 2)
+        p.set_seed(153)
+        with tempfile.TemporaryDirectory() as directory:
+            p.run(os.path.join(directory, "parallel.dat"), 0.5, 5)
+            with open(os.path.join(directory, "parallel.dat")) as handle:
+                self.assertEqual(len(handle.readlines()), 6)
+        self.assertEqual(p.get_time(), 2.0)
+
+
+class TestEnsemble(unittest.TestCase):
+
+    def test_run(self):
+
+        # Replicas are the same as simulations with the seeds of the replicas
+        v = pystospa.Voxel([100], 1.0)
+        v.add_reaction(pystospa.Reaction.mass_action(0.1, [0], [-1]))
+        e = pystospa.Ensemble([v], 8, 153, 2)
+        self.assertEqual(e.get_num_replicas(), 8)
+        output = e.run(5.0)
+        s = pystospa.Simulator([v])
+        s.set_seed(pystospa.Ensemble.replica_seed(153, 3))
+        s.advance(5.0)
+        self.assertEqual(output[3], s.get_molecules())
+
+        # Results are streamed as soon as each time is reached
+        streamed = {}
+        e.run([1.0, 5.0], lambda r, t, mols : streamed.__setitem__((r, t), mols))
+        self.assertEqual(len(streamed), 16)
+        self.assertEqual(streamed[(3, 5.0)], output[3])
+
+        # Replicas of a tau-leaping simulator are tau-leaping simulations
+        output = pystospa.Ensemble(pystospa.TauLeapSimulator([v]), 8, 153, 2).run(5.0)
+        s = pystospa.TauLeapSimulator([v])
+        s.set_seed(153, 3)
+        s.advance(5.0)
+        self.assertEqual(output[3], s.get_molecules())
+
+class TestKernelCompiler(unittest.TestCase):
+
+    def test_member_functions(self):
+
+        # Create voxels with mass-action and expression reactions
+        v = pystospa.Voxel([100, 10], 1.0)
+        v.add_reaction(pystospa.Reaction.mass_action(1.0, [0], [-1, 0]))
+        v.add_reaction(pystospa.Reaction.from_expression(2.0, "A*B/V", ["A", "B"], [0, -1]))
+
+        # Check that the compiled propensities are the same
+        with tempfile.TemporaryDirectory() as cache_dir:
+            compiler = pystospa.KernelCompiler(cache_dir)
+            vs = compiler.compile([v])
+            self.assertTrue(os.path.exists(compiler.get_library_path()))
+            self.assertAlmostEqual(vs[0].get_total_propensity(), v.get_total_propensity())
+
+            # Check that the library is found in the cache
+            compiler.compile([v])
+            self.assertTrue(compiler.was_cached())
+
 
 if __name__ == '__main__':
     unittest.main()
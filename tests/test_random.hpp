@@ -0,0 +1,70 @@
+// catch2 includes
+#include "catch.hpp"
+
+// StoSpa2 includes
+#include "random.hpp"
+
+// stl
+#include <cstdint>
+#include <vector>
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing RandomStreams class") {
+
+    SECTION("Testing Philox4x32-10") {
+        // Known answers of the reference implementation
+        auto zero = ss::philox4x32({{0, 0, 0, 0}}, {{0, 0}});
+        REQUIRE(zero == std::array<std::uint32_t, 4>({{0x6627e8d5u, 0xe169c58du, 0xbc57ac4cu, 0x9b00dbd8u}}));
+        auto ones = ss::philox4x32({{0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu}},
+                                   {{0xffffffffu, 0xffffffffu}});
+        REQUIRE(ones == std::array<std::uint32_t, 4>({{0x408f276du, 0x41c83b0eu, 0xa20bc7c6u, 0x6d5451fdu}}));
+        auto pi = ss::philox4x32({{0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u}},
+                                 {{0xa4093822u, 0x299f31d0u}});
+        REQUIRE(pi == std::array<std::uint32_t, 4>({{0xd16cfe09u, 0x94fdccebu, 0x5001e420u, 0x24126ea1u}}));
+    }
+
+    SECTION("Testing independent streams") {
+        // The values of a stream do not depend on the draws from other streams
+        ss::RandomStreams a;
+        ss::RandomStreams b;
+        a.seed(ss::RngType::philox, 153, 2, 3);
+        b.seed(ss::RngType::philox, 153, 2, 3);
+        REQUIRE(a.get_type() == ss::RngType::philox);
+        std::vector<std::uint32_t> first;
+        std::vector<std::uint32_t> second;
+        for (unsigned n=0; n<10; n++) {
+            first.push_back(a.next(0));
+            a.next(1);
+            a.next(1);
+        }
+        for (unsigned n=0; n<10; n++) {
+            second.push_back(b.next(0));
+        }
+        REQUIRE(first == second);
+        REQUIRE(a.next(2) != a.next(2));
+
+        // Other replicas and seeds give other values
+        b.seed(ss::RngType::philox, 153, 3, 3);
+        REQUIRE(b.next(0) != first[0]);
+        b.seed(ss::RngType::philox, 154, 2, 3);
+        REQUIRE(b.next(0) != first[0]);
+    }
+
+    SECTION("Testing checkpoints") {
+        // Restoring the counters repeats the values drawn after they were saved
+        ss::RandomStreams a;
+        a.seed(ss::RngType::philox, 153, 0, 2);
+        for (unsigned n=0; n<7; n++) { a.next(n % 2); }
+        auto counters = a.get_counters();
+        REQUIRE(counters == std::vector<std::uint64_t>({4, 3}));
+        std::vector<std::uint32_t> values = {a.next(0), a.next(1), a.next(1)};
+        a.set_counters(counters);
+        REQUIRE(values == std::vector<std::uint32_t>({a.next(0), a.next(1), a.next(1)}));
+        REQUIRE_THROWS(a.set_counters({1}));
+
+        // The Mersenne twister has no counters
+        a.seed(ss::RngType::mt19937, 153, 0, 2);
+        REQUIRE_THROWS(a.get_counters());
+    }
+}
@@ -25,10 +25,102 @@ TEST_CASE("Testing Reacton class") {
 
         double propensity = r.get_propensity({10}, 1.0);
         REQUIRE(propensity == 1.55);
+
+        REQUIRE(!r.has_dependencies());
+        r.set_dependencies({});
+        REQUIRE(r.has_dependencies());
+        REQUIRE(r.get_dependencies().empty());
     }
 
     SECTION("Testing member operators") {
         ss::Reaction r2(0.0, constant_func, {0});
         REQUIRE(r == r2);
     }
+
+    SECTION("Testing mass-action reactions") {
+        REQUIRE(r.get_kind() == ss::ReactionKind::custom);
+
+        auto r0 = ss::Reaction::mass_action(2.0, {}, {1, 0, 0});
+        auto r1 = ss::Reaction::mass_action(2.0, {1}, {0, -1, 0});
+        auto r2 = ss::Reaction::mass_action(2.0, {2, 0}, {0, 0, 0});
+        auto r2_dimer = ss::Reaction::mass_action(2.0, {1, 1}, {0, -2, 0});
+        auto r3 = ss::Reaction::mass_action(2.0, {1, 0, 1}, {1, -1, 0});
+        REQUIRE(r0.get_kind() == ss::ReactionKind::zeroth_order);
+        REQUIRE(r1.get_kind() == ss::ReactionKind::first_order);
+        REQUIRE(r2.get_kind() == ss::ReactionKind::second_order);
+        REQUIRE(r3.get_kind() == ss::ReactionKind::third_order);
+        REQUIRE_THROWS(ss::Reaction::mass_action(2.0, {0, 0, 0, 0}, {-1}));
+
+        // Reactants are sorted and the reactions only depend on them
+        REQUIRE(r3.get_reactants() == std::vector<unsigned>({0, 1, 1}));
+        REQUIRE(r3.get_dependencies() == std::vector<unsigned>({0, 1}));
+        REQUIRE(r0.get_dependencies().empty());
+        REQUIRE(r0.has_dependencies());
+
+        // The propensities are the same as those of the corresponding propensity functions
+        std::vector<unsigned> mols({3, 5, 7});
+        double area = 0.5;
+        REQUIRE(r0.get_propensity(mols, area) == Approx(2.0 * area));
+        REQUIRE(r1.get_propensity(mols, area) == Approx(2.0 * 5));
+        REQUIRE(r2.get_propensity(mols, area) == Approx(2.0 * 3 * 7 / area));
+        REQUIRE(r2_dimer.get_propensity(mols, area) == Approx(2.0 * 5 * 4 / area));
+        REQUIRE(r3.get_propensity(mols, area) == Approx(2.0 * 3 * 5 * 4 / (area * area)));
+
+        // Too few molecules to react
+        REQUIRE(r2_dimer.get_propensity({0, 1, 0}, area) == 0.0);
+        REQUIRE(r2_dimer.get_propensity({0, 0, 0}, area) == 0.0);
+        REQUIRE(r3.get_propensity({3, 1, 0}, area) == 0.0);
+
+        auto custom = ss::Reaction(2.0, [](const std::vector<unsigned>& mols, const double& area) {
+            return (double)mols[1];
+        }, {0, -1, 0});
+        REQUIRE(custom != r1);
+        REQUIRE(r1 == ss::Reaction::mass_action(2.0, {1}, {0, -1, 0}));
+    }
+
+    SECTION("Testing expression reactions") {
+        auto r_expr = ss::Reaction::from_expression(2.0, "A*(A-1)*C/V^2", {"A", "B", "C"}, {-1, 0, 0});
+        REQUIRE(r_expr.get_kind() == ss::ReactionKind::expression);
+        REQUIRE(r_expr.get_expression() == "A*(A-1)*C/V^2");
+        REQUIRE(r_expr.get_dependencies() == std::vector<unsigned>({0, 2}));
+        REQUIRE(r_expr.get_propensity({3, 5, 7}, 0.5) == Approx(2.0 * 3 * 2 * 7 / 0.25));
+        REQUIRE(r_expr.get_propensity({1, 5, 7}, 0.5) == 0.0);
+
+        // Copies share the compiled expression
+        auto r_copy = r_expr;
+        r_copy.set_rate(4.0);
+        REQUIRE(r_copy.get_propensity({3, 5, 7}, 0.5) == Approx(2.0 * r_expr.get_propensity({3, 5, 7}, 0.5)));
+        REQUIRE(r_expr != r);
+        REQUIRE_THROWS(ss::Reaction::from_expression(2.0, "A*", {"A"}, {-1}));
+    }
+
+    SECTION("Testing shared definitions") {
+        // Copies share the definition until the dependencies are changed
+        auto r_copy = r;
+        REQUIRE(r_copy.shares_definition(r));
+        r_copy.set_dependencies({0});
+        REQUIRE(!r_copy.shares_definition(r));
+        REQUIRE(r_copy.has_dependencies());
+        REQUIRE(!r.has_dependencies());
+        REQUIRE(r_copy.stoichiometry == r.stoichiometry);
+
+        // Equal mass-action reactions are interned once, the rate and diffusion index stay per reaction
+        ss::ReactionTable table;
+        auto r1 = table.share(ss::Reaction::mass_action(1.0, {0}, {-1}, 3));
+        auto r2 = table.share(ss::Reaction::mass_action(2.0, {0}, {-1}, 5));
+        auto r3 = table.share(ss::Reaction::mass_action(1.0, {0, 0}, {-1}));
+        REQUIRE(table.size() == 2);
+        REQUIRE(r1.shares_definition(r2));
+        REQUIRE(!r1.shares_definition(r3));
+        REQUIRE(r2.get_rate() == 2.0);
+        REQUIRE(r2.diffusion_idx == 5);
+        REQUIRE(r2.get_propensity({4}, 1.0) == 8.0);
+
+        // Custom reactions are only shared with their copies
+        auto r4 = table.share(r);
+        REQUIRE(table.share(r_copy).shares_definition(r_copy));
+        REQUIRE(table.share(ss::Reaction(1.5, constant_func, {0})).shares_definition(r4) == false);
+        REQUIRE(table.share(r).shares_definition(r4));
+        REQUIRE(table.size() == 5);
+    }
 }
@@ -5,6 +5,9 @@
 // StoSpa2 includes
 #include "simulator.hpp"
 
+// stl
+#include <cmath>
+
 namespace ss = StoSpa2;
 
 TEST_CASE("Testing Simulator class") {
@@ -34,4 +37,248 @@ TEST_CASE("Testing Simulator class") {
         s.advance(1.0);
         REQUIRE(s.get_time() > 1.0);
     }
+
+    SECTION("Testing voxels with zero propensity") {
+        // Several voxels have infinite times until the next reaction, none of them can be lost
+        ss::Voxel empty({0}, 1.0);
+        empty.add_reaction(ss::Reaction(1.5, decay, {-1}));
+        ss::Simulator s2({empty, empty, v, empty});
+        s2.set_seed(153);
+
+        s2.advance(100.0);
+        auto vs = s2.get_voxels();
+        REQUIRE(vs[2].get_molecules()[0] == 0);
+        REQUIRE(vs[0].get_molecules()[0] == 0);
+        REQUIRE(s2.get_time() == std::numeric_limits<double>::infinity());
+    }
+
+    SECTION("Testing selection methods") {
+        s.set_selection_method(ss::SelectionMethod::sum_tree);
+        auto vs = s.get_voxels();
+        REQUIRE(vs[0].get_selection_method() == ss::SelectionMethod::sum_tree);
+
+        s.advance(100.0);
+        auto vs2 = s.get_voxels();
+        REQUIRE(vs2[0].get_molecules()[0] == 0);
+
+        ss::Simulator s2({v});
+        s2.set_selection_method(ss::SelectionMethod::composition_rejection);
+        s2.advance(100.0);
+        auto vs3 = s2.get_voxels();
+        REQUIRE(vs3[0].get_molecules()[0] == 0);
+    }
+
+    SECTION("Testing queue types") {
+        REQUIRE(s.get_queue_type() == ss::QueueType::binary_heap);
+
+        // Both data structures give the same trajectory for the same seed
+        ss::Voxel empty({0}, 1.0);
+        std::vector<ss::Voxel> vs({v, empty, empty, v});
+        auto diffusion = [](const std::vector<unsigned>& mols, const double& area) { return mols[0]; };
+        for (unsigned i=0; i<vs.size()-1; i++) {
+            vs[i].add_reaction(ss::Reaction(1.0, diffusion, {-1}, i+1));
+            vs[i+1].add_reaction(ss::Reaction(1.0, diffusion, {-1}, i));
+        }
+        ss::Simulator heap(vs);
+        ss::Simulator calendar(vs, 0, ss::QueueType::calendar);
+        REQUIRE(calendar.get_queue_type() == ss::QueueType::calendar);
+        heap.set_seed(153);
+        calendar.set_seed(153);
+
+        heap.advance(5.0);
+        calendar.advance(5.0);
+        REQUIRE(heap.get_time() == calendar.get_time());
+        REQUIRE(heap.get_molecules() == calendar.get_molecules());
+    }
+
+    SECTION("Testing molecule store layouts") {
+        REQUIRE(s.get_store_layout() == ss::StoreLayout::voxel_major);
+
+        // Both layouts give the same trajectory for the same seed
+        auto r = ss::Reaction::mass_action(1.0, {0}, {-1, 1});
+        ss::Voxel w({10, 0}, 1.0);
+        w.add_reaction(r);
+        std::vector<ss::Voxel> vs(4, w);
+        for (unsigned i=0; i<vs.size()-1; i++) {
+            vs[i].add_reaction(ss::Reaction::mass_action(1.0, {1}, {0, -1}, i+1));
+        }
+        ss::Simulator voxel_major(vs);
+        ss::Simulator species_major(vs, 0, ss::QueueType::binary_heap, ss::StoreLayout::species_major);
+        REQUIRE(species_major.get_molecule_store() == std::vector<unsigned>({10, 10, 10, 10, 0, 0, 0, 0}));
+        voxel_major.set_seed(153);
+        species_major.set_seed(153);
+        voxel_major.advance(2.0);
+        species_major.advance(2.0);
+        REQUIRE(voxel_major.get_molecules() == species_major.get_molecules());
+        REQUIRE(voxel_major.get_molecule_store() == voxel_major.get_molecules());
+
+        // Voxels returned by the simulator are copies of the state in the store
+        auto voxels = species_major.get_voxels();
+        REQUIRE(voxels[3].get_molecules()[1] == species_major.get_molecule_store()[7]);
+
+        // A copy of a simulator continues independently
+        ss::Simulator copy(voxel_major);
+        copy.advance(4.0);
+        REQUIRE(voxel_major.get_time() < 4.0);
+        REQUIRE(voxel_major.get_molecule_store() == voxel_major.get_molecules());
+        REQUIRE(copy.get_molecule_store() == copy.get_molecules());
+    }
+
+    SECTION("Testing shared reaction definitions") {
+        // The same reaction added to all the voxels has a single definition
+        std::vector<ss::Voxel> vs(10, v);
+        for (unsigned i=0; i<vs.size(); i++) {
+            vs[i].add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1}, (i + 1) % vs.size()));
+        }
+        ss::Simulator shared(vs);
+        REQUIRE(shared.get_num_reaction_definitions() == 2);
+        auto voxels = shared.get_voxels();
+        auto reactions = voxels[3].get_reactions();
+        REQUIRE(reactions[1].diffusion_idx == 4);
+        REQUIRE(reactions[1].shares_definition(voxels[7].get_reactions()[1]));
+        shared.advance(1.0);
+        REQUIRE(shared.get_time() >= 1.0);
+    }
+
+    SECTION("Testing look-ahead extrande bounds") {
+        // Molecules diffuse on a growing domain, bounds over a look-ahead window waste fewer events than the ratio
+        auto growth = [](const double& t) { return std::exp(0.2 * t); };
+        std::vector<ss::Voxel> vs;
+        for (unsigned i=0; i<5; i++) {
+            vs.emplace_back(std::vector<unsigned>({i == 0 ? 1000u : 0u}), 1.0, growth);
+            if (i > 0) { vs[i].add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1}, i - 1)); }
+            if (i < 4) { vs[i].add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1}, i + 1)); }
+        }
+        ss::Simulator ratio(vs);
+        ss::Simulator look_ahead(vs);
+        look_ahead.set_look_ahead(0.5);
+        auto voxels = look_ahead.get_voxels();
+        REQUIRE(voxels[0].get_look_ahead() == 0.5);
+
+        unsigned num_steps = 0;
+        unsigned num_steps_look_ahead = 0;
+        ratio.set_seed(153);
+        look_ahead.set_seed(153);
+        for (; ratio.get_time() < 2.0; num_steps++) { ratio.step(); }
+        for (; look_ahead.get_time() < 2.0; num_steps_look_ahead++) { look_ahead.step(); }
+        REQUIRE(num_steps_look_ahead < 0.7 * num_steps);
+
+        unsigned total = 0;
+        for (const auto& n : look_ahead.get_molecules()) { total += n; }
+        REQUIRE(total == 1000);
+        REQUIRE_THROWS(look_ahead.set_look_ahead(-1.0));
+    }
+
+    SECTION("Testing extrande statistics") {
+        // A production reaction in a growing voxel whose extrande ratio is far too high, so most events are rejected
+        ss::Voxel g({0}, 1.0, ss::GrowthLaw::exponential(0.1), 5.0);
+        g.add_reaction(ss::Reaction::mass_action(10.0, {}, {1}));
+        ss::Simulator fixed({g});
+        ss::Simulator tuned({g});
+        tuned.set_ratio_tuning(true, 0.2);
+        fixed.set_seed(153);
+        tuned.set_seed(153);
+        for (unsigned n=0; n<2000; n++) { fixed.step(); }
+        for (unsigned n=0; n<2000; n++) { tuned.step(); }
+        REQUIRE(fixed.get_num_accepted()[0] + fixed.get_num_rejected()[0] == 2000);
+        REQUIRE(fixed.get_num_accepted()[0] == fixed.get_molecules()[0]);
+        REQUIRE(fixed.get_num_rejected()[0] > 1400);
+        REQUIRE(fixed.get_extrande_ratios()[0] == 5.0);
+
+        // Static voxels have no bound above their total propensity
+        ss::Voxel v({0}, 1.0);
+        v.add_reaction(ss::Reaction::mass_action(10.0, {}, {1}));
+        ss::Simulator mixed({v, g});
+        mixed.advance(1.0);
+        REQUIRE(mixed.get_extrande_ratios() == std::vector<double>({1.0, 5.0}));
+
+        // The tuned ratio settles near the target fraction of rejected events
+        tuned.reset_extrande_statistics();
+        for (unsigned n=0; n<2000; n++) { tuned.step(); }
+        REQUIRE(tuned.get_num_accepted()[0] + tuned.get_num_rejected()[0] == 2000);
+        REQUIRE(tuned.get_num_rejected()[0] > 200);
+        REQUIRE(tuned.get_num_rejected()[0] < 600);
+        REQUIRE(tuned.get_extrande_ratios()[0] > 1.0);
+        REQUIRE(tuned.get_extrande_ratios()[0] < 2.0);
+        REQUIRE_THROWS(tuned.set_ratio_tuning(true, 1.5));
+    }
+
+    SECTION("Testing integrated hazards") {
+        // Production in an exponentially growing voxel, the mean number of molecules at time 2 is
+        // 10 * (exp(1) - 1) / 0.5 and no event is rejected
+        ss::Voxel g({0}, 1.0, ss::GrowthLaw::exponential(0.5));
+        g.add_reaction(ss::Reaction::mass_action(10.0, {}, {1}));
+        ss::Simulator exact({g});
+        exact.set_integrated_hazard(true);
+        exact.set_seed(153);
+        double mean = 0;
+        unsigned num_runs = 500;
+        for (unsigned n=0; n<num_runs; n++) {
+            ss::Simulator run(exact);
+            run.set_seed(153 + n);
+            run.advance(2.0);
+            auto num = run.get_molecules()[0] - (run.get_time() > 2.0 ? 1 : 0);
+            mean += (double) num / num_runs;
+            REQUIRE(run.get_num_rejected()[0] == 0);
+        }
+        REQUIRE(std::abs(mean - 20 * std::expm1(1.0)) < 1.5);
+
+        // A scheduled input only produces molecules after it is switched on
+        ss::Voxel input({0}, 1.0);
+        input.add_reaction(ss::Reaction::mass_action(1.0, {}, {1}));
+        input.set_rate_schedule(0, {0.0, 1.0}, {0.0, 100.0});
+        ss::Simulator scheduled({input});
+        scheduled.set_seed(153);
+        scheduled.advance(0.999);
+        REQUIRE(scheduled.get_molecules()[0] == 0);
+        scheduled.advance(2.0);
+        REQUIRE(scheduled.get_molecules()[0] > 60);
+        REQUIRE(scheduled.get_molecules()[0] < 140);
+    }
+
+    SECTION("Testing random number generators") {
+        // The Mersenne twister is the default, Philox streams count the values drawn by each voxel and the domain
+        REQUIRE(s.get_rng_type() == ss::RngType::mt19937);
+        REQUIRE_THROWS(s.get_rng_counters());
+        ss::Simulator philox({v, v});
+        philox.set_rng_type(ss::RngType::philox);
+        philox.set_seed(153);
+        REQUIRE(philox.get_rng_type() == ss::RngType::philox);
+        REQUIRE(philox.get_rng_counters() == std::vector<std::uint64_t>({2, 2, 0}));
+        philox.step();
+        auto counters = philox.get_rng_counters();
+        REQUIRE(counters[0] + counters[1] == 8);
+
+        // A copy continues with the same random numbers
+        ss::Simulator copy(philox);
+        philox.advance(1.0);
+        copy.advance(1.0);
+        REQUIRE(copy.get_molecules() == philox.get_molecules());
+        REQUIRE(copy.get_time() == philox.get_time());
+        copy.set_rng_counters(counters);
+        REQUIRE(copy.get_rng_counters() == counters);
+    }
+
+    SECTION("Testing shared growth clock") {
+        // Copies of a voxel share a single growth law, which is evaluated once for each distinct time
+        ss::Voxel g({100}, 1.0, [](const double& t) { return 1.0 + t; });
+        std::vector<ss::Voxel> vs(4, g);
+        for (unsigned i=0; i<vs.size(); i++) {
+            vs[i].add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1}, (i + 1) % vs.size()));
+        }
+        ss::Simulator grow(vs);
+        REQUIRE(grow.get_num_growth_laws() == 1);
+        REQUIRE(grow.get_growth_clock().get_num_evaluations() == 1);
+        grow.set_seed(153);
+        for (unsigned n=0; n<100; n++) { grow.step(); }
+        REQUIRE(grow.get_growth_clock().get_num_evaluations() <= 101);
+
+        // A copy of the simulator evaluates the laws with its own clock
+        auto num_evaluations = grow.get_growth_clock().get_num_evaluations();
+        ss::Simulator copy(grow);
+        copy.step();
+        REQUIRE(grow.get_growth_clock().get_num_evaluations() == num_evaluations);
+        REQUIRE(copy.get_growth_clock().get_num_evaluations() == 1);
+        REQUIRE(copy.get_num_growth_laws() == 1);
+    }
 }
@@ -0,0 +1,116 @@
+// catch2 includes
+#include "catch.hpp"
+
+// StoSpa2 includes
+#include "network.hpp"
+#include "static_simulator.hpp"
+
+// stl
+#include <cmath>
+#include <cstdint>
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing StaticSimulator class") {
+    // Schnakenberg reaction network
+    typedef ss::Network<2,
+        ss::MassAction<ss::Reactants<0>, ss::Stoichiometry<-1, 0>>,
+        ss::MassAction<ss::Reactants<>, ss::Stoichiometry<1, 0>>,
+        ss::MassAction<ss::Reactants<0, 0, 1>, ss::Stoichiometry<1, -1>>,
+        ss::MassAction<ss::Reactants<>, ss::Stoichiometry<0, 1>>
+    > Schnakenberg;
+
+    SECTION("Testing Network") {
+        REQUIRE(Schnakenberg::num_species == 2);
+        REQUIRE(Schnakenberg::num_reactions == 4);
+
+        // Same propensities as the mass-action reactions evaluated at run time
+        Schnakenberg::Molecules mols = {{5, 3}};
+        Schnakenberg::Propensities propensities;
+        Schnakenberg::propensities(mols, 0.5, propensities);
+        REQUIRE(propensities[0] == Approx(5.0));
+        REQUIRE(propensities[1] == Approx(0.5));
+        REQUIRE(propensities[2] == Approx(ss::Reaction::mass_action(1.0, {0, 0, 1}, {1, -1}).get_propensity({5, 3}, 0.5)));
+        REQUIRE(propensities[3] == Approx(0.5));
+
+        Schnakenberg::apply(2, mols);
+        REQUIRE(mols[0] == 6);
+        REQUIRE(mols[1] == 2);
+    }
+
+    SECTION("Testing diffusion") {
+        // Molecules only diffuse, so their total number is conserved
+        std::vector<Schnakenberg::Molecules> mols(10, {{0, 0}});
+        mols[0] = {{100, 50}};
+        ss::StaticSimulator<Schnakenberg> s(mols, 0.1, {{0.0, 0.0, 0.0, 0.0}}, {{1.0, 2.0}});
+        s.set_seed(153);
+        REQUIRE(s.get_num_voxels() == 10);
+        REQUIRE(s.get_time() == 0.0);
+
+        s.advance(10.0);
+        REQUIRE(s.get_time() > 10.0);
+        unsigned total_u = 0, total_v = 0;
+        for (unsigned k=0; k<s.get_num_voxels(); k++) {
+            total_u += s.get_molecules(k)[0];
+            total_v += s.get_molecules(k)[1];
+        }
+        REQUIRE(total_u == 100);
+        REQUIRE(total_v == 50);
+        REQUIRE(s.get_molecules(9)[0] > 0);
+        REQUIRE(s.get_molecules().size() == 20);
+    }
+
+    SECTION("Testing reactions") {
+        // Decay only, all the molecules decay eventually and the voxels become inactive
+        typedef ss::Network<1, ss::MassAction<ss::Reactants<0>, ss::Stoichiometry<-1>>> Decay;
+        ss::StaticSimulator<Decay> s({{{10}}, {{20}}}, 1.0, {{1.5}}, {{0.0}}, {}, 0.0, ss::QueueType::calendar);
+        s.set_seed(153);
+        s.step();
+        REQUIRE(s.get_molecules(0)[0] + s.get_molecules(1)[0] == 29);
+
+        s.advance(100.0);
+        REQUIRE(s.get_molecules() == std::vector<unsigned>({0, 0}));
+        REQUIRE(s.get_time() == std::numeric_limits<double>::infinity());
+
+        REQUIRE_THROWS(ss::StaticSimulator<Decay>({{{10}}}, 0.0, {{1.5}}, {{0.0}}));
+        REQUIRE_THROWS(ss::StaticSimulator<Decay>({{{10}}}, 1.0, {{1.5}}, {{0.0}}, {{1}}));
+    }
+
+    SECTION("Testing count types") {
+        // 8-bit counts use a quarter of the memory, updates that do not fit into them throw
+        typedef ss::BasicNetwork<std::uint8_t, 2,
+            ss::MassAction<ss::Reactants<>, ss::Stoichiometry<1, 0>>,
+            ss::MassAction<ss::Reactants<1>, ss::Stoichiometry<0, -2>>
+        > Small;
+        REQUIRE(sizeof(Small::Molecules) == 2);
+        Small::Molecules mols = {{254, 1}};
+        Small::apply(0, mols);
+        REQUIRE(mols[0] == 255);
+        REQUIRE_THROWS_WITH(Small::apply(0, mols), "BasicNetwork::apply: number of molecules of species 0 would "
+                                                   "exceed the largest value of the 8-bit count type");
+        REQUIRE_THROWS_WITH(Small::apply(1, mols), "BasicNetwork::apply: number of molecules of species 1 would "
+                                                   "become negative");
+        REQUIRE(mols == Small::Molecules({{255, 1}}));
+
+        ss::StaticSimulator<Small> s({{{250, 0}}, {{0, 0}}}, 1.0, {{10.0, 0.0}}, {{0.0, 0.0}});
+        s.set_seed(153);
+        REQUIRE_THROWS(s.advance(100.0));
+        REQUIRE(s.get_molecules(0)[0] == 255);
+
+        // Jumps into a full voxel throw as well
+        ss::StaticSimulator<Small> d({{{255, 0}}, {{255, 0}}}, 1.0, {{0.0, 0.0}}, {{1.0, 0.0}});
+        d.set_seed(153);
+        REQUIRE_THROWS_WITH(d.step(), Catch::Contains("StaticSimulator::step"));
+
+        // 64-bit counts hold populations larger than 32-bit counts can
+        typedef ss::BasicNetwork<std::uint64_t, 1,
+            ss::MassAction<ss::Reactants<0>, ss::Stoichiometry<1>>
+        > Large;
+        Large::Molecules large = {{(std::uint64_t) 1 << 40}};
+        Large::Propensities propensities;
+        Large::propensities(large, 1.0, propensities);
+        REQUIRE(propensities[0] == std::ldexp(1.0, 40));
+        Large::apply(0, large);
+        REQUIRE(large[0] == ((std::uint64_t) 1 << 40) + 1);
+    }
+}
@@ -0,0 +1,36 @@
+
+// catch2 includes
+#include "catch.hpp"
+
+// StoSpa2 includes
+#include "sum_tree.hpp"
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing SumTree class") {
+    ss::SumTree t({1.0, 0.0, 2.0, 3.0, 4.0});
+
+    SECTION("Testing Constructor") {
+        REQUIRE(t.size() == 5);
+        REQUIRE(t.total() == 10.0);
+        REQUIRE(t.get_value(3) == 3.0);
+    }
+
+    SECTION("Testing member functions") {
+        // Values equal to zero are never picked
+        REQUIRE(t.search(0.0) == 0);
+        REQUIRE(t.search(0.999) == 0);
+        REQUIRE(t.search(1.0) == 2);
+        REQUIRE(t.search(5.5) == 3);
+        REQUIRE(t.search(9.999) == 4);
+
+        t.update(1, 5.0);
+        REQUIRE(t.total() == 15.0);
+        REQUIRE(t.search(1.0) == 1);
+        REQUIRE(t.search(6.5) == 2);
+
+        t.update(4, 0.0);
+        REQUIRE(t.total() == 11.0);
+        REQUIRE(t.search(10.999) == 3);
+    }
+}
@@ -0,0 +1,86 @@
+
+// catch2 includes
+#include "catch.hpp"
+
+// StoSpa2 includes
+#include "tau_leap_simulator.hpp"
+
+// stl
+#include <limits>
+
+namespace ss = StoSpa2;
+
+TEST_CASE("Testing TauLeapSimulator class") {
+    auto decay = [](const std::vector<unsigned>& mols, const double& area) { return mols[0]; };
+    ss::Voxel v({10000}, 1.0);
+    v.add_reaction(ss::Reaction(1.0, decay, {-1}));
+    ss::TauLeapSimulator s({v});
+
+    SECTION("Testing Constructor") {
+        REQUIRE(s.get_time() == 0);
+        REQUIRE(s.get_epsilon() == 0.03);
+        auto vs = s.get_voxels();
+        REQUIRE(vs[0].get_molecules()[0] == 10000);
+        REQUIRE_THROWS(ss::TauLeapSimulator({v}, 0.0, 1.5));
+    }
+
+    SECTION("Testing member functions") {
+        s.set_seed(153);
+
+        // A single leap fires many reactions at once
+        s.step();
+        REQUIRE(s.get_time() > 0);
+        auto vs = s.get_voxels();
+        REQUIRE(vs[0].get_molecules()[0] < 9990);
+
+        // The time point is reached exactly and the mean is 10000 * exp(-1) = 3679 (standard deviation 48)
+        s.advance(1.0);
+        REQUIRE(s.get_time() == 1.0);
+        auto vs2 = s.get_voxels();
+        REQUIRE(vs2[0].get_molecules()[0] > 3400);
+        REQUIRE(vs2[0].get_molecules()[0] < 3950);
+
+        // Close to zero molecules exact steps are taken, so the number of molecules never becomes negative
+        s.advance(50.0);
+        REQUIRE(s.get_time() == 50.0);
+        auto vs3 = s.get_voxels();
+        REQUIRE(vs3[0].get_molecules()[0] == 0);
+    }
+
+    SECTION("Testing diffusion") {
+        std::vector<ss::Voxel> vs(10, ss::Voxel({1000}, 1.0));
+        vs.insert(vs.begin(), ss::Voxel({10000}, 1.0));
+        for (unsigned i=0; i<vs.size()-1; i++) {
+            vs[i].add_reaction(ss::Reaction(1.0, decay, {-1}, i+1));
+            vs[i+1].add_reaction(ss::Reaction(1.0, decay, {-1}, i));
+        }
+        ss::TauLeapSimulator s2(vs);
+        s2.set_seed(153);
+        s2.advance(10.0);
+
+        // Diffusion conserves the total number of molecules
+        unsigned total = 0;
+        for (const auto& mol : s2.get_molecules()) {
+            total += mol;
+        }
+        REQUIRE(total == 20000);
+        REQUIRE(s2.get_molecules()[0] < 10000);
+    }
+
+    SECTION("Testing unbounded leaps") {
+        // Nothing bounds the leap of a production-only voxel, so a step takes exact steps instead
+        ss::Voxel production({0}, 1.0);
+        production.add_reaction(ss::Reaction::mass_action(5.0, {}, {1}));
+        ss::TauLeapSimulator s2({production});
+        s2.set_seed(153);
+        s2.step();
+        REQUIRE(s2.get_time() > 0);
+        REQUIRE(s2.get_time() < std::numeric_limits<double>::infinity());
+        REQUIRE(s2.get_molecules()[0] == 100);
+
+        // Up to a time point it leaps there at once
+        s2.advance(50.0);
+        REQUIRE(s2.get_time() == 50.0);
+        REQUIRE(s2.get_molecules()[0] > 100);
+    }
+}
@@ -5,6 +5,12 @@
 // StoSpa2 includes
 #include "voxel.hpp"
 
+// stl
+#include <cmath>
+#include <limits>
+#include <map>
+#include <random>
+
 namespace ss = StoSpa2;
 
 TEST_CASE("Testing Voxel class") {
@@ -48,4 +54,271 @@ TEST_CASE("Testing Voxel class") {
         REQUIRE(v.get_reactions().size() == 0);
 
     }
+
+    SECTION("Testing dependency graph") {
+        // Count how many times each propensity function is evaluated
+        unsigned num_a = 0, num_b = 0;
+        auto prop_a = [&num_a](const std::vector<unsigned>& mols, const double& area) { num_a++; return mols[0]; };
+        auto prop_b = [&num_b](const std::vector<unsigned>& mols, const double& area) { num_b++; return mols[1]; };
+
+        ss::Voxel v2({10, 5}, 1.0);
+        ss::Reaction ra(1.0, prop_a, {-1, 0});
+        ra.set_dependencies({0});
+        ss::Reaction rb(2.0, prop_b, {0, -1});
+        rb.set_dependencies({1});
+        v2.add_reaction(ra);
+        v2.add_reaction(rb);
+        REQUIRE(v2.get_total_propensity() == 20);
+
+        // Only the propensity of the reaction that depends on the changed species is re-evaluated
+        num_a = 0;
+        num_b = 0;
+        v2.add_vector(rb.stoichiometry);
+        REQUIRE(num_a == 0);
+        REQUIRE(num_b == 1);
+        REQUIRE(v2.get_total_propensity() == 18);
+        REQUIRE(v2.pick_reaction(0.5) == ra);
+        REQUIRE(v2.pick_reaction(0.9) == rb);
+        REQUIRE(num_a == 0);
+        REQUIRE(num_b == 1);
+
+        // Dependencies on species that do not exist are rejected
+        ss::Reaction rc(1.0, prop_a, {-1, 0});
+        rc.set_dependencies({2});
+        REQUIRE_THROWS(v2.add_reaction(rc));
+    }
+
+    SECTION("Testing selection methods") {
+        auto constant = [](const std::vector<unsigned>& mols, const double& area) { return 1.0; };
+
+        ss::Voxel v2({10}, 1.0);
+        for (unsigned i=1; i<=5; i++) {
+            v2.add_reaction(ss::Reaction(i, constant, {-1}, i));
+        }
+        REQUIRE(v2.get_selection_method() == ss::SelectionMethod::direct);
+        REQUIRE(v2.get_total_propensity() == 15);
+
+        // Both methods pick the same reactions
+        std::vector<int> direct_picks;
+        for (unsigned i=0; i<15; i++) {
+            direct_picks.push_back(v2.pick_reaction((i + 0.5) / 15).diffusion_idx);
+        }
+        v2.set_selection_method(ss::SelectionMethod::sum_tree);
+        REQUIRE(v2.get_total_propensity() == 15);
+        for (unsigned i=0; i<15; i++) {
+            REQUIRE(v2.pick_reaction((i + 0.5) / 15).diffusion_idx == direct_picks[i]);
+        }
+
+        // Composition-rejection only picks reactions that are present
+        v2.set_selection_method(ss::SelectionMethod::composition_rejection);
+        REQUIRE(v2.get_total_propensity() == 15);
+        std::mt19937 gen(153);
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        auto uniform = [&gen, &dist]() { return dist(gen); };
+        for (unsigned i=0; i<15; i++) {
+            int idx = v2.pick_reaction((i + 0.5) / 15, uniform).diffusion_idx;
+            REQUIRE(idx >= 1);
+            REQUIRE(idx <= 5);
+        }
+        REQUIRE_THROWS(v2.pick_reaction(0.5));
+
+        // Reactions added afterwards are also part of the sum tree
+        v2.set_selection_method(ss::SelectionMethod::sum_tree);
+        v2.add_reaction(ss::Reaction(5.0, decay, {-1}));
+        REQUIRE(v2.get_total_propensity() == 65);
+        REQUIRE(v2.pick_reaction(0.5).diffusion_idx == -1);
+        v2.add_vector({-5});
+        REQUIRE(v2.get_total_propensity() == 40);
+        REQUIRE(v2.pick_reaction(0.3).diffusion_idx == 5);
+    }
+
+    SECTION("Testing continuous reactions") {
+        ss::Voxel v2({10}, 1.0);
+        v2.add_reaction(ss::Reaction(1.0, decay, {-1}, 1));
+        v2.add_reaction(ss::Reaction(2.0, decay, {-1}, 2));
+        REQUIRE(v2.get_total_propensity() == 30);
+
+        // Continuous reactions are excluded from the total propensity and never picked
+        v2.set_continuous(1, true);
+        REQUIRE(v2.is_continuous(1));
+        REQUIRE(v2.get_total_propensity() == 10);
+        REQUIRE(v2.get_propensity(1) == 20);
+        REQUIRE(v2.pick_reaction(0.99).diffusion_idx == 1);
+
+        v2.set_selection_method(ss::SelectionMethod::sum_tree);
+        REQUIRE(v2.get_total_propensity() == 10);
+        REQUIRE(v2.pick_reaction(0.99).diffusion_idx == 1);
+
+        v2.set_continuous(1, false);
+        REQUIRE(v2.get_total_propensity() == 30);
+        REQUIRE(v2.pick_reaction(0.99).diffusion_idx == 2);
+    }
+
+    SECTION("Testing sparse changes") {
+        ss::Voxel v2({10, 5, 0}, 1.0);
+        auto r = ss::Reaction::mass_action(2.0, {1}, {0, -1, 1});
+        v2.add_reaction(r);
+        REQUIRE(r.changes.size() == 2);
+        REQUIRE(r.changes[0].species == 1);
+        REQUIRE(r.changes[1].delta == 1);
+
+        v2.add_changes(r.changes);
+        REQUIRE(v2.get_molecules() == std::vector<unsigned>({10, 4, 1}));
+        REQUIRE(v2.get_total_propensity() == 8);
+        v2.subtract_changes(r.changes);
+        REQUIRE(v2.get_molecules() == std::vector<unsigned>({10, 5, 0}));
+        REQUIRE(v2.get_total_propensity() == 10);
+
+        // Checked changes report negative numbers and overflow and leave the molecules unchanged
+        REQUIRE(!v2.get_check_counts());
+        v2.set_check_counts(true);
+        REQUIRE_THROWS(v2.subtract_changes(r.changes));
+        REQUIRE_THROWS(v2.add_vector({-11, 0, 0}));
+        REQUIRE(v2.get_molecules() == std::vector<unsigned>({10, 5, 0}));
+        v2.add_vector({-10, 0, 0});
+        REQUIRE(v2.get_molecules()[0] == 0);
+        ss::Voxel full({std::numeric_limits<unsigned>::max() - 1, 0}, 1.0);
+        full.set_check_counts(true);
+        full.add_changes({{0, 1}});
+        REQUIRE_THROWS(full.add_changes({{0, 1}}));
+        REQUIRE_THROWS(full.subtract_vector({-1, 0}));
+        REQUIRE(full.get_molecules()[0] == std::numeric_limits<unsigned>::max());
+    }
+
+    SECTION("Testing growth") {
+        // The voxel doubles its length, diffusion slows down by a factor of four and the rates stay unchanged
+        ss::Voxel v2({10, 4}, 1.0, [](const double& t) { return 1.0 + t; }, 3.0);
+        v2.add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1, 0}, 1));
+        v2.add_reaction(ss::Reaction::mass_action(2.0, {0, 1}, {-1, 0}));
+        REQUIRE(v2.is_growing());
+        REQUIRE(v2.get_total_propensity() == 3.0 * (10 + 80));
+
+        v2.update_properties(1.0);
+        REQUIRE(v2.get_voxel_size() == 2.0);
+        REQUIRE(v2.get_diffusion_factor() == 0.25);
+        REQUIRE(v2.get_propensity(0) == 2.5);
+        REQUIRE(v2.get_propensity(1) == 40);
+        REQUIRE(v2.get_reactions()[0].get_rate() == 1.0);
+        REQUIRE(v2.get_total_propensity(false) == 42.5);
+
+        // Changes in the number of molecules are scaled the same way
+        v2.add_vector({1, 0});
+        REQUIRE(v2.get_propensity(0) == 2.75);
+        REQUIRE(v2.get_propensity(1) == 44);
+
+        // A change in size only rescales the sums of the classes of reactions, custom reactions are re-evaluated
+        unsigned evaluations = 0;
+        auto counted = [&evaluations](const std::vector<unsigned>& mols, const double& area) {
+            evaluations++;
+            return area;
+        };
+        ss::Voxel v3({10, 4}, 1.0, [](const double& t) { return 1.0 + t; });
+        v3.add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1, 0}, 1));
+        v3.add_reaction(ss::Reaction::mass_action(2.0, {0, 1}, {-1, 0}));
+        v3.add_reaction(ss::Reaction::mass_action(3.0, {}, {1, 0}));
+        v3.add_reaction(ss::Reaction(0.5, counted, {0, 1}));
+        evaluations = 0;
+        v3.update_properties(1.0);
+        v3.update_properties(1.0);
+        REQUIRE(evaluations == 1);
+        std::vector<double> expected = {2.5, 40, 6, 1};
+        for (unsigned j=0; j<expected.size(); j++) {
+            REQUIRE(v3.get_propensity(j) == expected[j]);
+        }
+        REQUIRE(v3.get_total_propensity(false) == 49.5);
+
+        // Each selection method picks the reactions in proportion to their scaled propensities
+        std::mt19937 gen(153);
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        auto uniform = [&gen, &dist]() { return dist(gen); };
+        for (auto method : {ss::SelectionMethod::direct, ss::SelectionMethod::sum_tree,
+                            ss::SelectionMethod::composition_rejection}) {
+            v3.set_selection_method(method);
+            REQUIRE(v3.get_total_propensity() == 99);
+            // The reactions are told apart by their rates, the extrande reaction has rate zero
+            std::map<double, unsigned> picks;
+            for (unsigned i=0; i<990; i++) {
+                picks[v3.pick_reaction((i + 0.5) / 990, uniform).get_rate()]++;
+            }
+            REQUIRE(picks == std::map<double, unsigned>({{1.0, 25}, {2.0, 400}, {3.0, 60}, {0.5, 10}, {0.0, 495}}));
+        }
+    }
+
+    SECTION("Testing look-ahead extrande bounds") {
+        // Over the window [0, 1] the length doubles: production doubles, diffusion and the second-order reaction
+        // only slow down, so the bound is the production at the end of the window plus the current propensities
+        auto growth = [](const double& t) { return 1.0 + t; };
+        ss::Voxel v2({10, 4}, 1.0, growth);
+        v2.add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1, 0}, 1));
+        v2.add_reaction(ss::Reaction::mass_action(2.0, {0, 1}, {-1, 0}));
+        v2.add_reaction(ss::Reaction::mass_action(3.0, {}, {1, 0}));
+        v2.set_look_ahead(1.0);
+        REQUIRE(v2.get_look_ahead() == 1.0);
+        double bound = v2.get_total_propensity();
+        REQUIRE(bound == Approx(10 + 80 + 6));
+        REQUIRE(v2.get_bound_end() == 1.0);
+
+        // The bound holds over the whole window
+        for (double t=0.0; t<=1.0; t+=0.125) {
+            ss::Voxel later = v2;
+            later.update_properties(t);
+            REQUIRE(later.get_total_propensity(false) <= bound);
+        }
+
+        // A new bound starts at the time of the last update
+        v2.update_properties(1.0);
+        REQUIRE(v2.get_total_propensity() == Approx(2.5 + 40 + 6 * 1.5));
+        REQUIRE(v2.get_bound_end() == 2.0);
+    }
+
+    SECTION("Testing integrated hazards") {
+        // Production, diffusion and a second-order reaction scale as (1 + t), (1 + t)^-2 and (1 + t)^-1, so the
+        // integrated total propensity over [0, 1] is 3 * 1.5 + 10 * 0.5 + 80 * log(2)
+        auto growth = [](const double& t) { return 1.0 + t; };
+        ss::Voxel v2({10, 4}, 1.0, ss::GrowthLaw::linear(1.0));
+        v2.add_reaction(ss::Reaction::mass_action(1.0, {0}, {-1, 0}, 1));
+        v2.add_reaction(ss::Reaction::mass_action(2.0, {0, 1}, {-1, 0}));
+        v2.add_reaction(ss::Reaction::mass_action(3.0, {}, {1, 0}));
+        v2.set_integrated_hazard(true);
+        REQUIRE(v2.get_integrated_hazard());
+        REQUIRE(v2.integrated_event_time(4.5 + 5 + 80 * std::log(2.0)) == Approx(1.0).epsilon(1e-12));
+        REQUIRE(v2.get_total_propensity() == 93);
+
+        // The same for exponential growth, from a later time
+        ss::Voxel v3({0}, 1.0, ss::GrowthLaw::exponential(0.5));
+        v3.add_reaction(ss::Reaction::mass_action(2.0, {}, {1}));
+        v3.set_integrated_hazard(true);
+        v3.update_properties(1.0);
+        double a = 2.0 * std::exp(0.5);
+        REQUIRE(v3.integrated_event_time(a * std::expm1(0.5 * 2.0) / 0.5) == Approx(3.0).epsilon(1e-12));
+        REQUIRE(v3.pick_reaction(0.999).get_rate() == 2.0);
+
+        // Other growth laws and reactions cannot be integrated
+        ss::Voxel v4({10}, 1.0, growth);
+        REQUIRE_THROWS(v4.set_integrated_hazard(true));
+        REQUIRE(!v4.get_integrated_hazard());
+        ss::Voxel v5({10}, 1.0, ss::GrowthLaw::exponential(0.5));
+        v5.add_reaction(ss::Reaction(1.0, decay, {-1}));
+        v5.set_integrated_hazard(true);
+        REQUIRE_THROWS(v5.integrated_event_time(1.0));
+    }
+
+    SECTION("Testing rate schedules") {
+        // The rate of production changes from 1 to 5 at time 1, a bound is only valid until then
+        ss::Voxel v2({0}, 2.0);
+        v2.add_reaction(ss::Reaction::mass_action(1.0, {}, {1}));
+        v2.set_rate_schedule(0, {1.0, 3.0}, {5.0, 0.0});
+        v2.update_properties(0.5);
+        REQUIRE(v2.get_total_propensity() == 2.0);
+        REQUIRE(v2.get_bound_end() == 1.0);
+        v2.update_properties(1.5);
+        REQUIRE(v2.get_total_propensity() == 10.0);
+        REQUIRE(v2.get_bound_end() == 3.0);
+        v2.update_properties(3.0);
+        REQUIRE(v2.get_total_propensity() == 0.0);
+        REQUIRE(v2.get_bound_end() == std::numeric_limits<double>::infinity());
+        REQUIRE_THROWS(v2.set_rate_schedule(1, {1.0}, {1.0}));
+        REQUIRE_THROWS(v2.set_rate_schedule(0, {2.0, 1.0}, {1.0, 1.0}));
+        REQUIRE_THROWS(v2.set_rate_schedule(0, {1.0, 2.0}, {1.0, -1.0}));
+    }
 }
@@ -1,7 +1,23 @@
 
 // catch2 includes
 #define CATCH_CONFIG_MAIN  // This tells Catch to provide a main() - only do this in one cpp file
+#define CATCH_CONFIG_NO_POSIX_SIGNALS  // MINSIGSTKSZ is no longer a constant in recent versions of glibc
 #include "catch.hpp"
+#include "test_batch_propensity.hpp"
+#include "test_calendar_queue.hpp"
+#include "test_composition_rejection.hpp"
+#include "test_ensemble.hpp"
+#include "test_event_queue.hpp"
+#include "test_expression.hpp"
+#include "test_growth.hpp"
+#include "test_hybrid_simulator.hpp"
+#include "test_kernel_compiler.hpp"
+#include "test_molecule_store.hpp"
+#include "test_parallel_simulator.hpp"
+#include "test_random.hpp"
 #include "test_reaction.hpp"
+#include "test_sum_tree.hpp"
 #include "test_voxel.hpp"
 #include "test_simulator.hpp"
+#include "test_static_simulator.hpp"
+#include "test_tau_leap_simulator.hpp"